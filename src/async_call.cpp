@@ -0,0 +1,180 @@
+#ifndef EMSCRIPTEN
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#endif
+
+#include "async_call.hpp"
+
+using namespace processwarp;
+
+#ifndef EMSCRIPTEN
+/// ホストのスレッドでの実行を待っている処理
+struct PendingTask {
+  /// 非同期処理
+  std::shared_ptr<AsyncCall> call;
+  /// 実行する処理
+  AsyncCall::Task task;
+  /// 完了時に呼び出す関数
+  AsyncCall::Handler handler;
+};
+
+/// 完了を待っているタイマー
+struct PendingTimer {
+  /// 非同期処理
+  std::shared_ptr<AsyncCall> call;
+  /// 完了時に呼び出す関数
+  AsyncCall::Handler handler;
+};
+
+/// スレッドプールの状態
+struct AsyncPool {
+  /// 以下のメンバのロック
+  std::mutex mutex;
+  /// 処理が追加された時に通知する
+  std::condition_variable task_cond;
+  /// 先頭のタイマーが変わった時に通知する
+  std::condition_variable timer_cond;
+  /// 実行を待っている処理
+  std::deque<PendingTask> tasks;
+  /// 完了する時刻順のタイマー
+  std::multimap<AsyncCall::Clock::time_point, PendingTimer> timers;
+  /// タスクを実行するスレッドを開始した場合true
+  bool is_task_started = false;
+  /// タイマーを完了させるスレッドを開始した場合true
+  bool is_timer_started = false;
+};
+
+// スレッドプールを取得する。
+// 待ち状態のまま残るホストのスレッドが参照するため、プロセスの終了まで開放しない。
+static AsyncPool& get_pool() {
+  static AsyncPool* pool = new AsyncPool();
+  return *pool;
+}
+#endif
+
+// 処理を実行する。
+// 処理が例外を投げた場合はホストを止めないよう、結果を空にして完了させる。
+static void run_task(const AsyncCall::Task& task, std::vector<uint8_t>& result) {
+  try {
+    task(result);
+  } catch (...) {
+    result.clear();
+  }
+}
+
+// 処理をホストのスレッドプールで開始する。
+std::shared_ptr<AsyncCall> AsyncCall::start_task(const Task& task, const Handler& handler) {
+  std::shared_ptr<AsyncCall> call(new AsyncCall(false));
+
+#ifndef EMSCRIPTEN
+  AsyncPool& pool = get_pool();
+  {
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    // スレッドは最初に使う時に開始し、プロセスの終了まで待ち状態で残す
+    if (!pool.is_task_started) {
+      for (unsigned int i = 0; i < ASYNC_THREAD_NUM; i ++) {
+	std::thread(&AsyncCall::run_task_thread).detach();
+      }
+      pool.is_task_started = true;
+    }
+    pool.tasks.push_back(PendingTask {call, task, handler});
+  }
+  pool.task_cond.notify_one();
+
+#else
+  // スレッドを使えないため、その場で実行する
+  run_task(task, call->result);
+  call->complete(handler);
+#endif
+
+  return call;
+}
+
+// 指定した時間が経過すると完了するタイマーを開始する。
+std::shared_ptr<AsyncCall> AsyncCall::start_timer(Clock::duration duration,
+						  const std::vector<uint8_t>& result,
+						  const Handler& handler) {
+  std::shared_ptr<AsyncCall> call(new AsyncCall(true));
+  call->result   = result;
+  call->deadline = Clock::now() + duration;
+
+#ifndef EMSCRIPTEN
+  AsyncPool& pool = get_pool();
+  {
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    if (!pool.is_timer_started) {
+      std::thread(&AsyncCall::run_timer_thread).detach();
+      pool.is_timer_started = true;
+    }
+    pool.timers.insert(std::make_pair(call->deadline, PendingTimer {call, handler}));
+  }
+  pool.timer_cond.notify_one();
+#endif
+
+  return call;
+}
+
+// 処理が完了したかどうかを判定する。
+bool AsyncCall::is_done() const {
+  // タイマーは完了させるスレッドより先に時刻を確認した場合も完了とする
+  return done || (is_timer && Clock::now() >= deadline);
+}
+
+// コンストラクタ。
+AsyncCall::AsyncCall(bool is_timer_) :
+  done(false),
+  is_timer(is_timer_) {
+}
+
+// 処理を完了させる。
+void AsyncCall::complete(const Handler& handler) {
+  done = true;
+  if (handler) handler();
+}
+
+#ifndef EMSCRIPTEN
+// タスクを実行するホストのスレッドの処理。
+void AsyncCall::run_task_thread() {
+  AsyncPool& pool = get_pool();
+
+  while (true) {
+    PendingTask pending;
+    {
+      std::unique_lock<std::mutex> lock(pool.mutex);
+      pool.task_cond.wait(lock, [&pool] { return !pool.tasks.empty(); });
+      pending = std::move(pool.tasks.front());
+      pool.tasks.pop_front();
+    }
+
+    run_task(pending.task, pending.call->result);
+    pending.call->complete(pending.handler);
+  }
+}
+
+// タイマーを完了させるホストのスレッドの処理。
+void AsyncCall::run_timer_thread() {
+  AsyncPool& pool = get_pool();
+  std::unique_lock<std::mutex> lock(pool.mutex);
+
+  while (true) {
+    if (pool.timers.empty()) {
+      pool.timer_cond.wait(lock);
+
+    } else if (pool.timers.begin()->first > Clock::now()) {
+      // 先頭より早いタイマーが追加された場合は通知で起きて待ち直す
+      pool.timer_cond.wait_until(lock, pool.timers.begin()->first);
+
+    } else {
+      PendingTimer pending = std::move(pool.timers.begin()->second);
+      pool.timers.erase(pool.timers.begin());
+      // 完了時に呼び出す関数はタイマーを追加する可能性があるため、ロックを外して呼び出す
+      lock.unlock();
+      pending.call->complete(pending.handler);
+      lock.lock();
+    }
+  }
+}
+#endif
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "definitions.hpp"
+
+namespace processwarp {
+  /**
+   * 組み込み関数が開始し、VMの外で完了する非同期処理。
+   * ホストのスレッドプールで実行する処理と、指定した時間が経過すると完了するタイマーがある。
+   * 呼び出したスレッドは完了するまで待ち状態になり、完了後にやり直した組み込み関数が結果を受け取る。
+   * EMSCRIPTENではホストのスレッドを使わず、処理は開始時に実行し、タイマーは時刻で完了を判定する。
+   */
+  class AsyncCall {
+  public:
+    /// 時刻の計測に使う時計
+    typedef std::chrono::steady_clock Clock;
+    /// ホストのスレッドで実行する処理、引数に結果を書き込む
+    typedef std::function<void(std::vector<uint8_t>&)> Task;
+    /// 完了時に、完了させたホストのスレッドから呼び出す関数
+    typedef std::function<void()> Handler;
+
+    /// 処理の結果、完了後に組み込み関数が受け取る
+    std::vector<uint8_t> result;
+
+    /**
+     * 処理をホストのスレッドプールで開始する。
+     * 処理はVMの仮想メモリに触れてはならない。
+     * 処理が例外を投げた場合は、結果を空にして完了する。
+     * @param task 実行する処理
+     * @param handler 完了時に呼び出す関数(空の場合は呼び出さない)
+     * @return 開始した非同期処理
+     */
+    static std::shared_ptr<AsyncCall> start_task(const Task& task, const Handler& handler);
+
+    /**
+     * 指定した時間が経過すると完了するタイマーを開始する。
+     * @param duration 完了までの時間
+     * @param result 完了時の結果
+     * @param handler 完了時に呼び出す関数(空の場合は呼び出さない)
+     * @return 開始した非同期処理
+     */
+    static std::shared_ptr<AsyncCall> start_timer(Clock::duration duration,
+						  const std::vector<uint8_t>& result,
+						  const Handler& handler);
+
+    /**
+     * 処理が完了したかどうかを判定する。
+     * @return 完了した場合true
+     */
+    bool is_done() const;
+
+  private:
+    /// 処理が完了した場合true、完了させたホストのスレッドから書き込む
+    std::atomic<bool> done;
+    /// タイマーの場合true
+    bool is_timer;
+    /// タイマーが完了する時刻
+    Clock::time_point deadline;
+
+    /**
+     * コンストラクタ。
+     * @param is_timer_ タイマーの場合true
+     */
+    AsyncCall(bool is_timer_);
+
+    /**
+     * 処理を完了させる。
+     * @param handler 完了時に呼び出す関数
+     */
+    void complete(const Handler& handler);
+
+    /**
+     * タスクを実行するホストのスレッドの処理。
+     */
+    static void run_task_thread();
+
+    /**
+     * タイマーを完了させるホストのスレッドの処理。
+     */
+    static void run_timer_thread();
+  };
+}
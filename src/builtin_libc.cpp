@@ -44,15 +44,17 @@ bool BuiltinLibc::exit(VMachine& vm, Thread& th, BuiltinFuncParam p,
   // コピー先アドレスを取得
   uint32_t ret = VMachine::read_builtin_param_i32(src, &seek);
   
-  // 終了コードを設定する
-  *reinterpret_cast<uint32_t*>(vm.get_raw_addr(th.stackinfos.at(0)->stack)) = ret;
+  // 終了コードはmain関数を実行するスレッドに設定する
+  Thread& main_thread = *vm.threads.front();
+  *reinterpret_cast<uint32_t*>(vm.get_raw_addr(main_thread.stackinfos.at(0)->stack)) = ret;
   
   // スタックを1段残して開放する
-  while (th.stackinfos.size() > 1) {
-    StackInfo& top = *(th.stackinfos.back());
-    vm.vmemory.free(top.stack);
-    for (vaddr_t addr : top.alloca_addrs) vm.vmemory.free(addr);
-    th.stackinfos.pop_back();
+  // 他のスレッドから呼び出された場合、呼び出したスレッドも終了させる
+  for (Thread* thread : {&main_thread, &th}) {
+    while (thread->stackinfos.size() > 1) {
+      vm.free_stackinfo(*thread, std::move(thread->stackinfos.back()));
+      thread->stackinfos.pop_back();
+    }
   }
 
   return true;
@@ -86,13 +88,8 @@ bool BuiltinLibc::longjmp(VMachine& vm, Thread& th, BuiltinFuncParam p,
   
   // 余分なスタックを開放
   while (th.stackinfos.size() > stack_count) {
-    const StackInfo& si = *(th.stackinfos.back());
-    // スタック領域を解放
-    vm.vmemory.free(si.stack);
-    // alloca領域を開放
-    for (vaddr_t addr : si.alloca_addrs) {
-      vm.vmemory.free(addr);
-    }
+    // スタック領域、alloca領域を解放
+    vm.free_stackinfo(th, std::move(th.stackinfos.back()));
     th.stackinfos.pop_back();
   }
   StackInfo& si = *(th.stackinfos.back());
@@ -128,6 +125,8 @@ bool BuiltinLibc::longjmp(VMachine& vm, Thread& th, BuiltinFuncParam p,
   si.address = *reinterpret_cast<vaddr_t*>(env + seek2);
   seek2 += sizeof(vaddr_t);
   si.address_cache = nullptr;
+  // キャッシュは呼び出し元に戻る際に解決し直す
+  si.cache_generation = 0;
 
   return true;
 }
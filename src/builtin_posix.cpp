@@ -1,13 +1,72 @@
 
 #include <cassert>
+#include <cerrno>
 #include <cinttypes>
 #include <cstring>
+#include <unistd.h>
 
 #include "builtin_posix.hpp"
+#include "util.hpp"
 #include "vmachine.hpp"
 
 using namespace processwarp;
 
+/// struct timespecのメンバの位置
+/// 秒
+static const size_t TIMESPEC_SEC  = 0;
+/// ナノ秒
+static const size_t TIMESPEC_NSEC = 8;
+
+// 戻り値を書き込む。
+static void write_result(VMachine& vm, vaddr_t dst, int32_t result) {
+  *reinterpret_cast<int32_t*>(vm.get_raw_addr(dst)) = result;
+}
+
+/// 入出力の非同期処理の結果の位置
+/// 戻り値
+static const size_t IO_RESULT_RET   = 0;
+/// errno
+static const size_t IO_RESULT_ERRNO = 8;
+/// 読み込んだデータ
+static const size_t IO_RESULT_DATA  = 12;
+
+// 入出力の結果を非同期処理の結果に書き込む。
+static void set_io_result(std::vector<uint8_t>& result, int64_t ret) {
+  int32_t err = ret < 0 ? errno : 0;
+  if (result.size() < IO_RESULT_DATA) result.resize(IO_RESULT_DATA);
+  std::memcpy(result.data() + IO_RESULT_RET, &ret, sizeof(ret));
+  std::memcpy(result.data() + IO_RESULT_ERRNO, &err, sizeof(err));
+}
+
+// 非同期処理の結果から入出力の戻り値をdstへ書き込み、失敗時はerrnoを戻す。
+// 処理が例外で終わり結果が空の場合はEIOで失敗したものとする。
+static int64_t get_io_result(VMachine& vm, vaddr_t dst, const std::vector<uint8_t>& result) {
+  int64_t ret = -1;
+  int32_t err = EIO;
+  if (result.size() >= IO_RESULT_DATA) {
+    std::memcpy(&ret, result.data() + IO_RESULT_RET, sizeof(ret));
+    std::memcpy(&err, result.data() + IO_RESULT_ERRNO, sizeof(err));
+  }
+  if (ret < 0) errno = err;
+  *reinterpret_cast<int64_t*>(vm.get_raw_addr(dst)) = ret;
+  return ret;
+}
+
+// 指定した時間が経過するまでスレッドを待ち状態にする。
+// 完了後にやり直した組み込み関数がresume_asyncでresultをdstへ書き込む。
+static bool start_sleep(VMachine& vm, Thread& th, vaddr_t dst,
+			AsyncCall::Clock::duration duration, int32_t result) {
+  if (duration <= AsyncCall::Clock::duration::zero()) {
+    write_result(vm, dst, result);
+    return false;
+  }
+
+  std::vector<uint8_t> data(sizeof(result));
+  std::memcpy(data.data(), &result, sizeof(result));
+  vm.start_async_timer(th, duration, data);
+  return true;
+}
+
 // __assert_fail(assertの内部実装)関数。
 bool BuiltinPosix::__assert_fail(VMachine& vm, Thread& th, BuiltinFuncParam p,
 				 vaddr_t dst, std::vector<uint8_t>& src) {
@@ -29,7 +88,132 @@ bool BuiltinPosix::__assert_fail(VMachine& vm, Thread& th, BuiltinFuncParam p,
   return true;
 }
 
+// nanosleep関数。
+bool BuiltinPosix::nanosleep(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			     vaddr_t dst, std::vector<uint8_t>& src) {
+  // タイマーを開始済みの場合は完了まで待つ
+  if (vm.resume_async(th, dst)) return th.is_waiting;
+
+  // パタメタを読み取り
+  int seek = 0;
+  vaddr_t p_req = VMachine::read_builtin_param_ptr(src, &seek);
+
+  uint8_t* req = vm.get_raw_addr(p_req);
+  int64_t sec  = *reinterpret_cast<int64_t*>(req + TIMESPEC_SEC);
+  int64_t nsec = *reinterpret_cast<int64_t*>(req + TIMESPEC_NSEC);
+  if (sec < 0 || nsec < 0 || nsec > 999999999) {
+    errno = EINVAL;
+    write_result(vm, dst, -1);
+    return false;
+  }
+
+  return start_sleep(vm, th, dst,
+		     std::chrono::seconds(sec) + std::chrono::nanoseconds(nsec), 0);
+}
+
+// read関数。
+bool BuiltinPosix::read(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			vaddr_t dst, std::vector<uint8_t>& src) {
+  // パタメタを読み取り
+  int seek = 0;
+  int32_t p_fd = static_cast<int32_t>(VMachine::read_builtin_param_i32(src, &seek));
+  vaddr_t p_buf = VMachine::read_builtin_param_ptr(src, &seek);
+  uint64_t p_count = VMachine::read_builtin_param_i64(src, &seek);
+
+  // 読み込みが完了した場合はデータを仮想メモリへ書き戻す
+  std::vector<uint8_t> result;
+  if (vm.resume_async(th, &result)) {
+    if (th.is_waiting) return true;
+    int64_t ret = get_io_result(vm, dst, result);
+    if (ret > 0 && result.size() >= IO_RESULT_DATA + ret) {
+      std::memcpy(vm.get_raw_addr(p_buf), result.data() + IO_RESULT_DATA, ret);
+    }
+    return false;
+  }
+
+  // 格納先の残りより多くは読み込まない
+  DataStore& store = vm.vmemory.get_data(p_buf);
+  if (VMemory::get_addr_lower(p_buf) > store.size) {
+    throw_error_message(Error::SEGMENT_FAULT, Util::vaddr2str(p_buf));
+  }
+  uint64_t room = store.size - VMemory::get_addr_lower(p_buf);
+  if (p_count > room) p_count = room;
+
+  // 読み込みは仮想メモリに触れないよう、ホストのバッファに読み込む
+  vm.start_async_task(th, [p_fd, p_count](std::vector<uint8_t>& result) {
+      result.resize(IO_RESULT_DATA + p_count);
+      ssize_t ret = ::read(p_fd, result.data() + IO_RESULT_DATA, p_count);
+      set_io_result(result, ret);
+    });
+  return true;
+}
+
 // VMにライブラリを登録する。
 void BuiltinPosix::regist(VMachine& vm) {
   vm.regist_builtin_func("__assert_fail", BuiltinPosix::__assert_fail, 0);
+  vm.regist_builtin_func("nanosleep", BuiltinPosix::nanosleep, 0);
+  vm.regist_builtin_func("sleep", BuiltinPosix::sleep, 0);
+  vm.regist_builtin_func("usleep", BuiltinPosix::usleep, 0);
+
+  // 入出力はlib_filterで許可されている場合のみ組み込み関数に置き換える
+  if (vm.lib_filter.find("read") != vm.lib_filter.end()) {
+    vm.regist_builtin_func("read", BuiltinPosix::read, 0);
+  }
+  if (vm.lib_filter.find("write") != vm.lib_filter.end()) {
+    vm.regist_builtin_func("write", BuiltinPosix::write, 0);
+  }
+}
+
+// sleep関数。
+bool BuiltinPosix::sleep(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			 vaddr_t dst, std::vector<uint8_t>& src) {
+  if (vm.resume_async(th, dst)) return th.is_waiting;
+
+  int seek = 0;
+  uint32_t seconds = VMachine::read_builtin_param_i32(src, &seek);
+
+  return start_sleep(vm, th, dst, std::chrono::seconds(seconds), 0);
+}
+
+// usleep関数。
+bool BuiltinPosix::usleep(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			  vaddr_t dst, std::vector<uint8_t>& src) {
+  if (vm.resume_async(th, dst)) return th.is_waiting;
+
+  int seek = 0;
+  uint32_t usec = VMachine::read_builtin_param_i32(src, &seek);
+
+  return start_sleep(vm, th, dst, std::chrono::microseconds(usec), 0);
+}
+
+// write関数。
+bool BuiltinPosix::write(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			 vaddr_t dst, std::vector<uint8_t>& src) {
+  std::vector<uint8_t> result;
+  if (vm.resume_async(th, &result)) {
+    if (th.is_waiting) return true;
+    get_io_result(vm, dst, result);
+    return false;
+  }
+
+  // パタメタを読み取り
+  int seek = 0;
+  int32_t p_fd = static_cast<int32_t>(VMachine::read_builtin_param_i32(src, &seek));
+  vaddr_t p_buf = VMachine::read_builtin_param_ptr(src, &seek);
+  uint64_t p_count = VMachine::read_builtin_param_i64(src, &seek);
+
+  // 書き込むデータは開始時に仮想メモリからコピーしておく
+  DataStore& store = vm.vmemory.get_data(p_buf);
+  // アクセス違反をチェック
+  if (VMemory::get_addr_lower(p_buf) > store.size ||
+      p_count > store.size - VMemory::get_addr_lower(p_buf)) {
+    throw_error_message(Error::SEGMENT_FAULT, Util::vaddr2str(p_buf));
+  }
+  uint8_t* buf = store.head.get() + VMemory::get_addr_lower(p_buf);
+  std::vector<uint8_t> data(buf, buf + p_count);
+  vm.start_async_task(th, [p_fd, data](std::vector<uint8_t>& result) {
+      ssize_t ret = ::write(p_fd, data.data(), data.size());
+      set_io_result(result, ret);
+    });
+  return true;
 }
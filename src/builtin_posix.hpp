@@ -5,6 +5,9 @@
 namespace processwarp {
   /**
    * POSIXライブラリのうち、LLVM組み込みとして用意するもの。
+   * 時間待ちの関数はタイマーの完了まで呼び出したスレッドを待ち状態にし、他のスレッドやプロセスの実行を止めない。
+   * read、writeはホストのスレッドプールで実行し、完了まで呼び出したスレッドを待ち状態にする。
+   * これらはlib_filterで許可されている場合のみ登録する。
    */
   class BuiltinPosix {
   public:
@@ -19,10 +22,65 @@ namespace processwarp {
     static bool __assert_fail(VMachine& vm, Thread& th, BuiltinFuncParam p,
 			      vaddr_t dst, std::vector<uint8_t>& src);
 
+    /**
+     * nanosleep関数。シグナルで中断されることはないため、remには書き込まない。
+     * srcから取り出すパラメタは以下のとおり。
+     * vaddr_t(const) req 待つ時間(struct timespec)
+     * vaddr_t rem 残り時間の格納先(無視する)
+     * dstへ書き込む値は以下のとおり。
+     * i32 成功時0 失敗時-1
+     */
+    static bool nanosleep(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			  vaddr_t dst, std::vector<uint8_t>& src);
+
+    /**
+     * read関数。
+     * srcから取り出すパラメタは以下のとおり。
+     * i32 fd 読み込むファイルディスクリプタ
+     * vaddr_t buf 読み込んだデータの格納先
+     * i64 count 読み込む最大のバイト数
+     * dstへ書き込む値は以下のとおり。
+     * i64 読み込んだバイト数 失敗時-1
+     */
+    static bool read(VMachine& vm, Thread& th, BuiltinFuncParam p,
+		     vaddr_t dst, std::vector<uint8_t>& src);
+
     /**
      * VMにライブラリを登録する。
      * @param vm 登録対象のVM
      */
     static void regist(VMachine& vm);
+
+    /**
+     * sleep関数。
+     * srcから取り出すパラメタは以下のとおり。
+     * i32 seconds 待つ時間(秒)
+     * dstへ書き込む値は以下のとおり。
+     * i32 残り時間(常に0)
+     */
+    static bool sleep(VMachine& vm, Thread& th, BuiltinFuncParam p,
+		      vaddr_t dst, std::vector<uint8_t>& src);
+
+    /**
+     * usleep関数。
+     * srcから取り出すパラメタは以下のとおり。
+     * i32 usec 待つ時間(マイクロ秒)
+     * dstへ書き込む値は以下のとおり。
+     * i32 成功時0
+     */
+    static bool usleep(VMachine& vm, Thread& th, BuiltinFuncParam p,
+		       vaddr_t dst, std::vector<uint8_t>& src);
+
+    /**
+     * write関数。
+     * srcから取り出すパラメタは以下のとおり。
+     * i32 fd 書き込むファイルディスクリプタ
+     * vaddr_t(const) buf 書き込むデータ
+     * i64 count 書き込むバイト数
+     * dstへ書き込む値は以下のとおり。
+     * i64 書き込んだバイト数 失敗時-1
+     */
+    static bool write(VMachine& vm, Thread& th, BuiltinFuncParam p,
+		      vaddr_t dst, std::vector<uint8_t>& src);
   };
 }
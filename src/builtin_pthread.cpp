@@ -0,0 +1,438 @@
+
+#include <cassert>
+#include <cerrno>
+#include <cinttypes>
+#include <cstring>
+
+#include "builtin_pthread.hpp"
+#include "vmachine.hpp"
+
+using namespace processwarp;
+
+/// pthread_mutex_tのうち、VMで利用するメンバの位置(glibcの配置に合わせる)
+/// 取得されている場合1
+static const size_t MUTEX_LOCK  = 0;
+/// 再帰的に取得した回数
+static const size_t MUTEX_COUNT = 4;
+/// 取得しているスレッドのID
+static const size_t MUTEX_OWNER = 8;
+/// ミューテックスの種類
+static const size_t MUTEX_KIND  = 16;
+
+/// ミューテックスの種類(glibcの値に合わせる)
+static const int32_t MUTEX_NORMAL     = 0;
+static const int32_t MUTEX_RECURSIVE  = 1;
+static const int32_t MUTEX_ERRORCHECK = 2;
+
+/// スレッドを切り離して作成する場合のdetachstate
+static const int32_t CREATE_DETACHED = 1;
+
+// 戻り値のエラー番号を書き込む。
+static void write_result(VMachine& vm, vaddr_t dst, int32_t result) {
+  *reinterpret_cast<int32_t*>(vm.get_raw_addr(dst)) = result;
+}
+
+// 指定したIDのスレッドを取得する。存在しない場合nullptrを戻す。
+static Thread* find_thread(VMachine& vm, vm_uint_t tid) {
+  for (auto& it : vm.threads) {
+    if (it->tid == tid) return it.get();
+  }
+  return nullptr;
+}
+
+// ミューテックスの取得を試みる。
+// 他のスレッドが取得しているため待つ必要がある場合はEBUSYを戻す。
+static int32_t try_lock(VMachine& vm, Thread& th, vaddr_t mutex) {
+  uint8_t* raw = vm.get_raw_addr(mutex);
+  int32_t& lock  = *reinterpret_cast<int32_t*>(raw + MUTEX_LOCK);
+  int32_t& count = *reinterpret_cast<int32_t*>(raw + MUTEX_COUNT);
+  int32_t& owner = *reinterpret_cast<int32_t*>(raw + MUTEX_OWNER);
+  int32_t  kind  = *reinterpret_cast<int32_t*>(raw + MUTEX_KIND);
+
+  if (lock == 0) {
+    lock  = 1;
+    count = 1;
+    owner = static_cast<int32_t>(th.tid);
+    return 0;
+
+  } else if (owner == static_cast<int32_t>(th.tid)) {
+    // 取得済みのスレッドからの取得は種類により動作が異なる
+    if (kind == MUTEX_RECURSIVE) {
+      count ++;
+      return 0;
+    } else if (kind == MUTEX_ERRORCHECK) {
+      return EDEADLK;
+    }
+  }
+  return EBUSY;
+}
+
+// ミューテックスを開放する。
+static int32_t unlock(VMachine& vm, Thread& th, vaddr_t mutex) {
+  uint8_t* raw = vm.get_raw_addr(mutex);
+  int32_t& lock  = *reinterpret_cast<int32_t*>(raw + MUTEX_LOCK);
+  int32_t& count = *reinterpret_cast<int32_t*>(raw + MUTEX_COUNT);
+  int32_t& owner = *reinterpret_cast<int32_t*>(raw + MUTEX_OWNER);
+  int32_t  kind  = *reinterpret_cast<int32_t*>(raw + MUTEX_KIND);
+
+  if (lock == 0 || owner != static_cast<int32_t>(th.tid)) {
+    // 通常のミューテックスは取得していないスレッドからの開放を検査しない
+    if (kind != MUTEX_NORMAL) return EPERM;
+  }
+  if (kind == MUTEX_RECURSIVE && -- count > 0) return 0;
+
+  lock  = 0;
+  count = 0;
+  owner = 0;
+  return 0;
+}
+
+// スレッドを待ち状態にする。CALL命令は次に実行する時にやり直す。
+static bool wait(Thread& th) {
+  th.is_waiting = true;
+  return true;
+}
+
+// pthread_attr_destroy関数。
+bool BuiltinPthread::attr_destroy(VMachine& vm, Thread& th, BuiltinFuncParam p,
+				  vaddr_t dst, std::vector<uint8_t>& src) {
+  write_result(vm, dst, 0);
+  return false;
+}
+
+// pthread_attr_init関数。
+bool BuiltinPthread::attr_init(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			       vaddr_t dst, std::vector<uint8_t>& src) {
+  int seek = 0;
+  vaddr_t attr = VMachine::read_builtin_param_ptr(src, &seek);
+  // 先頭をdetachstateとして利用する
+  *reinterpret_cast<int32_t*>(vm.get_raw_addr(attr)) = 0;
+  write_result(vm, dst, 0);
+  return false;
+}
+
+// pthread_attr_setdetachstate関数。
+bool BuiltinPthread::attr_setdetachstate(VMachine& vm, Thread& th, BuiltinFuncParam p,
+					 vaddr_t dst, std::vector<uint8_t>& src) {
+  int seek = 0;
+  vaddr_t attr = VMachine::read_builtin_param_ptr(src, &seek);
+  int32_t detachstate = static_cast<int32_t>(VMachine::read_builtin_param_i32(src, &seek));
+
+  if (detachstate != 0 && detachstate != CREATE_DETACHED) {
+    write_result(vm, dst, EINVAL);
+    return false;
+  }
+  *reinterpret_cast<int32_t*>(vm.get_raw_addr(attr)) = detachstate;
+  write_result(vm, dst, 0);
+  return false;
+}
+
+// pthread_cond_broadcast関数。
+bool BuiltinPthread::cond_broadcast(VMachine& vm, Thread& th, BuiltinFuncParam p,
+				    vaddr_t dst, std::vector<uint8_t>& src) {
+  int seek = 0;
+  vaddr_t cond = VMachine::read_builtin_param_ptr(src, &seek);
+
+  for (auto& it : vm.threads) {
+    if (it->waiting_cond == cond) it->is_signaled = true;
+  }
+  write_result(vm, dst, 0);
+  return false;
+}
+
+// pthread_cond_destroy関数。
+bool BuiltinPthread::cond_destroy(VMachine& vm, Thread& th, BuiltinFuncParam p,
+				  vaddr_t dst, std::vector<uint8_t>& src) {
+  write_result(vm, dst, 0);
+  return false;
+}
+
+// pthread_cond_init関数。
+bool BuiltinPthread::cond_init(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			       vaddr_t dst, std::vector<uint8_t>& src) {
+  write_result(vm, dst, 0);
+  return false;
+}
+
+// pthread_cond_signal関数。
+bool BuiltinPthread::cond_signal(VMachine& vm, Thread& th, BuiltinFuncParam p,
+				 vaddr_t dst, std::vector<uint8_t>& src) {
+  int seek = 0;
+  vaddr_t cond = VMachine::read_builtin_param_ptr(src, &seek);
+
+  for (auto& it : vm.threads) {
+    if (it->waiting_cond == cond && !it->is_signaled) {
+      it->is_signaled = true;
+      break;
+    }
+  }
+  write_result(vm, dst, 0);
+  return false;
+}
+
+// pthread_cond_wait関数。
+bool BuiltinPthread::cond_wait(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			       vaddr_t dst, std::vector<uint8_t>& src) {
+  int seek = 0;
+  vaddr_t cond  = VMachine::read_builtin_param_ptr(src, &seek);
+  vaddr_t mutex = VMachine::read_builtin_param_ptr(src, &seek);
+
+  // 最初の呼び出しではミューテックスを開放して待ち状態になる
+  if (th.waiting_cond == VADDR_NON) {
+    int32_t result = unlock(vm, th, mutex);
+    if (result != 0) {
+      write_result(vm, dst, result);
+      return false;
+    }
+    th.waiting_cond = cond;
+    th.is_signaled  = false;
+    return wait(th);
+  }
+
+  // シグナルを受け取った後、ミューテックスを取得できるまで待つ
+  if (!th.is_signaled || try_lock(vm, th, mutex) == EBUSY) {
+    return wait(th);
+  }
+  th.waiting_cond = VADDR_NON;
+  th.is_signaled  = false;
+  write_result(vm, dst, 0);
+  return false;
+}
+
+// pthread_create関数。
+bool BuiltinPthread::create(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			    vaddr_t dst, std::vector<uint8_t>& src) {
+  int seek = 0;
+  vaddr_t thread = VMachine::read_builtin_param_ptr(src, &seek);
+  vaddr_t attr   = VMachine::read_builtin_param_ptr(src, &seek);
+  vaddr_t func   = VMachine::read_builtin_param_ptr(src, &seek);
+  vaddr_t arg    = VMachine::read_builtin_param_ptr(src, &seek);
+
+  Thread& new_thread = vm.create_thread(func, arg);
+  if (attr != VADDR_NULL &&
+      *reinterpret_cast<int32_t*>(vm.get_raw_addr(attr)) == CREATE_DETACHED) {
+    new_thread.is_detached = true;
+  }
+  *reinterpret_cast<vm_uint_t*>(vm.get_raw_addr(thread)) = new_thread.tid;
+  write_result(vm, dst, 0);
+  return false;
+}
+
+// pthread_detach関数。
+bool BuiltinPthread::detach(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			    vaddr_t dst, std::vector<uint8_t>& src) {
+  int seek = 0;
+  vm_uint_t tid = VMachine::read_builtin_param_i64(src, &seek);
+
+  Thread* target = find_thread(vm, tid);
+  if (target == nullptr) {
+    write_result(vm, dst, ESRCH);
+  } else if (target->is_detached) {
+    write_result(vm, dst, EINVAL);
+  } else {
+    // 終了済みのスレッドも次に順番が来た時に開放される
+    target->is_detached = true;
+    write_result(vm, dst, 0);
+  }
+  return false;
+}
+
+// pthread_equal関数。
+bool BuiltinPthread::equal(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			   vaddr_t dst, std::vector<uint8_t>& src) {
+  int seek = 0;
+  vm_uint_t t1 = VMachine::read_builtin_param_i64(src, &seek);
+  vm_uint_t t2 = VMachine::read_builtin_param_i64(src, &seek);
+  write_result(vm, dst, t1 == t2 ? 1 : 0);
+  return false;
+}
+
+// pthread_exit関数。
+bool BuiltinPthread::exit(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			  vaddr_t dst, std::vector<uint8_t>& src) {
+  int seek = 0;
+  vaddr_t retval = VMachine::read_builtin_param_ptr(src, &seek);
+
+  if (th.tid == MAIN_THREAD_ID) {
+    // mainのスレッドは他のスレッドが全て終了するまで待ち、終了コード0で終了する
+    for (auto& it : vm.threads) {
+      if (it.get() != &th && !it->is_finished) return wait(th);
+    }
+    *reinterpret_cast<uint32_t*>(vm.get_raw_addr(th.stackinfos.at(0)->stack)) = 0;
+
+  } else {
+    // 開始関数から戻った時と同じく、戻り値の格納先に書き込む
+    *reinterpret_cast<vaddr_t*>(vm.get_raw_addr(th.stackinfos.at(0)->stack)) = retval;
+  }
+
+  // スタックを1段残して開放する
+  while (th.stackinfos.size() > 1) {
+    vm.free_stackinfo(th, std::move(th.stackinfos.back()));
+    th.stackinfos.pop_back();
+  }
+  return true;
+}
+
+// pthread_join関数。
+bool BuiltinPthread::join(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			  vaddr_t dst, std::vector<uint8_t>& src) {
+  int seek = 0;
+  vm_uint_t tid  = VMachine::read_builtin_param_i64(src, &seek);
+  vaddr_t retval = VMachine::read_builtin_param_ptr(src, &seek);
+
+  if (tid == th.tid) {
+    write_result(vm, dst, EDEADLK);
+    return false;
+  }
+  Thread* target = find_thread(vm, tid);
+  if (target == nullptr) {
+    write_result(vm, dst, ESRCH);
+    return false;
+  } else if (target->is_detached) {
+    write_result(vm, dst, EINVAL);
+    return false;
+  }
+
+  // 終了するまで待つ
+  if (!target->is_finished) return wait(th);
+
+  if (retval != VADDR_NULL) {
+    *reinterpret_cast<vaddr_t*>(vm.get_raw_addr(retval)) =
+      *reinterpret_cast<vaddr_t*>(vm.get_raw_addr(target->stackinfos.at(0)->stack));
+  }
+  vm.free_thread(*target);
+  write_result(vm, dst, 0);
+  return false;
+}
+
+// pthread_mutex_destroy関数。
+bool BuiltinPthread::mutex_destroy(VMachine& vm, Thread& th, BuiltinFuncParam p,
+				   vaddr_t dst, std::vector<uint8_t>& src) {
+  int seek = 0;
+  vaddr_t mutex = VMachine::read_builtin_param_ptr(src, &seek);
+
+  uint8_t* raw = vm.get_raw_addr(mutex);
+  write_result(vm, dst, *reinterpret_cast<int32_t*>(raw + MUTEX_LOCK) == 0 ? 0 : EBUSY);
+  return false;
+}
+
+// pthread_mutex_init関数。
+bool BuiltinPthread::mutex_init(VMachine& vm, Thread& th, BuiltinFuncParam p,
+				vaddr_t dst, std::vector<uint8_t>& src) {
+  int seek = 0;
+  vaddr_t mutex = VMachine::read_builtin_param_ptr(src, &seek);
+  vaddr_t attr  = VMachine::read_builtin_param_ptr(src, &seek);
+
+  uint8_t* raw = vm.get_raw_addr(mutex);
+  *reinterpret_cast<int32_t*>(raw + MUTEX_LOCK)  = 0;
+  *reinterpret_cast<int32_t*>(raw + MUTEX_COUNT) = 0;
+  *reinterpret_cast<int32_t*>(raw + MUTEX_OWNER) = 0;
+  *reinterpret_cast<int32_t*>(raw + MUTEX_KIND)  =
+    (attr == VADDR_NULL ? MUTEX_NORMAL : *reinterpret_cast<int32_t*>(vm.get_raw_addr(attr)));
+  write_result(vm, dst, 0);
+  return false;
+}
+
+// pthread_mutex_lock関数。
+bool BuiltinPthread::mutex_lock(VMachine& vm, Thread& th, BuiltinFuncParam p,
+				vaddr_t dst, std::vector<uint8_t>& src) {
+  int seek = 0;
+  vaddr_t mutex = VMachine::read_builtin_param_ptr(src, &seek);
+
+  int32_t result = try_lock(vm, th, mutex);
+  if (result == EBUSY) return wait(th);
+  write_result(vm, dst, result);
+  return false;
+}
+
+// pthread_mutex_trylock関数。
+bool BuiltinPthread::mutex_trylock(VMachine& vm, Thread& th, BuiltinFuncParam p,
+				   vaddr_t dst, std::vector<uint8_t>& src) {
+  int seek = 0;
+  vaddr_t mutex = VMachine::read_builtin_param_ptr(src, &seek);
+
+  int32_t result = try_lock(vm, th, mutex);
+  // 取得済みのスレッドからの場合も取得できなかったものとする
+  write_result(vm, dst, result == EDEADLK ? EBUSY : result);
+  return false;
+}
+
+// pthread_mutex_unlock関数。
+bool BuiltinPthread::mutex_unlock(VMachine& vm, Thread& th, BuiltinFuncParam p,
+				  vaddr_t dst, std::vector<uint8_t>& src) {
+  int seek = 0;
+  vaddr_t mutex = VMachine::read_builtin_param_ptr(src, &seek);
+  write_result(vm, dst, unlock(vm, th, mutex));
+  return false;
+}
+
+// pthread_mutexattr_destroy関数。
+bool BuiltinPthread::mutexattr_destroy(VMachine& vm, Thread& th, BuiltinFuncParam p,
+				       vaddr_t dst, std::vector<uint8_t>& src) {
+  write_result(vm, dst, 0);
+  return false;
+}
+
+// pthread_mutexattr_init関数。
+bool BuiltinPthread::mutexattr_init(VMachine& vm, Thread& th, BuiltinFuncParam p,
+				    vaddr_t dst, std::vector<uint8_t>& src) {
+  int seek = 0;
+  vaddr_t attr = VMachine::read_builtin_param_ptr(src, &seek);
+  // 先頭をミューテックスの種類として利用する
+  *reinterpret_cast<int32_t*>(vm.get_raw_addr(attr)) = MUTEX_NORMAL;
+  write_result(vm, dst, 0);
+  return false;
+}
+
+// pthread_mutexattr_settype関数。
+bool BuiltinPthread::mutexattr_settype(VMachine& vm, Thread& th, BuiltinFuncParam p,
+				       vaddr_t dst, std::vector<uint8_t>& src) {
+  int seek = 0;
+  vaddr_t attr = VMachine::read_builtin_param_ptr(src, &seek);
+  int32_t kind = static_cast<int32_t>(VMachine::read_builtin_param_i32(src, &seek));
+
+  if (kind != MUTEX_NORMAL && kind != MUTEX_RECURSIVE && kind != MUTEX_ERRORCHECK) {
+    write_result(vm, dst, EINVAL);
+    return false;
+  }
+  *reinterpret_cast<int32_t*>(vm.get_raw_addr(attr)) = kind;
+  write_result(vm, dst, 0);
+  return false;
+}
+
+// VMにライブラリを登録する。
+void BuiltinPthread::regist(VMachine& vm) {
+  vm.regist_builtin_func("pthread_attr_destroy", BuiltinPthread::attr_destroy, 0);
+  vm.regist_builtin_func("pthread_attr_init", BuiltinPthread::attr_init, 0);
+  vm.regist_builtin_func("pthread_attr_setdetachstate", BuiltinPthread::attr_setdetachstate, 0);
+
+  vm.regist_builtin_func("pthread_cond_broadcast", BuiltinPthread::cond_broadcast, 0);
+  vm.regist_builtin_func("pthread_cond_destroy", BuiltinPthread::cond_destroy, 0);
+  vm.regist_builtin_func("pthread_cond_init", BuiltinPthread::cond_init, 0);
+  vm.regist_builtin_func("pthread_cond_signal", BuiltinPthread::cond_signal, 0);
+  vm.regist_builtin_func("pthread_cond_wait", BuiltinPthread::cond_wait, 0);
+
+  vm.regist_builtin_func("pthread_create", BuiltinPthread::create, 0);
+  vm.regist_builtin_func("pthread_detach", BuiltinPthread::detach, 0);
+  vm.regist_builtin_func("pthread_equal", BuiltinPthread::equal, 0);
+  vm.regist_builtin_func("pthread_exit", BuiltinPthread::exit, 0);
+  vm.regist_builtin_func("pthread_join", BuiltinPthread::join, 0);
+  vm.regist_builtin_func("pthread_self", BuiltinPthread::self, 0);
+
+  vm.regist_builtin_func("pthread_mutex_destroy", BuiltinPthread::mutex_destroy, 0);
+  vm.regist_builtin_func("pthread_mutex_init", BuiltinPthread::mutex_init, 0);
+  vm.regist_builtin_func("pthread_mutex_lock", BuiltinPthread::mutex_lock, 0);
+  vm.regist_builtin_func("pthread_mutex_trylock", BuiltinPthread::mutex_trylock, 0);
+  vm.regist_builtin_func("pthread_mutex_unlock", BuiltinPthread::mutex_unlock, 0);
+
+  vm.regist_builtin_func("pthread_mutexattr_destroy", BuiltinPthread::mutexattr_destroy, 0);
+  vm.regist_builtin_func("pthread_mutexattr_init", BuiltinPthread::mutexattr_init, 0);
+  vm.regist_builtin_func("pthread_mutexattr_settype", BuiltinPthread::mutexattr_settype, 0);
+}
+
+// pthread_self関数。
+bool BuiltinPthread::self(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			  vaddr_t dst, std::vector<uint8_t>& src) {
+  *reinterpret_cast<vm_uint_t*>(vm.get_raw_addr(dst)) = th.tid;
+  return false;
+}
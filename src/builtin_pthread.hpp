@@ -0,0 +1,251 @@
+#pragma once
+
+#include "definitions.hpp"
+
+namespace processwarp {
+  /**
+   * POSIXスレッドライブラリのうち、LLVM組み込みとして用意するもの。
+   * スレッドはVMの中で順番に切り替えながら実行する。
+   * 待ちになる関数は呼び出したスレッドを待ち状態にし、次に実行する時に呼び出しからやり直す。
+   */
+  class BuiltinPthread {
+  public:
+    /**
+     * pthread_attr_destroy関数。
+     * srcから取り出すパラメタは以下のとおり。
+     * vaddr_t attr 属性
+     * dstへ書き込む値は以下のとおり。
+     * i32 成功時0
+     */
+    static bool attr_destroy(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			     vaddr_t dst, std::vector<uint8_t>& src);
+
+    /**
+     * pthread_attr_init関数。
+     * srcから取り出すパラメタは以下のとおり。
+     * vaddr_t attr 初期化する属性
+     * dstへ書き込む値は以下のとおり。
+     * i32 成功時0
+     */
+    static bool attr_init(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			  vaddr_t dst, std::vector<uint8_t>& src);
+
+    /**
+     * pthread_attr_setdetachstate関数。
+     * srcから取り出すパラメタは以下のとおり。
+     * vaddr_t attr 属性
+     * i32 detachstate PTHREAD_CREATE_JOINABLE or PTHREAD_CREATE_DETACHED
+     * dstへ書き込む値は以下のとおり。
+     * i32 成功時0 失敗時エラー番号
+     */
+    static bool attr_setdetachstate(VMachine& vm, Thread& th, BuiltinFuncParam p,
+				    vaddr_t dst, std::vector<uint8_t>& src);
+
+    /**
+     * pthread_cond_broadcast関数。条件変数で待っている全てのスレッドを再開させる。
+     * srcから取り出すパラメタは以下のとおり。
+     * vaddr_t cond 条件変数
+     * dstへ書き込む値は以下のとおり。
+     * i32 成功時0
+     */
+    static bool cond_broadcast(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			       vaddr_t dst, std::vector<uint8_t>& src);
+
+    /**
+     * pthread_cond_destroy関数。
+     * srcから取り出すパラメタは以下のとおり。
+     * vaddr_t cond 条件変数
+     * dstへ書き込む値は以下のとおり。
+     * i32 成功時0
+     */
+    static bool cond_destroy(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			     vaddr_t dst, std::vector<uint8_t>& src);
+
+    /**
+     * pthread_cond_init関数。
+     * 条件変数で待っているスレッドはThreadに記録するため、条件変数の領域は利用しない。
+     * srcから取り出すパラメタは以下のとおり。
+     * vaddr_t cond 条件変数
+     * vaddr_t attr 属性(無視する)
+     * dstへ書き込む値は以下のとおり。
+     * i32 成功時0
+     */
+    static bool cond_init(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			  vaddr_t dst, std::vector<uint8_t>& src);
+
+    /**
+     * pthread_cond_signal関数。条件変数で待っているスレッドを1つ再開させる。
+     * srcから取り出すパラメタは以下のとおり。
+     * vaddr_t cond 条件変数
+     * dstへ書き込む値は以下のとおり。
+     * i32 成功時0
+     */
+    static bool cond_signal(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			    vaddr_t dst, std::vector<uint8_t>& src);
+
+    /**
+     * pthread_cond_wait関数。
+     * ミューテックスを開放してシグナルを待ち、受け取った後にミューテックスを取得し直す。
+     * srcから取り出すパラメタは以下のとおり。
+     * vaddr_t cond 条件変数
+     * vaddr_t mutex 取得済みのミューテックス
+     * dstへ書き込む値は以下のとおり。
+     * i32 成功時0 失敗時エラー番号
+     */
+    static bool cond_wait(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			  vaddr_t dst, std::vector<uint8_t>& src);
+
+    /**
+     * pthread_create関数。
+     * srcから取り出すパラメタは以下のとおり。
+     * vaddr_t thread 作成したスレッドのIDの格納先
+     * vaddr_t attr 属性(NULLの場合は既定値)
+     * vaddr_t start_routine 開始関数
+     * vaddr_t arg 開始関数に渡す引数
+     * dstへ書き込む値は以下のとおり。
+     * i32 成功時0
+     */
+    static bool create(VMachine& vm, Thread& th, BuiltinFuncParam p,
+		       vaddr_t dst, std::vector<uint8_t>& src);
+
+    /**
+     * pthread_detach関数。
+     * 切り離したスレッドは終了した後に開放する。
+     * srcから取り出すパラメタは以下のとおり。
+     * i64 thread スレッドID
+     * dstへ書き込む値は以下のとおり。
+     * i32 成功時0 失敗時エラー番号
+     */
+    static bool detach(VMachine& vm, Thread& th, BuiltinFuncParam p,
+		       vaddr_t dst, std::vector<uint8_t>& src);
+
+    /**
+     * pthread_equal関数。
+     * srcから取り出すパラメタは以下のとおり。
+     * i64 t1 スレッドID
+     * i64 t2 スレッドID
+     * dstへ書き込む値は以下のとおり。
+     * i32 同じスレッドの場合0以外
+     */
+    static bool equal(VMachine& vm, Thread& th, BuiltinFuncParam p,
+		      vaddr_t dst, std::vector<uint8_t>& src);
+
+    /**
+     * pthread_exit関数。
+     * mainのスレッドから呼び出した場合は他のスレッドの終了を待ってからプロセスを終了する。
+     * srcから取り出すパラメタは以下のとおり。
+     * vaddr_t retval joinしたスレッドに渡す値
+     */
+    static bool exit(VMachine& vm, Thread& th, BuiltinFuncParam p,
+		     vaddr_t dst, std::vector<uint8_t>& src);
+
+    /**
+     * pthread_join関数。
+     * スレッドの終了を待ち、終了したスレッドを開放する。
+     * srcから取り出すパラメタは以下のとおり。
+     * i64 thread スレッドID
+     * vaddr_t retval 開始関数の戻り値の格納先(NULLの場合は格納しない)
+     * dstへ書き込む値は以下のとおり。
+     * i32 成功時0 失敗時エラー番号
+     */
+    static bool join(VMachine& vm, Thread& th, BuiltinFuncParam p,
+		     vaddr_t dst, std::vector<uint8_t>& src);
+
+    /**
+     * pthread_mutex_destroy関数。
+     * srcから取り出すパラメタは以下のとおり。
+     * vaddr_t mutex ミューテックス
+     * dstへ書き込む値は以下のとおり。
+     * i32 成功時0 失敗時エラー番号
+     */
+    static bool mutex_destroy(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			      vaddr_t dst, std::vector<uint8_t>& src);
+
+    /**
+     * pthread_mutex_init関数。
+     * srcから取り出すパラメタは以下のとおり。
+     * vaddr_t mutex 初期化するミューテックス
+     * vaddr_t attr 属性(NULLの場合は既定値)
+     * dstへ書き込む値は以下のとおり。
+     * i32 成功時0
+     */
+    static bool mutex_init(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			   vaddr_t dst, std::vector<uint8_t>& src);
+
+    /**
+     * pthread_mutex_lock関数。
+     * 他のスレッドが取得している場合は開放されるまで待つ。
+     * srcから取り出すパラメタは以下のとおり。
+     * vaddr_t mutex ミューテックス
+     * dstへ書き込む値は以下のとおり。
+     * i32 成功時0 失敗時エラー番号
+     */
+    static bool mutex_lock(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			   vaddr_t dst, std::vector<uint8_t>& src);
+
+    /**
+     * pthread_mutex_trylock関数。
+     * srcから取り出すパラメタは以下のとおり。
+     * vaddr_t mutex ミューテックス
+     * dstへ書き込む値は以下のとおり。
+     * i32 成功時0 失敗時エラー番号
+     */
+    static bool mutex_trylock(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			      vaddr_t dst, std::vector<uint8_t>& src);
+
+    /**
+     * pthread_mutex_unlock関数。
+     * srcから取り出すパラメタは以下のとおり。
+     * vaddr_t mutex ミューテックス
+     * dstへ書き込む値は以下のとおり。
+     * i32 成功時0 失敗時エラー番号
+     */
+    static bool mutex_unlock(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			     vaddr_t dst, std::vector<uint8_t>& src);
+
+    /**
+     * pthread_mutexattr_destroy関数。
+     * srcから取り出すパラメタは以下のとおり。
+     * vaddr_t attr 属性
+     * dstへ書き込む値は以下のとおり。
+     * i32 成功時0
+     */
+    static bool mutexattr_destroy(VMachine& vm, Thread& th, BuiltinFuncParam p,
+				  vaddr_t dst, std::vector<uint8_t>& src);
+
+    /**
+     * pthread_mutexattr_init関数。
+     * srcから取り出すパラメタは以下のとおり。
+     * vaddr_t attr 初期化する属性
+     * dstへ書き込む値は以下のとおり。
+     * i32 成功時0
+     */
+    static bool mutexattr_init(VMachine& vm, Thread& th, BuiltinFuncParam p,
+			       vaddr_t dst, std::vector<uint8_t>& src);
+
+    /**
+     * pthread_mutexattr_settype関数。
+     * srcから取り出すパラメタは以下のとおり。
+     * vaddr_t attr 属性
+     * i32 type ミューテックスの種類
+     * dstへ書き込む値は以下のとおり。
+     * i32 成功時0 失敗時エラー番号
+     */
+    static bool mutexattr_settype(VMachine& vm, Thread& th, BuiltinFuncParam p,
+				  vaddr_t dst, std::vector<uint8_t>& src);
+
+    /**
+     * VMにライブラリを登録する。
+     * @param vm 登録対象のVM
+     */
+    static void regist(VMachine& vm);
+
+    /**
+     * pthread_self関数。
+     * dstへ書き込む値は以下のとおり。
+     * i64 呼び出したスレッドのID
+     */
+    static bool self(VMachine& vm, Thread& th, BuiltinFuncParam p,
+		     vaddr_t dst, std::vector<uint8_t>& src);
+  };
+}
@@ -39,7 +39,8 @@ bool BuiltinWarp::poll_warp_request(VMachine& vm, Thread& th, BuiltinFuncParam p
   // Size of src must be same as parameter read.
   assert(static_cast<signed>(src.size()) == 0);
 
-  if (vm.status == VMachine::WAIT_WARP) {
+  // スレッドが複数ある間は全てを送れないので、warpを始めない
+  if (vm.status == VMachine::WAIT_WARP && vm.threads.size() == 1) {
     vm.warp_stack_size = th.stackinfos.size();
     vm.warp_call_count = 0;
     vm.status = VMachine::BEFOR_WARP;
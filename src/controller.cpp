@@ -1,4 +1,10 @@
 
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+#include <chrono>
+
 #include "controller.hpp"
 #include "convert.hpp"
 #include "definitions.hpp"
@@ -36,31 +42,99 @@ void ControllerDelegate::on_error(const std::string& pid,
   // Do nothing.
 }
 
+// Call when worker returned a process.
+void ControllerDelegate::wake_loop() {
+  // Do nothing.
+}
+
+// Constructor.
+Controller::Process::Process(const std::string& pid_, VMachine* vm_) :
+  pid(pid_),
+  vm(vm_),
+  is_ready(false),
+  is_scheduled(false),
+  is_deleted(false),
+  is_error(false),
+  quantum(DEFAULT_QUANTUM),
+  clock_cost(0) {
+}
+
 // Constractor with delegate.
 Controller::Controller(ControllerDelegate& _delegate) :
-  delegate(_delegate) {
+  delegate(_delegate),
+  latency_target(0),
+  runnable_num(0),
+  next_worker(0),
+  scheduled_num(0),
+  queued_num(0),
+  idle_num(0),
+  is_stopping(false) {
   // Do nothing.
 }
 
+// Destructor.
+Controller::~Controller() {
+  {
+    std::lock_guard<std::mutex> lock(idle_mutex);
+    is_stopping = true;
+  }
+  idle_cond.notify_all();
+
+  for (auto& worker : workers) {
+    worker->thread.join();
+  }
+}
+
 // Main loop.
 void Controller::loop() {
-  std::string pid;
-  VMachine* vm;
+  unsigned int runnable_count = 0;
 
-  try {
-    auto it = procs.begin();
-    while (it != procs.end()) {
-      pid = it->first;
-      vm  = it->second.get();
+  // Take processes returned from workers or woken by async calls.
+  {
+    std::vector<std::shared_ptr<Process>> returned;
+    {
+      std::lock_guard<std::mutex> lock(returned_mutex);
+      returned.swap(returned_procs);
+    }
+    for (auto& it : returned) {
+      set_ready(it);
+    }
+  }
+
+  // Processes added while this pass are visited in next pass.
+  for (size_t count = ready_queue.size(); count > 0; count --) {
+    std::shared_ptr<Process> proc = ready_queue.front();
+    ready_queue.pop_front();
+    proc->is_ready = false;
+    if (proc->is_deleted) continue;
+    const std::string pid = proc->pid;
+    VMachine* vm = proc->vm.get();
+
+    try {
+      // Report error rised in worker.
+      if (proc->is_error) {
+	delegate.on_error(pid, proc->error_message);
+	proc->is_error = false;
+      }
+
+      if (is_runnable(vm->status)) {
+	if (vm->is_blocked()) {
+	  // Parked until an async call completes and wakes the process.
 
-      if (vm->status == VMachine::ACTIVE ||
-	  vm->status == VMachine::WAIT_WARP ||
-	  vm->status == VMachine::BEFOR_WARP ||
-	  vm->status == VMachine::AFTER_WARP) {
+	} else if (workers.empty()) {
+	  runnable_count ++;
+	  delegate.on_switch_proccess(pid);
+	  // Execute llvm cycle.
+	  execute_quantum(*proc);
+	  // Visit again to execute or to report the changed status.
+	  set_ready(proc);
 
-	delegate.on_switch_proccess(pid);
-	// Execute llvm cycle.
-	vm->execute(100);
+	} else {
+	  proc->is_scheduled = true;
+	  scheduled_num ++;
+	  schedule_process(proc, next_worker);
+	  next_worker = (next_worker + 1) % workers.size();
+	}
 
       } else if (vm->status == VMachine::WARP) {
 	do_warp_process(pid);
@@ -70,28 +144,40 @@ void Controller::loop() {
 	
       } else if (vm->status == VMachine::FINISH) {
 	delegate.on_finish_proccess(pid);
-	it = procs.erase(it);
-	continue;
+	proc->is_deleted = true;
+	procs.erase(pid);
       }
-      it ++;
+      // Other processes are parked until the status is changed by controller.
+      
+    } catch (Error e) {
+      delegate.on_error(pid, "");
+      vm->status = VMachine::FINISH;
+      set_ready(proc);
+      
+    } catch (const std::exception& e) {
+      delegate.on_error(pid, e.what());
+      vm->status = VMachine::FINISH;
+      set_ready(proc);
+      
+    } catch (...) {
+      delegate.on_error(pid, "unknown exception");
+      vm->status = VMachine::FINISH;
+      set_ready(proc);
     }
-    
-  } catch (Error e) {
-    delegate.on_error(pid, "");
-    vm->status = VMachine::FINISH;
-    
-  } catch (std::exception e) {
-    delegate.on_error(pid, e.what());
-    vm->status = VMachine::FINISH;
-    
-  } catch (...) {
-    delegate.on_error(pid, "unknown exception");
-    vm->status = VMachine::FINISH;
   }
+  runnable_num = (workers.empty() ? runnable_count : scheduled_num.load());
   
   delegate.on_switch_proccess("");
 }
     
+// Check loop() has nothing to do.
+bool Controller::is_idle() {
+  if (!ready_queue.empty()) return false;
+
+  std::lock_guard<std::mutex> lock(returned_mutex);
+  return returned_procs.empty();
+}
+
 // Pass data from other device.
 bool Controller::recv_warp_data(const std::string& pid,
 				const std::string& tid,
@@ -123,7 +209,7 @@ bool Controller::recv_warp_data(const std::string& pid,
     std::cerr << e.reason << ":" << e.mesg << std::endl;
     return false;
     
-  } catch (std::exception e) {
+  } catch (const std::exception& e) {
     std::cerr << e.what() << std::endl;
     return false;
     
@@ -138,14 +224,24 @@ void Controller::create_process(const std::string& pid,
 				std::vector<void*> libs,
 				const std::map<std::string, std::string>& lib_filter) {
   assert(procs.find(pid) == procs.end());
-  procs.insert(std::make_pair(pid, std::shared_ptr<VMachine>
-			      (new VMachine(libs, lib_filter))));
-  procs.at(pid)->setup();
+  std::shared_ptr<Process> proc(new Process(pid, new VMachine(libs, lib_filter)));
+  procs.insert(std::make_pair(pid, proc));
+
+  // Async calls complete on host threads, wake the process from there.
+  std::weak_ptr<Process> weak_proc = proc;
+  proc->vm->async_handler = [this, weak_proc] { wake_process(weak_proc); };
+  proc->vm->setup();
 }
 
 // Delete process.
 void Controller::delete_process(const std::string& pid) {
   if (procs.find(pid) == procs.end()) return;
+  {
+    // Worker or loop() drops deleted process when it is visited next.
+    Process& proc = *procs.at(pid);
+    std::lock_guard<std::mutex> lock(proc.mutex);
+    proc.is_deleted = true;
+  }
   procs.erase(pid);
   warp_dest.erase(pid);
 }
@@ -153,7 +249,12 @@ void Controller::delete_process(const std::string& pid) {
 // Start exiting process.
 void Controller::exit_process(const std::string& pid) {
   if (procs.find(pid) == procs.end()) return;
-  procs.at(pid)->exit();
+  std::shared_ptr<Process> proc = procs.at(pid);
+  {
+    std::lock_guard<std::mutex> lock(proc->mutex);
+    proc->vm->exit();
+  }
+  set_ready(proc);
 }
 
 // Start warp process.
@@ -161,12 +262,46 @@ void Controller::warp_process(const std::string& pid,
 			      const std::string& dst_device_id) {
   warp_dest[pid] = dst_device_id;
   // Change vm's status for setup to warp.
-  procs.at(pid)->setup_warpin(device_id);
+  std::shared_ptr<Process> proc = procs.at(pid);
+  {
+    std::lock_guard<std::mutex> lock(proc->mutex);
+    proc->vm->setup_warpin(device_id);
+  }
+  set_ready(proc);
+}
+
+// Set latency target.
+void Controller::set_latency_target(unsigned int usec) {
+  latency_target = usec;
+}
+
+// Start worker threads to execute processes on multiple cores.
+void Controller::start_workers(unsigned int num, bool is_pinned) {
+  assert(workers.empty());
+  // Workers refer each other's run queue, so create all before starting threads.
+  for (unsigned int i = 0; i < num; i ++) {
+    workers.push_back(std::unique_ptr<Worker>(new Worker()));
+  }
+
+  unsigned int cpu_num = std::thread::hardware_concurrency();
+  for (unsigned int i = 0; i < num; i ++) {
+    Worker& worker = *workers.at(i);
+    worker.thread = std::thread(&Controller::run_worker, this, i);
+
+#ifdef __linux__
+    if (is_pinned && cpu_num != 0) {
+      cpu_set_t cpuset;
+      CPU_ZERO(&cpuset);
+      CPU_SET(i % cpu_num, &cpuset);
+      pthread_setaffinity_np(worker.thread.native_handle(), sizeof(cpu_set_t), &cpuset);
+    }
+#endif
+  }
 }
 
 // Dump and send data to warp process. 
 void Controller::do_warp_process(std::string pid) {
-  VMachine& vm      = *procs.at(pid);
+  VMachine& vm      = *procs.at(pid)->vm;
   VMemory&  vmemory = vm.vmemory;
   
   // Dump process.
@@ -184,6 +319,11 @@ void Controller::do_warp_process(std::string pid) {
     if (it == VADDR_NULL || it == VADDR_NON) continue;
     // Don't export build in instance.
     if (vm.builtin_addrs.find(it) != vm.builtin_addrs.end()) continue;
+    // Stack segment is exported with thread.
+    if (it == vm.threads.back()->stack_segment) {
+      vmemory.free(it);
+      continue;
+    }
     
     dump.insert(std::make_pair(Util::vaddr2str(it), convert.export_store(it, related)));
     // Free allocated data.
@@ -201,7 +341,9 @@ void Controller::do_warp_process(std::string pid) {
 }
 
 void Controller::recv_process_warp(std::string pid, picojson::object& json) {
-  VMachine& vm      = *procs.at(pid);
+  std::shared_ptr<Process> proc = procs.at(pid);
+  std::lock_guard<std::mutex> lock(proc->mutex);
+  VMachine& vm      = *proc->vm;
   VMemory&  vmemory = vm.vmemory;
   Convert convert(vm);
   
@@ -220,4 +362,174 @@ void Controller::recv_process_warp(std::string pid, picojson::object& json) {
   
   // Turn on vm.
   vm.status = VMachine::ACTIVE;
+  set_ready(proc);
+}
+
+// Check the status of VM is executable.
+bool Controller::is_runnable(VMachine::Status status) {
+  return (status == VMachine::ACTIVE ||
+	  status == VMachine::WAIT_WARP ||
+	  status == VMachine::BEFOR_WARP ||
+	  status == VMachine::AFTER_WARP);
+}
+
+// Execute process for a time slice on worker.
+bool Controller::execute_process(Process& proc) {
+  std::lock_guard<std::mutex> lock(proc.mutex);
+  if (proc.is_deleted) return false;
+
+  try {
+    // Execute llvm cycle.
+    execute_quantum(proc);
+    // Blocked process is parked by loop() not to spin on worker.
+    return is_runnable(proc.vm->status) && !proc.vm->is_blocked();
+
+  } catch (Error e) {
+    proc.error_message = "";
+
+  } catch (const std::exception& e) {
+    proc.error_message = e.what();
+
+  } catch (...) {
+    proc.error_message = "unknown exception";
+  }
+
+  proc.is_error = true;
+  proc.vm->status = VMachine::FINISH;
+  return false;
+}
+
+// Execute process for a quantum, and adapt the quantum to the measured time.
+void Controller::execute_quantum(Process& proc) {
+  if (latency_target == 0) {
+    proc.vm->execute(proc.quantum);
+    return;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  int clock = proc.vm->execute(proc.quantum);
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>
+    (std::chrono::steady_clock::now() - start).count();
+  // Process waiting or finished at the beginning doesn't tell the cost.
+  if (clock <= 0) return;
+
+  // Smooth the cost to ignore temporary delay like page fault.
+  double cost = static_cast<double>(elapsed) / clock;
+  proc.clock_cost = (proc.clock_cost == 0 ? cost : (proc.clock_cost * 3 + cost) / 4);
+
+  // Divide latency target by runnable processes sharing a core.
+  unsigned int cores = (workers.empty() ? 1 : workers.size());
+  unsigned int share = (runnable_num + cores - 1) / cores;
+  unsigned int slice = (share <= 1 ? latency_target : latency_target / share);
+  if (slice < MIN_SLICE_USEC) slice = MIN_SLICE_USEC;
+
+  double quantum = slice * 1000.0 / proc.clock_cost;
+  if (quantum < MIN_QUANTUM) {
+    proc.quantum = MIN_QUANTUM;
+  } else if (quantum > MAX_QUANTUM) {
+    proc.quantum = MAX_QUANTUM;
+  } else {
+    proc.quantum = static_cast<int>(quantum);
+  }
+}
+
+// Main loop of worker thread.
+void Controller::run_worker(unsigned int idx) {
+  Worker& worker = *workers.at(idx);
+
+  while (!is_stopping) {
+    std::shared_ptr<Process> proc = take_process(idx);
+
+    if (!proc) {
+      // Wait until a process is queued.
+      std::unique_lock<std::mutex> lock(idle_mutex);
+      idle_num ++;
+      idle_cond.wait(lock, [this] { return queued_num != 0 || is_stopping; });
+      idle_num --;
+
+    } else if (execute_process(*proc)) {
+      // Put back to own run queue, wake up idle worker only if there is another process to steal.
+      bool is_surplus;
+      {
+	std::lock_guard<std::mutex> lock(worker.mutex);
+	worker.queue.push_back(proc);
+	is_surplus = worker.queue.size() > 1;
+      }
+      queued_num ++;
+      if (is_surplus && idle_num != 0) {
+	std::lock_guard<std::mutex> lock(idle_mutex);
+	idle_cond.notify_one();
+      }
+
+    } else {
+      // Pass to loop() for reporting to delegate.
+      {
+	std::lock_guard<std::mutex> lock(returned_mutex);
+	returned_procs.push_back(proc);
+	proc->is_scheduled = false;
+      }
+      scheduled_num --;
+      delegate.wake_loop();
+    }
+  }
+}
+
+// Pass process to a worker's run queue.
+void Controller::schedule_process(std::shared_ptr<Process> proc, unsigned int idx) {
+  Worker& worker = *workers.at(idx);
+  {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.queue.push_back(proc);
+  }
+  queued_num ++;
+  if (idle_num != 0) {
+    std::lock_guard<std::mutex> lock(idle_mutex);
+    idle_cond.notify_one();
+  }
+}
+
+// Add process to the ready queue to visit in next loop().
+void Controller::set_ready(std::shared_ptr<Process> proc) {
+  // Process in workers' run queue is returned by worker when it needs loop().
+  if (proc->is_ready || proc->is_scheduled) return;
+  proc->is_ready = true;
+  ready_queue.push_back(proc);
+}
+
+// Pass process woken by async call to loop().
+void Controller::wake_process(std::weak_ptr<Process> proc) {
+  std::shared_ptr<Process> locked = proc.lock();
+  if (!locked) return;
+
+  // Process still on worker is skipped by set_ready(), worker returns it if it is blocked.
+  {
+    std::lock_guard<std::mutex> lock(returned_mutex);
+    returned_procs.push_back(locked);
+  }
+  delegate.wake_loop();
+}
+
+// Take a process from the worker's run queue, or steal from other worker's run queue.
+std::shared_ptr<Controller::Process> Controller::take_process(unsigned int idx) {
+  std::shared_ptr<Process> proc;
+  if (queued_num == 0) return proc;
+
+  for (unsigned int i = 0; i < workers.size() && !proc; i ++) {
+    Worker& worker = *workers.at((idx + i) % workers.size());
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.queue.empty()) continue;
+
+    // Owner takes the oldest process, other worker steals the newest one.
+    if (i == 0) {
+      proc = worker.queue.front();
+      worker.queue.pop_front();
+
+    } else {
+      proc = worker.queue.back();
+      worker.queue.pop_back();
+    }
+  }
+
+  if (proc) queued_num --;
+  return proc;
 }
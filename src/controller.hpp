@@ -1,8 +1,13 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "lib/picojson.h"
@@ -34,6 +39,7 @@ namespace processwarp {
     
     /**
      * Call when context switch of process.
+     * Only called with empty pid when processes are executed by worker threads.
      * @param pid Target pid. Empty (length == 0) when switch to controller's process.
      */
     virtual void on_switch_proccess(const std::string& pid);
@@ -51,10 +57,20 @@ namespace processwarp {
      */
     virtual void on_error(const std::string& pid,
 			  const std::string& message);
+
+    /**
+     * Call when worker returned a process or async call woke a process, and loop() has something to do.
+     * Called on worker or host thread unlike other events, so it must be thread safe.
+     */
+    virtual void wake_loop();
   };
   
   /**
    * Controller for set of processes.
+   * Processes are executed in turn on the thread calling loop(),
+   * or on worker threads after start_workers was called.
+   * In both cases, events are reported to delegate on the thread calling loop().
+   * Process blocked by async calls (like sleep) is parked until the call completes.
    */
   class Controller {
   public:
@@ -67,11 +83,27 @@ namespace processwarp {
      */
     Controller(ControllerDelegate& delegate);
 
+    /**
+     * Destructor.
+     * Stop and join worker threads.
+     */
+    ~Controller();
+
     /**
      * Main loop.
+     * Visit processes in ready queue only.
+     * Execute processes when there is no worker, otherwise pass runnable processes to workers.
+     * Report warp, error and finish of processes to delegate.
      */
     void loop();
     
+    /**
+     * Check loop() has nothing to do.
+     * True when no process is executable by loop() and no event waits to be reported.
+     * @return True if idle.
+     */
+    bool is_idle();
+
     /**
      * Pass data from other device.
      * @param pid Target pid.
@@ -115,13 +147,106 @@ namespace processwarp {
     void warp_process(const std::string& pid,
 		      const std::string& dst_device_id);
 
+    /**
+     * Set latency target, the time until every runnable process is executed once.
+     * Each process gets a quantum adapted to the measured cost of its clocks,
+     * so that executing all runnable processes once fits in the target.
+     * @param usec Latency target (micro second). 0 to execute a fixed quantum.
+     */
+    void set_latency_target(unsigned int usec);
+
+    /**
+     * Start worker threads to execute processes on multiple cores.
+     * Each worker has a run queue, and steals processes from other workers when it is empty.
+     * @param num Number of workers.
+     * @param is_pinned Bind each worker to a cpu core if true (Linux only).
+     */
+    void start_workers(unsigned int num, bool is_pinned);
+
   private:
+    /**
+     * Process managed by controller.
+     */
+    struct Process {
+      /// Pid of process.
+      std::string pid;
+      /// VM of process.
+      std::unique_ptr<VMachine> vm;
+      /// Lock while executing or changing the state of VM.
+      /// VMemory has no lock of its own, so only the holder may touch it.
+      std::mutex mutex;
+      /// True while process is in ready queue.
+      bool is_ready;
+      /// True while process is in run queue or executed by worker.
+      std::atomic<bool> is_scheduled;
+      /// True if process was deleted while it was scheduled.
+      bool is_deleted;
+      /// True if error was raised in worker and not reported yet.
+      bool is_error;
+      /// Message of error raised in worker.
+      std::string error_message;
+      /// Number of clocks executed in a time slice.
+      int quantum;
+      /// Average time to execute a clock (nano second), 0 if not measured yet.
+      double clock_cost;
+
+      /**
+       * Constructor.
+       * @param pid_ Pid of process.
+       * @param vm_ VM of process.
+       */
+      Process(const std::string& pid_, VMachine* vm_);
+    };
+
+    /**
+     * Worker thread and its run queue.
+     */
+    struct Worker {
+      /// Worker thread.
+      std::thread thread;
+      /// Lock for queue.
+      std::mutex mutex;
+      /// Run queue, owner takes from front, other workers steal from back.
+      std::deque<std::shared_ptr<Process>> queue;
+    };
+
     /** Event assignee */
     ControllerDelegate& delegate;
-    /** Map of pid and VMachine. */
-    std::map<std::string, std::shared_ptr<VMachine>> procs;
+    /** Map of pid and process. */
+    std::map<std::string, std::shared_ptr<Process>> procs;
     /** Map of pid and warp destination device-ids. */
     std::map<std::string, std::string> warp_dest;
+    /**
+     * Processes to visit in next loop(), to execute or to report the status.
+     * Other processes are parked until the status is changed by controller or worker.
+     */
+    std::deque<std::shared_ptr<Process>> ready_queue;
+    /** Processes returned from workers or woken by async calls, moved to ready queue by loop(). */
+    std::vector<std::shared_ptr<Process>> returned_procs;
+    /** Lock for returned_procs. */
+    std::mutex returned_mutex;
+
+    /** Latency target (micro second), 0 if quantum is fixed. */
+    unsigned int latency_target;
+    /** Number of runnable processes counted by last loop(). */
+    std::atomic<unsigned int> runnable_num;
+
+    /** Workers, empty if processes are executed by loop(). */
+    std::vector<std::unique_ptr<Worker>> workers;
+    /** Index of worker to pass next process. */
+    unsigned int next_worker;
+    /** Number of processes passed to workers. */
+    std::atomic<unsigned int> scheduled_num;
+    /** Number of processes in run queues. */
+    std::atomic<unsigned int> queued_num;
+    /** Number of workers waiting for process. */
+    std::atomic<unsigned int> idle_num;
+    /** True when workers should stop. */
+    std::atomic<bool> is_stopping;
+    /** Lock for idle_cond. */
+    std::mutex idle_mutex;
+    /** Notified when process was queued or workers should stop. */
+    std::condition_variable idle_cond;
 
     /**
      * Dump and send data to warp process. 
@@ -130,5 +255,60 @@ namespace processwarp {
     void do_warp_process(std::string pid);
 
     void recv_process_warp(std::string pid, picojson::object& json);
+
+    /**
+     * Check the status of VM is executable.
+     * @param status Status of VM.
+     * @return True if VM is executable.
+     */
+    static bool is_runnable(VMachine::Status status);
+
+    /**
+     * Execute process for a time slice on worker.
+     * Errors are recorded to process and reported by loop() later.
+     * @param proc Target process.
+     * @return True if process is still executable.
+     */
+    bool execute_process(Process& proc);
+
+    /**
+     * Execute process for a quantum, and adapt the quantum to the measured time.
+     * @param proc Target process.
+     */
+    void execute_quantum(Process& proc);
+
+    /**
+     * Main loop of worker thread.
+     * @param idx Index of worker.
+     */
+    void run_worker(unsigned int idx);
+
+    /**
+     * Pass process to a worker's run queue.
+     * @param proc Target process.
+     * @param idx Index of worker.
+     */
+    void schedule_process(std::shared_ptr<Process> proc, unsigned int idx);
+
+    /**
+     * Add process to the ready queue to visit in next loop().
+     * Do nothing if process is already in ready queue or workers' run queue.
+     * @param proc Target process.
+     */
+    void set_ready(std::shared_ptr<Process> proc);
+
+    /**
+     * Pass process woken by async call to loop().
+     * Called on host thread completing the call.
+     * @param proc Target process, do nothing if it was already deleted.
+     */
+    void wake_process(std::weak_ptr<Process> proc);
+
+    /**
+     * Take a process from the worker's run queue, or steal from other worker's run queue.
+     * @param idx Index of worker.
+     * @return Process, or empty pointer if all run queues are empty.
+     */
+    std::shared_ptr<Process> take_process(unsigned int idx);
   };
 }
@@ -72,7 +72,9 @@ picojson::value Convert::export_thread(const Thread& src, Related& related) {
     dst_stackinfo.insert(std::make_pair("unwind_pc", num2json((**it).unwind_pc)));
     // スタック領域
     dst_stackinfo.insert(std::make_pair("stack", vaddr2json((**it).stack)));
-    related.insert((**it).stack);
+    related.insert(VMemory::get_addr_upper((**it).stack));
+    // 関数の終了時に戻すスタックポインタの位置
+    dst_stackinfo.insert(std::make_pair("stack_base", num2json((**it).stack_base)));
     // allocaで確保された領域
     picojson::array alloca_addrs;
     for (auto it_aa = (**it).alloca_addrs.begin(); it_aa != (**it).alloca_addrs.end(); it_aa ++) {
@@ -105,6 +107,18 @@ picojson::value Convert::export_thread(const Thread& src, Related& related) {
     dst_stackinfos.push_back(picojson::value(dst_stackinfo));
   }
   dst.insert(std::make_pair("stackinfos", picojson::value(dst_stackinfos)));
+
+  // スタックセグメントはdumpに含めず、使用中の範囲だけをスレッドと一緒に転送する
+  dst.insert(std::make_pair("stack_segment", vaddr2json(src.stack_segment)));
+  dst.insert(std::make_pair("stack_pointer", num2json(src.stack_pointer)));
+  picojson::array dst_stack_data;
+  if (src.stack_segment != VADDR_NON) {
+    dst_stack_data.resize(src.stack_pointer);
+    for (size_t i = 0; i < src.stack_pointer; i ++) {
+      dst_stack_data.at(i) = num2json<uint8_t>(src.stack_segment_cache->head[i]);
+    }
+  }
+  dst.insert(std::make_pair("stack_data", picojson::value(dst_stack_data)));
   
   // funcs_at_befor_warp
   picojson::array dst_fabw;
@@ -158,6 +172,8 @@ void Convert::import_thread(const picojson::value& src) {
 		     json2num<unsigned int>(obj_si.at("normal_pc")),
 		     json2num<unsigned int>(obj_si.at("unwind_pc")),
 		     json2vaddr(obj_si.at("stack"))));
+    // 関数の終了時に戻すスタックポインタの位置
+    stackinfo->stack_base = json2num<size_t>(obj_si.at("stack_base"));
     // allocaで確保された領域
     const picojson::array& alloca_addrs = obj_si.at("alloca_addrs").get<picojson::array>();
     stackinfo->alloca_addrs.resize(alloca_addrs.size());
@@ -184,6 +200,18 @@ void Convert::import_thread(const picojson::value& src) {
     thread->stackinfos.push_back(std::move(stackinfo));
   }
 
+  // スタックセグメント
+  thread->stack_segment = json2vaddr(obj_src.at("stack_segment"));
+  thread->stack_pointer = json2num<size_t>(obj_src.at("stack_pointer"));
+  if (thread->stack_segment != VADDR_NON) {
+    const picojson::array& stack_data = obj_src.at("stack_data").get<picojson::array>();
+    DataStore& segment = vmemory.alloc_data(STACK_SEGMENT_SIZE, false, thread->stack_segment);
+    for (size_t i = 0, size = stack_data.size(); i < size; i ++) {
+      segment.head[i] = json2num<uint8_t>(stack_data.at(i));
+    }
+    thread->stack_segment_cache = &segment;
+  }
+
   // funcs_at_befor_warp
   const picojson::array& fabw = obj_src.at("funcs_at_befor_warp").get<picojson::array>();
   for (auto it : fabw) {
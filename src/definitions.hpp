@@ -62,15 +62,44 @@ namespace processwarp {
   /** スタックの作業用バッファサイズ */
   static const int STACK_BUFFER_SIZE = 2;
 
+  /** スレッドごとのスタックセグメントのサイズ */
+  static const size_t STACK_SEGMENT_SIZE = 0x100000;
+  /** スタックセグメント上に確保する領域のアライメント */
+  static const size_t STACK_SEGMENT_ALIGNMENT = 16;
+
   /** オペランドの最大値 */
   static const instruction_t FILL_OPERAND = 0x03FFFFFF;
   static const instruction_t HEAD_OPERAND = 0x02000000;
 
+  /** プロセスを1回に実行するクロック数の初期値、実行時間の目標がない場合はこの値に固定する */
+  static const int DEFAULT_QUANTUM = 100;
+  /** 実行時間から調整する、プロセスを1回に実行するクロック数の最小値 */
+  static const int MIN_QUANTUM = 100;
+  /** 実行時間から調整する、プロセスを1回に実行するクロック数の最大値 */
+  static const int MAX_QUANTUM = 1000000;
+  /** プロセスを1回に実行する時間の目標の最小値(マイクロ秒) */
+  static const unsigned int MIN_SLICE_USEC = 200;
+
+  /** 組み込み関数が開始した非同期処理を実行するホストのスレッド数 */
+  static const unsigned int ASYNC_THREAD_NUM = 4;
+
+  /** 関数を検証して検査を省略した実行に切り替える、呼び出しと後方への分岐の回数 */
+  static const unsigned int TIER_UP_THRESHOLD = 32;
+
+  /** 検証済みの関数の内容を記録しておく最大の数 */
+  static const size_t VERIFIED_CACHE_MAX = 4096;
+
+  /** SWITCH_TABLE命令の分岐表の最大の要素数 */
+  static const uint64_t SWITCH_TABLE_MAX = 0x10000;
+
   /** VM内のint相当のint型 */
   typedef __pw_vm_int_t vm_int_t;
   /** VM内のint相当のint型 */
   typedef __pw_vm_uint_t vm_uint_t;
 
+  /** 最初のスレッド(main関数を実行するスレッド)のスレッドID */
+  static const vm_uint_t MAIN_THREAD_ID = 1;
+
   /** メモリの内容ごとに割り当てるアドレスの判定フラグ */
   enum AddrType : vaddr_t {
     AD_TYPE     = 0x0000000000000000, ///< 型 or スタックの相対アドレス
@@ -193,5 +222,20 @@ namespace processwarp {
       SELECT,
       SHUFFLE,
       VA_ARG,
+      BINARY_OP,
+      TEST_OP, // 50
+      CAST_OP,
+      LOAD_OP,
+      STORE_OP,
+      PHI_MOVE,
+      SWITCH_TABLE,
+      SWITCH_SEARCH,
+      GET_ELEMENT_PTR,
+      // 実行時に書き換えた命令、命令列のエクスポートには現れない
+      QUICK_CALL,
+      QUICK_SET_TYPE,
+      QUICK_CALL_INDIRECT,
+      QUICK_TAILCALL,
+      QUICK_TAILCALL_INDIRECT,
   };
 }
@@ -22,7 +22,9 @@ FuncStore::FuncStore(vaddr_t addr_,
   normal_prop(normal_prop_),
   builtin(nullptr),
   builtin_param(DUMMY_BUILTIN_PARAM),
-  external(nullptr)
+  external(nullptr),
+  verify_status(VS_UNKNOWN),
+  hotness(0)
 {
 }
 
@@ -43,7 +45,9 @@ FuncStore::FuncStore(vaddr_t addr_,
   normal_prop(DUMMY_PROP),
   builtin(builtin_),
   builtin_param(builtin_param_),
-  external(nullptr)
+  external(nullptr),
+  verify_status(VS_UNKNOWN),
+  hotness(0)
 {
 }
 
@@ -62,6 +66,8 @@ FuncStore::FuncStore(vaddr_t addr_,
   normal_prop(DUMMY_PROP),
   builtin(nullptr),
   builtin_param(DUMMY_BUILTIN_PARAM),
-  external(nullptr)
+  external(nullptr),
+  verify_status(VS_UNKNOWN),
+  hotness(0)
 {
 }
@@ -6,11 +6,35 @@
 #include "symbols.hpp"
 
 namespace processwarp {
+  class TypeStore;
+
   /**
    * 関数クラス。
    */
   class FuncStore {
   public:
+    /// 命令列の検証状態
+    enum VerifyStatus {
+      VS_UNKNOWN,  ///< 未検証
+      VS_VERIFIED, ///< 検証済み(実行時の命令ごとの検査を省略する)
+      VS_REJECTED, ///< 検証失敗(実行時に命令ごとに検査しながら実行する)
+    };
+
+    /// 関数ポインタ経由の呼び出し1箇所でキャッシュする呼び出し先の数
+    static const unsigned int CALL_CACHE_SIZE = 4;
+
+    /// 関数ポインタ経由の呼び出し位置ごとのインラインキャッシュ
+    struct CallCache {
+      /// 呼び出し先のアドレスを格納したスタック上の位置
+      instruction_t operand;
+      /// キャッシュしている呼び出し先の数
+      unsigned int count;
+      /// 呼び出し先のアドレス(最近使ったものが先頭)
+      vaddr_t addrs[CALL_CACHE_SIZE];
+      /// 解決済みの呼び出し先
+      FuncStore* funcs[CALL_CACHE_SIZE];
+    };
+
     /// 通常の関数で利用するメンバ
     struct NormalProp {
       /// 関数で利用するスタックサイズ
@@ -47,6 +71,26 @@ namespace processwarp {
     /// ライブラリなど外部の関数のポインタ
     external_func_t external;
 
+    /// 命令列の検証状態
+    VerifyStatus verify_status;
+    /// 未検証の間の呼び出しと後方への分岐の回数
+    /// TIER_UP_THRESHOLDに達した時点で検証し、命令ごとの検査を省略した実行に切り替える
+    unsigned int hotness;
+
+    /// threaded dispatch用に命令列から変換した命令ごとのハンドラのアドレス
+    std::vector<const void*> threaded_code;
+
+    /// 実行用の命令列
+    /// 初回実行時に解決したCALL、SET_TYPEを解決済みの関数、型を参照する命令に書き換える
+    /// warpで転送するのは書き換えていないnormal_prop.codeの方
+    std::vector<instruction_t> quick_code;
+    /// QUICK_CALL、QUICK_TAILCALLのオペランドが示す解決済みの関数
+    std::vector<FuncStore*> quick_funcs;
+    /// QUICK_SET_TYPEのオペランドが示す解決済みの型
+    std::vector<TypeStore*> quick_types;
+    /// QUICK_CALL_INDIRECT、QUICK_TAILCALL_INDIRECTのオペランドが示すインラインキャッシュ
+    std::vector<CallCache> quick_call_caches;
+
     /**
      * 通常の関数のコンストラクタ。
      * @param addr_ 割り当てアドレス
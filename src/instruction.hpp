@@ -39,6 +39,36 @@ namespace processwarp {
       }
     }
     
+    /**
+     * 融合命令のオペランドから演算の種類を抜き出す。
+     * @param code 命令
+     * @return 演算の種類
+     */
+    static inline instruction_t get_fused_sub(instruction_t code) {
+      return (code     ) & 0x3F;
+    }
+
+    /**
+     * 融合命令のオペランドから演算対象の基本型を抜き出す。
+     * @param code 命令
+     * @return 基本型、型を特定しない場合0
+     */
+    static inline instruction_t get_fused_type(instruction_t code) {
+      return (code >> 6) & 0x3F;
+    }
+
+    /**
+     * 融合命令のオペランドを作成する。
+     * 下位6bitに演算の種類、その上の6bitに演算対象の基本型を格納する。
+     * @param type 演算対象の基本型、型を特定しない場合0
+     * @param sub 演算の種類
+     * @return オペランド
+     */
+    static inline int make_fused_operand(vaddr_t type, instruction_t sub) {
+      assert(type < 0x40 && sub < 0x40);
+      return static_cast<int>((type << 6) | sub);
+    }
+
     /**
      * 命令を作成する。
      * @param opcode オペコード
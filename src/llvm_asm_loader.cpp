@@ -1,4 +1,5 @@
 
+#include <algorithm>
 #include <iostream>
 #include <llvm/AsmParser/Parser.h>
 #include <llvm/Support/ManagedStatic.h>
@@ -60,6 +61,45 @@ void LlvmAsmLoader::load_file(const std::string& filename) {
 #endif
 }
 
+// 分岐命令に指定する分岐先のラベルを取得する。
+unsigned int LlvmAsmLoader::assign_branch_label(FunctionContext& fc,
+						const llvm::BasicBlock* src,
+						const llvm::BasicBlock* dst) {
+  // PHIのないブロックへはそのまま分岐する
+  if (!llvm::isa<llvm::PHINode>(dst->front())) {
+    return fc.block_alias.at(dst);
+  }
+
+  // 同じ分岐元、分岐先の組は1つのPHI_MOVE命令を共有する
+  auto edge = std::make_pair(src, dst);
+  auto it = fc.phi_edges.find(edge);
+  if (it != fc.phi_edges.end()) {
+    return it->second;
+  }
+  unsigned int label = fc.block_alias.size() + fc.phi_edges.size();
+  fc.phi_edges.insert(std::make_pair(edge, label));
+  return label;
+}
+
+// PHI_MOVE命令で値を退避する一時領域を確保する。
+int LlvmAsmLoader::assign_phi_scratch(FunctionContext& fc, int size) {
+  // 退避した値はPHI_MOVE命令の中で使い終わるため、関数内の全ての分岐で1つの領域を共有し、
+  // 最も大きい分岐に合わせて広げる
+  if (size > fc.phi_scratch_size) {
+    // 一時領域の後ろに変数が割り当てられている場合、広げられないので確保しなおす
+    if (fc.phi_scratch_size == 0 ||
+	fc.phi_scratch + fc.phi_scratch_size != fc.stack_sum) {
+      if ((fc.stack_sum % sizeof(vaddr_t)) != 0) {
+	fc.stack_sum = (fc.stack_sum / sizeof(vaddr_t) + 1) * sizeof(vaddr_t);
+      }
+      fc.phi_scratch = fc.stack_sum;
+    }
+    fc.phi_scratch_size = size;
+    fc.stack_sum = fc.phi_scratch + size;
+  }
+  return fc.phi_scratch;
+}
+
 // ロード済みの値とアドレスの対応関係を登録する。
 void LlvmAsmLoader::assign_loaded(FunctionContext& fc, const llvm::Value* v) {
   // グローバル変数として確保されているか確認
@@ -151,6 +191,25 @@ int LlvmAsmLoader::assign_operand(FunctionContext& fc, const llvm::Value* v) {
   return 0;
 }
 
+// 読み書きするアドレスを、基点のポインタと定数の変位に分解する。
+const llvm::Value* LlvmAsmLoader::get_displacement(const llvm::Value* pointer, int* disp) {
+  *disp = 0;
+  if (!llvm::GetElementPtrInst::classof(pointer)) return pointer;
+
+  const llvm::GetElementPtrInst& inst = *static_cast<const llvm::GetElementPtrInst*>(pointer);
+  int64_t offset;
+  std::vector<std::pair<const llvm::Value*, int64_t>> indices;
+  split_gep_indices(inst, &offset, &indices);
+  // 変数の添字を含む場合や、変位がオペランドで表現できない場合は分解しない
+  if (!indices.empty() ||
+      offset < -static_cast<int64_t>(HEAD_OPERAND) ||
+      offset >= static_cast<int64_t>(HEAD_OPERAND)) {
+    return pointer;
+  }
+  *disp = static_cast<int>(offset);
+  return inst.getPointerOperand();
+}
+
 // LLVMの定数をロードした実アドレスを取得する。
 LlvmAsmLoader::ValueDest LlvmAsmLoader::get_loaded_ptr(FunctionContext& fc,
 						       const llvm::Constant* src) {
@@ -179,6 +238,94 @@ uint8_t* LlvmAsmLoader::get_ptr_by_dest(FunctionContext& fc, ValueDest dst) {
   }
 }
 
+// getelementptrの結果が、型を特定した読み書きの変位としてのみ使われるかどうかを判定する。
+bool LlvmAsmLoader::is_folded_gep(const llvm::GetElementPtrInst& inst) {
+  int disp;
+  if (inst.use_empty() || get_displacement(&inst, &disp) == &inst) return false;
+
+  for (auto it = inst.user_begin(); it != inst.user_end(); it ++) {
+    const llvm::User* user = *it;
+    if (llvm::LoadInst::classof(user)) {
+      const llvm::LoadInst* load = static_cast<const llvm::LoadInst*>(user);
+      if (!is_typed_basic(load_type(load->getType(), false), true)) return false;
+
+    } else if (llvm::StoreInst::classof(user)) {
+      const llvm::StoreInst* store = static_cast<const llvm::StoreInst*>(user);
+      // アドレス自体を書き込む場合は計算が必要
+      if (store->getPointerOperand() != &inst ||
+	  store->getValueOperand() == &inst ||
+	  !is_typed_basic(load_type(store->getValueOperand()->getType(), false), true)) {
+	return false;
+      }
+
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+// 命令配列の末尾が指定した格納先に結果を書き込む比較の融合命令かどうかを判定する。
+bool LlvmAsmLoader::is_fused_compare(FunctionContext& fc, int output) {
+  // binary_op <opcode> <ty> <result> <op1> <op2>
+  if (fc.code.size() < 5) return false;
+  instruction_t head = fc.code.at(fc.code.size() - 5);
+  if (Instruction::get_opcode(head) != Opcode::BINARY_OP) return false;
+
+  switch (Instruction::get_fused_sub(head)) {
+  case Opcode::EQUAL:
+  case Opcode::NOT_EQUAL:
+  case Opcode::GREATER:
+  case Opcode::GREATER_EQUAL:
+  case Opcode::NOT_NANS:
+    return fc.code.at(fc.code.size() - 3) ==
+      Instruction::make_instruction(Opcode::EXTRA, output);
+
+  default:
+    return false;
+  }
+}
+
+// call命令を呼び出し元のStackInfoを置き換える末尾呼び出しにできるかどうかを判定する。
+bool LlvmAsmLoader::is_tail_call(const llvm::CallInst& inst) {
+  // tailの指定は呼び出し先が呼び出し元のallocaと可変長引数を参照しないことを示す
+  if (!inst.isTailCall()) return false;
+  // byvalの引数は呼び出し元の領域を指したまま渡すため置き換えられない
+  // 属性の位置は0が戻り値、1以降が引数
+  for (unsigned int arg_idx = 0, num = inst.getNumArgOperands(); arg_idx < num; arg_idx ++) {
+    if (inst.paramHasAttr(arg_idx + 1, llvm::Attribute::ByVal)) return false;
+  }
+
+  // 直後のretが呼び出しの結果を返すか、戻り値を持たない場合のみ置き換えられる
+  const llvm::Instruction* next = inst.getNextNode();
+  if (next == nullptr || !llvm::ReturnInst::classof(next)) return false;
+  const llvm::Value* ret_value = static_cast<const llvm::ReturnInst*>(next)->getReturnValue();
+  return ret_value == nullptr || ret_value == &inst;
+}
+
+// 型を特定した命令で扱う基本型かどうかを判定する。
+bool LlvmAsmLoader::is_typed_basic(vaddr_t type, bool pointer) {
+  switch (type) {
+  case BasicType::TY_UI8:
+  case BasicType::TY_UI16:
+  case BasicType::TY_UI32:
+  case BasicType::TY_UI64:
+  case BasicType::TY_SI8:
+  case BasicType::TY_SI16:
+  case BasicType::TY_SI32:
+  case BasicType::TY_SI64:
+  case BasicType::TY_F32:
+  case BasicType::TY_F64:
+    return true;
+
+  case BasicType::TY_POINTER:
+    return pointer;
+
+  default:
+    return false;
+  }
+}
+
 // LLVMの定数(配列)を仮想マシンにロードする。
 void LlvmAsmLoader::load_array(FunctionContext& fc, ValueDest dst, const llvm::ConstantArray* src) {
   // Typeの要素数とOperandsの要素数は同じはず
@@ -299,8 +446,9 @@ void LlvmAsmLoader::load_expr(FunctionContext& fc, ValueDest dst, const llvm::Co
       vaddr_t dst_type = load_type(src->getType(), DSI);		\
       vaddr_t src_type = load_type(src->getOperand(0)->getType(), SSI); \
       TypeBased* src_op = vm.get_type_based(src_type);			\
+      ValueDest src_dst = get_loaded_ptr(fc, src);			\
       src_op->type_cast(get_ptr_by_dest(fc, dst), dst_type,		\
-			get_ptr_by_dest(fc, get_loaded_ptr(fc, src)));	\
+			get_ptr_by_dest(fc, src_dst));			\
     } break;
 
     M_LOAD_EXPR_CONV(Trunc, false, false);
@@ -320,8 +468,10 @@ void LlvmAsmLoader::load_expr(FunctionContext& fc, ValueDest dst, const llvm::Co
     // 変換先を0埋め
     memset(get_ptr_by_dest(fc, dst), 0, data_layout->getTypeAllocSize(src->getType()));
     // 変換元の定数を読み込む
-    assert(assign_operand(fc, src->getOperand(0)) < 0);
-    uint8_t* src_ptr = fc.k.data() - assign_operand(fc, src->getOperand(0)) - 1;
+    // 定数の割り当てでkが再確保されうるため、アドレスは割り当て後に取得する
+    int src_idx = assign_operand(fc, src->getOperand(0));
+    assert(src_idx < 0);
+    uint8_t* src_ptr = fc.k.data() - src_idx - 1;
     size_t size = data_layout->getTypeAllocSize(src->getOperand(0)->getType());
     if (size > data_layout->getTypeAllocSize(src->getType())) {
       size = data_layout->getTypeAllocSize(src->getType());
@@ -389,9 +539,10 @@ void LlvmAsmLoader::load_expr(FunctionContext& fc, ValueDest dst, const llvm::Co
       case llvm::PRE: {							\
 	vaddr_t op_type = load_type(src->getOperand(0)->getType(), SI); \
 	TypeBased* op = vm.get_type_based(op_type);			\
+	ValueDest fop = get_loaded_ptr(fc, src->getOperand(FOP));	\
+	ValueDest sop = get_loaded_ptr(fc, src->getOperand(SOP));	\
 	op->OP(get_ptr_by_dest(fc, dst),				\
-	       get_ptr_by_dest(fc, get_loaded_ptr(fc, src->getOperand(FOP))), \
-	       get_ptr_by_dest(fc, get_loaded_ptr(fc, src->getOperand(SOP)))); \
+	       get_ptr_by_dest(fc, fop), get_ptr_by_dest(fc, sop));	\
       } break;
 
     case llvm::FCmpInst::FCMP_FALSE: {
@@ -496,10 +647,15 @@ void LlvmAsmLoader::load_function(const llvm::Function* function) {
     std::map<const llvm::BasicBlock*, unsigned int> block_alias;
     // ブロック名とそれの開始位置
     std::map<unsigned int, unsigned int> block_start;
+    // PHIを持つブロックのブロック名とPHI以外の命令の開始位置
+    std::map<unsigned int, unsigned int> block_body;
 
     FunctionContext fc = {prop.code, k, stack_values, 0,
                           std::map<const llvm::Value*, int>(),
-                          std::map<std::pair<const llvm::Type*, bool>, int>()};
+                          std::map<std::pair<const llvm::Type*, bool>, int>(),
+			  block_alias,
+			  std::map<std::pair<const llvm::BasicBlock*, const llvm::BasicBlock*>,
+				   unsigned int>(), 0, 0};
     
     // 引数を変数の先頭に登録
     for (auto arg = function->getArgumentList().begin();
@@ -536,10 +692,11 @@ void LlvmAsmLoader::load_function(const llvm::Function* function) {
 	    push_code(fc, Opcode::RETURN, FILL_OPERAND);
 
 	  } else {
-	    // set_type <type>
-	    push_code(fc, Opcode::SET_TYPE, assign_type(fc, inst.getReturnValue()->getType()));
 	    // return <value>
 	    push_code(fc, Opcode::RETURN, assign_operand(fc, inst.getReturnValue()));
+	    // extra <size>
+	    push_code(fc, Opcode::EXTRA,
+		      vm.vmemory.get_type(load_type(inst.getReturnValue()->getType(), false)).size);
 	  }
 	} break;
 
@@ -547,21 +704,18 @@ void LlvmAsmLoader::load_function(const llvm::Function* function) {
 	  const llvm::CallInst& inst = static_cast<const llvm::CallInst&>(*i);
 	  // インラインアセンブラ未対応
 	  if (inst.isInlineAsm()) throw_error(Error::UNSUPPORT);
-	  if (!inst.getType()->isVoidTy()) {
-	    // 戻り値の型
-	    push_code(fc, Opcode::SET_TYPE,
-		      assign_type(fc, inst.getType()));
-	    // 出力先
-	    push_code(fc, Opcode::SET_OUTPUT,
-		      assign_operand(fc, &inst));
-	  }
 
 	  // CALL命令、関数
-	  push_code(fc, Opcode::CALL,
+	  // 末尾呼び出しの場合も戻り値の格納先は指定し、呼び出し先が組み込み関数などの場合に
+	  // 続くRETURNで結果を返せるようにしておく
+	  push_code(fc, is_tail_call(inst) ? Opcode::TAILCALL : Opcode::CALL,
 		    assign_operand(fc, inst.getCalledValue()));
-	  // 戻り値の型、格納先の命令を追加
+	  // 正常時、異常時の戻り先(次の命令)を追加
 	  push_code(fc, Opcode::EXTRA, FILL_OPERAND);
 	  push_code(fc, Opcode::EXTRA, FILL_OPERAND);
+	  // 戻り値の格納先を追加
+	  push_code(fc, Opcode::EXTRA,
+		    inst.getType()->isVoidTy() ? FILL_OPERAND : assign_operand(fc, &inst));
 
 	  // 引数部分の命令(引数の型、引数〜)を追加
 	  for (unsigned int arg_idx = 0, num = inst.getNumArgOperands();
@@ -577,32 +731,32 @@ void LlvmAsmLoader::load_function(const llvm::Function* function) {
 	  const llvm::BranchInst& inst = static_cast<const llvm::BranchInst&>(*i);
 	  if (inst.isUnconditional()) {
 	    // 無条件分岐の場合、無条件jump先の命令を追加
-	    push_code(fc, Opcode::JUMP, block_alias.at(inst.getSuccessor(0)));
+	    push_code(fc, Opcode::JUMP, assign_branch_label(fc, &*block, inst.getSuccessor(0)));
+
+	  } else if (i != block->begin() &&
+		     inst.getCondition() == &*std::prev(i) &&
+		     is_fused_compare(fc, assign_operand(fc, inst.getCondition()))) {
+	    // 直前の比較命令の結果で分岐する場合、比較命令と分岐を融合する
+	    instruction_t& head = fc.code.at(fc.code.size() - 5);
+	    head = Instruction::make_instruction(Opcode::TEST_OP, Instruction::get_operand(head));
+	    // cond == true の場合のジャンプ先
+	    push_code(fc, Opcode::EXTRA, assign_branch_label(fc, &*block, inst.getSuccessor(0)));
+	    // cond != true の場合のジャンプ先
+	    push_code(fc, Opcode::EXTRA, assign_branch_label(fc, &*block, inst.getSuccessor(1)));
 
 	  } else {
 	    // 条件分岐
 	    push_code(fc, Opcode::TEST, assign_operand(fc, inst.getCondition()));
 	    // cond == true の場合のジャンプ先
-	    push_code(fc, Opcode::EXTRA, block_alias.at(inst.getSuccessor(0)));
+	    push_code(fc, Opcode::EXTRA, assign_branch_label(fc, &*block, inst.getSuccessor(0)));
 	    // cond != true の場合のジャンプ先
-	    push_code(fc, Opcode::JUMP, block_alias.at(inst.getSuccessor(1)));
+	    push_code(fc, Opcode::JUMP, assign_branch_label(fc, &*block, inst.getSuccessor(1)));
 	  }
 	} break;
 
 	case llvm::Instruction::Switch: {
 	  const llvm::SwitchInst& inst = static_cast<const llvm::SwitchInst&>(*i);
-	  // set_type <intty>
-	  push_code(fc, Opcode::SET_TYPE, assign_type(fc, inst.getCondition()->getType()));
-	  // set_value <value>
-	  push_code(fc, Opcode::SET_VALUE, assign_operand(fc, inst.getCondition()));
-	  for (auto it = inst.case_begin(); it != inst.case_end(); it ++) {
-	    // test_eq <val>
-	    push_code(fc, Opcode::TEST_EQ, assign_operand(fc, it.getCaseValue()));
-	    // extra <dest>
-	    push_code(fc, Opcode::EXTRA, block_alias.at(it.getCaseSuccessor()));
-	  }
-	  // jump <defaultdest>
-	  push_code(fc, Opcode::JUMP, block_alias.at(inst.getDefaultDest()));
+	  push_switch_code(fc, &*block, inst);
 	} break;
 
 	case llvm::Instruction::IndirectBr: {
@@ -613,18 +767,16 @@ void LlvmAsmLoader::load_function(const llvm::Function* function) {
 
 	case llvm::Instruction::Invoke: {
 	  const llvm::InvokeInst& inst = static_cast<const llvm::InvokeInst&>(*i);
-	  if (!inst.getType()->isVoidTy()) {
-	    // 戻り値の型
-	    push_code(fc, Opcode::SET_TYPE, assign_type(fc, inst.getType()));
-	    // 出力先
-	    push_code(fc, Opcode::SET_OUTPUT, assign_operand(fc, &inst));
-	  }
 
 	  // CALL命令、関数
 	  push_code(fc, Opcode::CALL, assign_operand(fc, inst.getCalledValue()));
 	  // 正常時、異常時のジャンプ先を追加
-	  push_code(fc, Opcode::EXTRA, block_alias.at(inst.getNormalDest()));
-	  push_code(fc, Opcode::EXTRA, block_alias.at(inst.getUnwindDest()));
+	  // RETURN命令はphi0を更新しないため、PHIを持つ分岐先へはPHI_MOVE命令を経由して進む
+	  push_code(fc, Opcode::EXTRA, assign_branch_label(fc, &*block, inst.getNormalDest()));
+	  push_code(fc, Opcode::EXTRA, assign_branch_label(fc, &*block, inst.getUnwindDest()));
+	  // 戻り値の格納先を追加
+	  push_code(fc, Opcode::EXTRA,
+		    inst.getType()->isVoidTy() ? FILL_OPERAND : assign_operand(fc, &inst));
 
 	  // 引数部分の命令(引数の型、引数〜)を追加
 	  for (unsigned int arg_idx = 0, num = inst.getNumArgOperands();
@@ -659,6 +811,8 @@ void LlvmAsmLoader::load_function(const llvm::Function* function) {
 	    push_code(fc, Opcode::EXTRA,
 		      block_alias.at(inst.getIncomingBlock(i)));
 	  }
+	  // 分岐命令からはPHI_MOVE命令で値をコピーして、PHIの後の命令に直接進む
+	  block_body[block_alias.at(block)] = fc.code.size();
 	} break;
 
 	  /**
@@ -670,18 +824,11 @@ void LlvmAsmLoader::load_function(const llvm::Function* function) {
 	  const llvm::BinaryOperator& inst =			\
 	    static_cast<const llvm::BinaryOperator&>(*i);	\
 	  assert(inst.getNumOperands() == 2);			\
-	  /* set_type <ty> */					\
-	  push_code(fc, Opcode::SET_TYPE,			\
-		    assign_type(fc, inst.getType(), sign));	\
-	  /* set_output <result> */				\
-	  push_code(fc, Opcode::SET_OUTPUT,			\
-		    assign_operand(fc, &inst));			\
-	  /* set_value <op1> */					\
-	  push_code(fc, Opcode::SET_VALUE,			\
-		    assign_operand(fc, inst.getOperand(0)));	\
-	  /* opcode <op2> */					\
-	  push_code(fc, (opcode),				\
-		    assign_operand(fc, inst.getOperand(1)))
+	  /* binary_op <opcode> <ty> <result> <op1> <op2> */	\
+	  push_binary_code(fc, (opcode), inst.getType(), (sign), \
+			   assign_operand(fc, &inst),		\
+			   assign_operand(fc, inst.getOperand(0)), \
+			   assign_operand(fc, inst.getOperand(1)))
 
 	case llvm::Instruction::Add:
 	case llvm::Instruction::FAdd: {
@@ -903,9 +1050,20 @@ void LlvmAsmLoader::load_function(const llvm::Function* function) {
 	  
 	case llvm::Instruction::Load: {
 	  const llvm::LoadInst& inst = static_cast<const llvm::LoadInst&>(*i);
+	  vaddr_t type = load_type(inst.getType(), false);
+	  if (is_typed_basic(type, true)) {
+	    int disp;
+	    const llvm::Value* pointer = get_displacement(inst.getPointerOperand(), &disp);
+	    // load_op <ty> <result> <pointer> <disp>
+	    push_code(fc, Opcode::LOAD_OP, type);
+	    push_code(fc, Opcode::EXTRA, assign_operand(fc, &inst));
+	    push_code(fc, Opcode::EXTRA, assign_operand(fc, pointer));
+	    push_code(fc, Opcode::EXTRA, disp);
+	    break;
+	  }
 	  // set_type <ty>
 	  push_code(fc, Opcode::SET_TYPE,
-		    assign_type(fc, inst.getPointerOperand()->getType()));
+		    assign_type(fc, inst.getType()));
 	  // set_align <alignment>
 	  push_code(fc, Opcode::SET_ALIGN,
 		    inst.getAlignment());
@@ -919,6 +1077,17 @@ void LlvmAsmLoader::load_function(const llvm::Function* function) {
 
 	case llvm::Instruction::Store: {
 	  const llvm::StoreInst& inst = static_cast<const llvm::StoreInst&>(*i);
+	  vaddr_t type = load_type(inst.getValueOperand()->getType(), false);
+	  if (is_typed_basic(type, true)) {
+	    int disp;
+	    const llvm::Value* pointer = get_displacement(inst.getPointerOperand(), &disp);
+	    // store_op <ty> <pointer> <value> <disp>
+	    push_code(fc, Opcode::STORE_OP, type);
+	    push_code(fc, Opcode::EXTRA, assign_operand(fc, pointer));
+	    push_code(fc, Opcode::EXTRA, assign_operand(fc, inst.getValueOperand()));
+	    push_code(fc, Opcode::EXTRA, disp);
+	    break;
+	  }
 	  // set_type <ty>
 	  push_code(fc, Opcode::SET_TYPE,
 		    assign_type(fc, inst.getValueOperand()->getType()));
@@ -986,58 +1155,28 @@ void LlvmAsmLoader::load_function(const llvm::Function* function) {
 
 	case llvm::Instruction::GetElementPtr: {
 	  const llvm::GetElementPtrInst& inst = static_cast<const llvm::GetElementPtrInst&>(*i);
-	  // set_ptr <ptrval>
-	  push_code(fc, Opcode::SET_PTR,
-		    assign_operand(fc, inst.getPointerOperand()));
-
-	  llvm::Type* op_type = inst.getPointerOperandType()->getPointerElementType();
-	  for (unsigned int i = 1, num = inst.getNumOperands(); i < num; i ++) {
-	    if (i == 1) {
-	      // set_type <ty>
-	      push_code(fc, Opcode::SET_TYPE, assign_type(fc, inst.getOperand(i)->getType()));
-	      // set_value <idx>
-	      push_code(fc, Opcode::SET_VALUE, assign_operand(fc, inst.getOperand(i)));
-	      // mul_adr <>
-	      assert(data_layout->getTypeAllocSize(op_type) != 0);
-	      assert(data_layout->getTypeStoreSize(op_type) ==
-		     data_layout->getTypeAllocSize(op_type));
-	      push_code(fc, Opcode::MUL_ADR, data_layout->getTypeAllocSize(op_type));
-	      
-	    } else if (llvm::SequentialType::classof(op_type)) {
-	      op_type = static_cast<const llvm::SequentialType*>(op_type)->getElementType();
-	      // set_type <ty>
-	      push_code(fc, Opcode::SET_TYPE, assign_type(fc, inst.getOperand(i)->getType()));
-	      // set_value <idx>
-	      push_code(fc, Opcode::SET_VALUE, assign_operand(fc, inst.getOperand(i)));
-	      // mul_adr <>
-	      assert(data_layout->getTypeAllocSize(op_type) != 0);
-	      assert(data_layout->getTypeStoreSize(op_type) ==
-		     data_layout->getTypeAllocSize(op_type));
-	      push_code(fc, Opcode::MUL_ADR, data_layout->getTypeAllocSize(op_type));
-
-	    } else if (llvm::StructType::classof(op_type)) {
-	      unsigned int j = 0;
-	      int size_sum = 0;
-	      // int系のはず
-	      assert(llvm::ConstantInt::classof(inst.getOperand(i)));
-	      for (j = 0;
-		   j < static_cast<const llvm::ConstantInt*>(inst.getOperand(i))->getZExtValue();
-		   j ++) {
-		llvm::Type* in_type =
-		  static_cast<const llvm::StructType*>(op_type)->getElementType(j);
-		size_sum += data_layout->getTypeStoreSize(in_type);
-	      }
-	      // add_adr <>
-	      op_type = static_cast<const llvm::StructType*>(op_type)->getElementType(j);
-	      push_code(fc, Opcode::ADD_ADR, size_sum);
-
-	    } else {
-	      assert(false);
-	    }
+	  // 読み書きの変位として使われるだけのアドレスは計算しない
+	  if (is_folded_gep(inst)) break;
+	  llvm::Type* i64_type = llvm::Type::getInt64Ty(inst.getContext());
+	  int64_t offset;
+	  std::vector<std::pair<const llvm::Value*, int64_t>> indices;
+	  split_gep_indices(inst, &offset, &indices);
+
+	  // get_element_ptr <n>
+	  // extra <result>, extra <ptrval>, extra <offset>
+	  // extra <idx0>, extra <bits0>, extra <size0>…
+	  push_code(fc, Opcode::GET_ELEMENT_PTR, indices.size());
+	  push_code(fc, Opcode::EXTRA, assign_operand(fc, &inst));
+	  push_code(fc, Opcode::EXTRA, assign_operand(fc, inst.getPointerOperand()));
+	  push_code(fc, Opcode::EXTRA,
+		    assign_operand(fc, llvm::ConstantInt::get(i64_type, offset, true)));
+	  for (auto& it : indices) {
+	    push_code(fc, Opcode::EXTRA, assign_operand(fc, it.first));
+	    push_code(fc, Opcode::EXTRA,
+		      llvm::cast<llvm::IntegerType>(it.first->getType())->getBitWidth());
+	    push_code(fc, Opcode::EXTRA,
+		      assign_operand(fc, llvm::ConstantInt::get(i64_type, it.second, true)));
 	  }
-	  // get_adr <result>
-	  push_code(fc, Opcode::GET_ADR,
-		    assign_operand(fc, &inst));
 	} break;
 
 	case llvm::Instruction::Trunc:
@@ -1050,29 +1189,15 @@ void LlvmAsmLoader::load_function(const llvm::Function* function) {
 	case llvm::Instruction::IntToPtr: {
 	  const llvm::CastInst& inst = static_cast<const llvm::CastInst&>(*i);
 	  assert(inst.getNumOperands() == 1);
-	  // set_type <ty>
-	  push_code(fc, Opcode::SET_TYPE, assign_type(fc, inst.getSrcTy()));
-	  // set_output <result>
-	  push_code(fc, Opcode::SET_OUTPUT, assign_operand(fc, &inst));
-	  // set_value <value>
-	  push_code(fc, Opcode::SET_VALUE, assign_operand(fc, inst.getOperand(0)));
-	  // typecast <ty2>
-	  push_code(fc, Opcode::TYPE_CAST, assign_type(fc, inst.getDestTy()));
+	  push_cast_code(fc, inst, false);
 	} break;
 
 	case llvm::Instruction::SExt:
 	case llvm::Instruction::FPToSI:
 	case llvm::Instruction::SIToFP: {
-	  const llvm::SExtInst& inst = static_cast<const llvm::SExtInst&>(*i);
+	  const llvm::CastInst& inst = static_cast<const llvm::CastInst&>(*i);
 	  assert(inst.getNumOperands() == 1);
-	  // set_type <ty>
-	  push_code(fc, Opcode::SET_TYPE, assign_type(fc, inst.getSrcTy(), true));
-	  // set_output <result>
-	  push_code(fc, Opcode::SET_OUTPUT, assign_operand(fc, &inst));
-	  // set_value <value>
-	  push_code(fc, Opcode::SET_VALUE, assign_operand(fc, inst.getOperand(0)));
-	  // typecast <ty2>
-	  push_code(fc, Opcode::TYPE_CAST, assign_type(fc, inst.getDestTy(), true));
+	  push_cast_code(fc, inst, true);
 	} break;
 
 	case llvm::Instruction::BitCast: {
@@ -1091,12 +1216,8 @@ void LlvmAsmLoader::load_function(const llvm::Function* function) {
 	case llvm::Instruction::ICmp: {
 	  const llvm::ICmpInst& inst = static_cast<const llvm::ICmpInst&>(*i);
 	  assert(inst.isIntPredicate());
-	  // set_type <ty>
-	  push_code(fc, Opcode::SET_TYPE,
-		    assign_type(fc, inst.getOperand(0)->getType(), inst.isSigned()));
-	  // set_output <result>
-	  push_code(fc, Opcode::SET_OUTPUT,
-		    assign_operand(fc, &inst));
+	  const llvm::Type* type = inst.getOperand(0)->getType();
+	  int output = assign_operand(fc, &inst);
 
 	  switch(inst.getPredicate()){
 	    /**
@@ -1108,8 +1229,9 @@ void LlvmAsmLoader::load_function(const llvm::Function* function) {
 	     */
 #define M_ICMP_OPERATOR(PRE, OPC, FOP, SOP)				\
 	    case llvm::CmpInst::Predicate::PRE: {			\
-	      push_code(fc, Opcode::SET_VALUE, assign_operand(fc, inst.getOperand(FOP))); \
-	      push_code(fc, Opcode::OPC, assign_operand(fc, inst.getOperand(SOP))); \
+	      push_binary_code(fc, Opcode::OPC, type, inst.isSigned(), output, \
+			       assign_operand(fc, inst.getOperand(FOP)), \
+			       assign_operand(fc, inst.getOperand(SOP))); \
 	    } break;
 
 	    M_ICMP_OPERATOR(ICMP_EQ, EQUAL, 0, 1); // =
@@ -1133,10 +1255,8 @@ void LlvmAsmLoader::load_function(const llvm::Function* function) {
 	case llvm::Instruction::FCmp: {
 	  const llvm::FCmpInst& inst = static_cast<const llvm::FCmpInst&>(*i);
 	  assert(inst.isFPPredicate());
-	  // set_type <ty>
-	  push_code(fc, Opcode::SET_TYPE, assign_type(fc, inst.getOperand(0)->getType()));
-	  // set_output <result>
-	  push_code(fc, Opcode::SET_OUTPUT, assign_operand(fc, &inst));
+	  int type   = assign_type(fc, inst.getOperand(0)->getType());
+	  int output = assign_operand(fc, &inst);
 
 	  switch(inst.getPredicate()){
 	    /**
@@ -1148,8 +1268,9 @@ void LlvmAsmLoader::load_function(const llvm::Function* function) {
 	     */
 #define M_FCMP_OPERATOR1(PRE, OPC, FOP, SOP)				\
 	    case llvm::CmpInst::PRE: {					\
-	      push_code(fc, Opcode::SET_VALUE, assign_operand(fc, inst.getOperand(FOP))); \
-	      push_code(fc, Opcode::OPC, assign_operand(fc, inst.getOperand(SOP))); \
+	      push_binary_code(fc, Opcode::OPC, inst.getOperand(0)->getType(), false, output, \
+			       assign_operand(fc, inst.getOperand(FOP)), \
+			       assign_operand(fc, inst.getOperand(SOP))); \
 	    } break;
 
 	    M_FCMP_OPERATOR1(FCMP_OEQ, EQUAL, 0, 1); // =
@@ -1163,6 +1284,8 @@ void LlvmAsmLoader::load_function(const llvm::Function* function) {
 
 #define M_FCMP_OPERATOR2(PRE, OPC, FOP, SOP)				\
 	    case llvm::CmpInst::PRE: {					\
+	    push_code(fc, Opcode::SET_TYPE, type);			\
+	    push_code(fc, Opcode::SET_OUTPUT, output);			\
 	    push_code(fc, Opcode::SET_VALUE, assign_operand(fc, inst.getOperand(FOP))); \
 	    push_code(fc, Opcode::OR_NANS, assign_operand(fc, inst.getOperand(SOP))); \
 	    push_code(fc, Opcode::OPC, assign_operand(fc, inst.getOperand(SOP))); \
@@ -1177,6 +1300,8 @@ void LlvmAsmLoader::load_function(const llvm::Function* function) {
 #undef M_FCMP_OPERATOR2
 
 	  case llvm::CmpInst::FCMP_UNO: { // isnan(v) || isnan(A)
+	    push_code(fc, Opcode::SET_TYPE, type);
+	    push_code(fc, Opcode::SET_OUTPUT, output);
 	    push_code(fc, Opcode::SET_VALUE, assign_operand(fc, inst.getOperand(0)));
 	    push_code(fc, Opcode::OR_NANS, assign_operand(fc, inst.getOperand(1))); \
 	    // OR_NANSを使い比較不能かどうか調べ、pc+1分、NOPを埋めることで都合をつける。
@@ -1230,6 +1355,20 @@ void LlvmAsmLoader::load_function(const llvm::Function* function) {
       }
     }
 
+    // PHIを持つブロックへの分岐ごとに、値をコピーしてから分岐先に進むPHI_MOVE命令を作成する
+    // PHI_MOVE命令のラベルはブロックのラベルの後に割り当ててある
+    std::vector<std::pair<const llvm::BasicBlock*, const llvm::BasicBlock*>>
+      phi_edges(fc.phi_edges.size());
+    for (auto& it : fc.phi_edges) {
+      phi_edges.at(it.second - block_alias.size()) = it.first;
+    }
+    for (unsigned int i = 0; i < phi_edges.size(); i ++) {
+      unsigned int dst_alias = block_alias.at(phi_edges.at(i).second);
+      block_start.insert(std::make_pair(block_alias.size() + i, fc.code.size()));
+      push_phi_move_code(fc, phi_edges.at(i).first, phi_edges.at(i).second,
+			 block_start.at(dst_alias), block_body.at(dst_alias));
+    }
+
     // TEST/JUMP命令のジャンプ先をラベルから開始位置に書き換える
     for (unsigned int pc = 0, size = fc.code.size(); pc < size; pc ++) {
       instruction_t code = fc.code.at(pc);
@@ -1245,7 +1384,8 @@ void LlvmAsmLoader::load_function(const llvm::Function* function) {
 	  }								\
 	}
 
-      case Opcode::CALL: {
+      case Opcode::CALL:
+      case Opcode::TAILCALL: {
 	M_REPLACE_LABEL(pc + 1);
 	M_REPLACE_LABEL(pc + 2);
 	pc += 2;
@@ -1256,6 +1396,20 @@ void LlvmAsmLoader::load_function(const llvm::Function* function) {
 	pc += 1;
       } break;
 
+      case Opcode::BINARY_OP: {
+	pc += 4;
+      } break;
+
+      case Opcode::GET_ELEMENT_PTR: {
+	pc += Instruction::get_operand(code) * 3 + 3;
+      } break;
+
+      case Opcode::TEST_OP: {
+	M_REPLACE_LABEL(pc + 5);
+	M_REPLACE_LABEL(pc + 6);
+	pc += 6;
+      } break;
+
       case Opcode::TEST_EQ: {
 	M_REPLACE_LABEL(pc + 1);
 	pc += 1;
@@ -1265,6 +1419,20 @@ void LlvmAsmLoader::load_function(const llvm::Function* function) {
 	M_REPLACE_LABEL(pc);
       } break;
 
+      case Opcode::SWITCH_TABLE:
+      case Opcode::SWITCH_SEARCH: {
+	unsigned int count = Instruction::get_operand(fc.code.at(pc + 3));
+	for (unsigned int i = 4; i <= count + 4; i ++) {
+	  M_REPLACE_LABEL(pc + i);
+	}
+	pc += count + 4;
+      } break;
+
+      case Opcode::PHI_MOVE: {
+	// 分岐先は作成時に開始位置を設定済み
+	pc += Instruction::get_operand(code) * 3 + 2;
+      } break;
+
       case Opcode::PHI: {
 	if (Instruction::get_opcode(fc.code.at(pc + 1)) == Opcode::EXTRA) {
 	  M_REPLACE_LABEL(pc + 1);
@@ -1346,9 +1514,13 @@ void LlvmAsmLoader::load_globals(const llvm::Module::GlobalListType& variables)
   FuncStore::NormalProp prop;
   std::vector<uint8_t> k;
   std::map<const llvm::Value*, int> stack_values;
+  std::map<const llvm::BasicBlock*, unsigned int> block_alias;
   FunctionContext fc = {prop.code, k, stack_values, 0,
                         std::map<const llvm::Value*, int>(),
-                        std::map<std::pair<const llvm::Type*, bool>, int>()};
+                        std::map<std::pair<const llvm::Type*, bool>, int>(),
+			block_alias,
+			std::map<std::pair<const llvm::BasicBlock*, const llvm::BasicBlock*>,
+				 unsigned int>(), 0, 0};
   // 初期値がある場合は値をロードする
   for (auto it = map_global.begin(); it != map_global.end(); it ++) {
     const llvm::GlobalVariable* gl =
@@ -1674,11 +1846,194 @@ void LlvmAsmLoader::load_zero(FunctionContext& fc, ValueDest dst, const llvm::Co
   memset(get_ptr_by_dest(fc, dst), 0, size);
 }
 
+// 現在解析中の関数の命令配列にキャスト命令を追記する。
+void LlvmAsmLoader::push_cast_code(FunctionContext& fc, const llvm::CastInst& inst, bool sign) {
+  vaddr_t src = load_type(inst.getSrcTy(), sign);
+  vaddr_t dst = load_type(inst.getDestTy(), sign);
+  if (is_typed_basic(src, false) && is_typed_basic(dst, false)) {
+    // cast_op <src ty, dst ty> <result> <value>
+    push_code(fc, Opcode::CAST_OP, Instruction::make_fused_operand(src, dst));
+    push_code(fc, Opcode::EXTRA, assign_operand(fc, &inst));
+    push_code(fc, Opcode::EXTRA, assign_operand(fc, inst.getOperand(0)));
+
+  } else {
+    // set_type <ty>
+    push_code(fc, Opcode::SET_TYPE, assign_type(fc, inst.getSrcTy(), sign));
+    // set_output <result>
+    push_code(fc, Opcode::SET_OUTPUT, assign_operand(fc, &inst));
+    // set_value <value>
+    push_code(fc, Opcode::SET_VALUE, assign_operand(fc, inst.getOperand(0)));
+    // typecast <ty2>
+    push_code(fc, Opcode::TYPE_CAST, assign_type(fc, inst.getDestTy(), sign));
+  }
+}
+
+// 現在解析中の関数の命令配列に2項演算子の融合命令を追記する。
+void LlvmAsmLoader::push_binary_code(FunctionContext& fc, Opcode opcode,
+				     const llvm::Type* type, bool sign,
+				     int output, int value, int operand) {
+  // 基本型の場合は型を特定した命令にする
+  vaddr_t basic = load_type(type, sign);
+  push_code(fc, Opcode::BINARY_OP,
+	    Instruction::make_fused_operand(is_typed_basic(basic, true) ? basic : 0, opcode));
+  push_code(fc, Opcode::EXTRA, assign_type(fc, type, sign));
+  push_code(fc, Opcode::EXTRA, output);
+  push_code(fc, Opcode::EXTRA, value);
+  push_code(fc, Opcode::EXTRA, operand);
+}
+
 // 現在解析中の関数の命令配列に命令を追記する。
 void LlvmAsmLoader::push_code(FunctionContext& fc, Opcode opcode, int operand) {
   fc.code.push_back(Instruction::make_instruction(opcode, operand));
 }
 
+// 分岐元から分岐先のブロックへ進む際にPHIの値をコピーするPHI_MOVE命令を追記する。
+void LlvmAsmLoader::push_phi_move_code(FunctionContext& fc,
+				       const llvm::BasicBlock* src,
+				       const llvm::BasicBlock* dst,
+				       unsigned int block_start,
+				       unsigned int body_start) {
+  // コピー先、コピー元、サイズの組
+  struct Move {
+    int dst;
+    int src;
+    int size;
+  };
+  std::vector<Move> moves;
+  for (auto i = dst->begin(); llvm::isa<llvm::PHINode>(*i); i ++) {
+    const llvm::PHINode& phi = static_cast<const llvm::PHINode&>(*i);
+    Move move;
+    move.dst  = assign_operand(fc, &phi);
+    move.src  = assign_operand(fc, phi.getIncomingValueForBlock(src));
+    move.size = vm.vmemory.get_type(load_type(phi.getType(), false)).size;
+    if (move.dst != move.src) moves.push_back(move);
+  }
+
+  // 他のPHIのコピー先になっている値は、上書きされる前に一時領域に退避しておく
+  // 一時領域内の位置を先に決め、退避が必要な場合だけ一時領域を確保する
+  std::vector<Move> saves;
+  std::vector<Move*> saved_moves;
+  int scratch_size = 0;
+  for (auto& move : moves) {
+    for (auto& other : moves) {
+      if (&move == &other || move.src != other.dst) continue;
+      if ((scratch_size % sizeof(vaddr_t)) != 0) {
+	scratch_size = (scratch_size / sizeof(vaddr_t) + 1) * sizeof(vaddr_t);
+      }
+      Move save = {scratch_size, move.src, move.size};
+      saves.push_back(save);
+      saved_moves.push_back(&move);
+      scratch_size += move.size;
+      break;
+    }
+  }
+  if (!saves.empty()) {
+    int scratch = assign_phi_scratch(fc, scratch_size);
+    for (unsigned int i = 0; i < saves.size(); i ++) {
+      saves.at(i).dst += scratch;
+      saved_moves.at(i)->src = saves.at(i).dst;
+    }
+  }
+  moves.insert(moves.begin(), saves.begin(), saves.end());
+
+  // phi_move <n>
+  // extra <dst0>, extra <src0>, extra <size0>…
+  // extra <block start>, extra <body start>
+  push_code(fc, Opcode::PHI_MOVE, moves.size());
+  for (auto& move : moves) {
+    push_code(fc, Opcode::EXTRA, move.dst);
+    push_code(fc, Opcode::EXTRA, move.src);
+    push_code(fc, Opcode::EXTRA, move.size);
+  }
+  push_code(fc, Opcode::EXTRA, block_start);
+  push_code(fc, Opcode::EXTRA, body_start);
+}
+
+// 現在解析中の関数の命令配列にswitch命令に対応する分岐命令を追記する。
+void LlvmAsmLoader::push_switch_code(FunctionContext& fc,
+				     const llvm::BasicBlock* block,
+				     const llvm::SwitchInst& inst) {
+  unsigned int bits =
+    llvm::cast<llvm::IntegerType>(inst.getCondition()->getType())->getBitWidth();
+
+  if (bits > 64) {
+    // 64bitを超える整数は表にできないため、1つずつ比較する
+    // set_type <intty>
+    push_code(fc, Opcode::SET_TYPE, assign_type(fc, inst.getCondition()->getType()));
+    // set_value <value>
+    push_code(fc, Opcode::SET_VALUE, assign_operand(fc, inst.getCondition()));
+    for (auto it = inst.case_begin(); it != inst.case_end(); it ++) {
+      // test_eq <val>
+      push_code(fc, Opcode::TEST_EQ, assign_operand(fc, it.getCaseValue()));
+      // extra <dest>
+      push_code(fc, Opcode::EXTRA, assign_branch_label(fc, block, it.getCaseSuccessor()));
+    }
+    // jump <defaultdest>
+    push_code(fc, Opcode::JUMP, assign_branch_label(fc, block, inst.getDefaultDest()));
+    return;
+  }
+
+  // 符号拡張した値と分岐先のラベルの組を値の順に並べる
+  std::vector<std::pair<int64_t, unsigned int>> cases;
+  for (auto it = inst.case_begin(); it != inst.case_end(); it ++) {
+    cases.push_back(std::make_pair(it.getCaseValue()->getSExtValue(),
+				   assign_branch_label(fc, block, it.getCaseSuccessor())));
+  }
+  std::sort(cases.begin(), cases.end());
+  unsigned int default_label = assign_branch_label(fc, block, inst.getDefaultDest());
+
+  // 値の範囲に対して分岐先が十分に密な場合は分岐表、そうでなければ二分探索とする
+  // 分岐表の大きさは分岐先の数の2倍まで、かつSWITCH_TABLE_MAX以下に抑える
+  uint64_t range = cases.empty() ? 0 :
+    static_cast<uint64_t>(cases.back().first) - static_cast<uint64_t>(cases.front().first) + 1;
+  bool is_table = (!cases.empty() && range != 0 &&
+		   range <= cases.size() * 2 && range <= SWITCH_TABLE_MAX);
+
+  // 表引きに使う値(分岐表の場合は最小値、二分探索の場合は全ての値)を定数領域に格納する
+  std::vector<int64_t> keys;
+  if (is_table) {
+    keys.push_back(cases.front().first);
+  } else {
+    for (auto& it : cases) keys.push_back(it.first);
+  }
+  int k = fc.k.size();
+  if ((k % sizeof(int64_t)) != 0) {
+    k = (k / sizeof(int64_t) + 1) * sizeof(int64_t);
+  }
+  fc.k.resize(k + sizeof(int64_t) * std::max<size_t>(keys.size(), 1));
+  if (!keys.empty()) {
+    memcpy(&fc.k.at(k), keys.data(), sizeof(int64_t) * keys.size());
+  }
+
+  // switch_table <value>, extra <bits>, extra <min>, extra <n>, extra <default>
+  // extra <dest0>, extra <dest1>…(値がmin + 0, min + 1…の場合の分岐先)
+  // switch_search <value>, extra <bits>, extra <keys>, extra <n>, extra <default>
+  // extra <dest0>, extra <dest1>…(値がkeys[0], keys[1]…の場合の分岐先)
+  push_code(fc, is_table ? Opcode::SWITCH_TABLE : Opcode::SWITCH_SEARCH,
+	    assign_operand(fc, inst.getCondition()));
+  push_code(fc, Opcode::EXTRA, bits);
+  push_code(fc, Opcode::EXTRA, -k - 1);
+  if (is_table) {
+    push_code(fc, Opcode::EXTRA, range);
+    push_code(fc, Opcode::EXTRA, default_label);
+    auto it = cases.begin();
+    for (uint64_t idx = 0; idx < range; idx ++) {
+      if (it != cases.end() &&
+	  static_cast<uint64_t>(it->first) - static_cast<uint64_t>(cases.front().first) == idx) {
+	push_code(fc, Opcode::EXTRA, it->second);
+	it ++;
+      } else {
+	push_code(fc, Opcode::EXTRA, default_label);
+      }
+    }
+
+  } else {
+    push_code(fc, Opcode::EXTRA, cases.size());
+    push_code(fc, Opcode::EXTRA, default_label);
+    for (auto& it : cases) push_code(fc, Opcode::EXTRA, it.second);
+  }
+}
+
 // 現在あるValueDestを元に、相対位置を変化させたValueDestを作成する。
 LlvmAsmLoader::ValueDest LlvmAsmLoader::relocate_dest(ValueDest dst, int diff) {
   if (dst.is_k) {
@@ -1688,3 +2043,44 @@ LlvmAsmLoader::ValueDest LlvmAsmLoader::relocate_dest(ValueDest dst, int diff) {
   }
   return dst;
 }
+
+// getelementptrの添字を、定数のオフセットと変数の添字と要素のサイズの組に分ける。
+void LlvmAsmLoader::split_gep_indices(const llvm::GetElementPtrInst& inst, int64_t* offset,
+				      std::vector<std::pair<const llvm::Value*, int64_t>>* indices) {
+  // 定数の添字、構造体のメンバの位置は1つのオフセットにまとめ、
+  // 変数の添字は添字と要素のサイズの組として残す
+  *offset = 0;
+  indices->clear();
+  llvm::Type* op_type = inst.getPointerOperandType()->getPointerElementType();
+  for (unsigned int i = 1, num = inst.getNumOperands(); i < num; i ++) {
+    const llvm::Value* index = inst.getOperand(i);
+    if (i == 1 || llvm::SequentialType::classof(op_type)) {
+      if (i != 1) {
+	op_type = static_cast<const llvm::SequentialType*>(op_type)->getElementType();
+      }
+      assert(data_layout->getTypeAllocSize(op_type) != 0);
+      assert(data_layout->getTypeStoreSize(op_type) ==
+	     data_layout->getTypeAllocSize(op_type));
+      int64_t stride = data_layout->getTypeAllocSize(op_type);
+      if (llvm::ConstantInt::classof(index)) {
+	*offset += static_cast<const llvm::ConstantInt*>(index)->getSExtValue() * stride;
+      } else {
+	indices->push_back(std::make_pair(index, stride));
+      }
+
+    } else if (llvm::StructType::classof(op_type)) {
+      unsigned int j = 0;
+      // int系のはず
+      assert(llvm::ConstantInt::classof(index));
+      for (j = 0; j < static_cast<const llvm::ConstantInt*>(index)->getZExtValue(); j ++) {
+	llvm::Type* in_type =
+	  static_cast<const llvm::StructType*>(op_type)->getElementType(j);
+	*offset += data_layout->getTypeStoreSize(in_type);
+      }
+      op_type = static_cast<const llvm::StructType*>(op_type)->getElementType(j);
+
+    } else {
+      assert(false);
+    }
+  }
+}
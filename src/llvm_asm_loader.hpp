@@ -69,6 +69,16 @@ namespace processwarp {
       /// ローカル変数とアドレスの対応関係
       std::map<const llvm::Value*, int> loaded_value;
       std::map<std::pair<const llvm::Type*, bool>, int> loaded_type;
+
+      /// ブロックとそれに割り当てるラベル
+      std::map<const llvm::BasicBlock*, unsigned int>& block_alias;
+      /// PHIを持つブロックへの分岐(分岐元, 分岐先)とPHI_MOVE命令に割り当てるラベル
+      std::map<std::pair<const llvm::BasicBlock*, const llvm::BasicBlock*>,
+	       unsigned int> phi_edges;
+      /// PHI_MOVE命令で値を退避する一時領域の位置
+      int phi_scratch;
+      /// PHI_MOVE命令で値を退避する一時領域のサイズ(未確保の場合0)
+      int phi_scratch_size;
     };
 
     /// 値の格納先(拡張可能な定数領域k or 固定の定数領域
@@ -112,6 +122,28 @@ namespace processwarp {
     /// 解析中のモジュールのデータレイアウト
     const llvm::DataLayout* data_layout;
 
+    /**
+     * 分岐命令に指定する分岐先のラベルを取得する。
+     * 分岐先のブロックにPHIがある場合は、分岐元からの値をコピーしてから
+     * 分岐先に進むPHI_MOVE命令のラベルを割り当てる。
+     * @param fc 解析中の関数の命令/変数
+     * @param src 分岐元のブロック
+     * @param dst 分岐先のブロック
+     * @return 分岐先のラベル
+     */
+    unsigned int assign_branch_label(FunctionContext& fc,
+				     const llvm::BasicBlock* src,
+				     const llvm::BasicBlock* dst);
+
+    /**
+     * PHI_MOVE命令で値を退避する一時領域を確保する。
+     * 一時領域は関数内の全てのPHI_MOVE命令で共有する。
+     * @param fc 解析中の関数の命令/変数
+     * @param size 必要なサイズ
+     * @return 一時領域の位置
+     */
+    int assign_phi_scratch(FunctionContext& fc, int size);
+
     /**
      * ロード済みの値とアドレスの対応関係を登録する。
      * @param fc 解析中の関数の命令/変数
@@ -136,6 +168,15 @@ namespace processwarp {
      */
     int assign_operand(FunctionContext& fc, const llvm::Value* v);
 
+    /**
+     * 読み書きするアドレスを、基点のポインタと定数の変位に分解する。
+     * 全ての添字が定数のgetelementptrの結果であれば、その基点とオフセットに分解する。
+     * @param pointer 読み書きするアドレス
+     * @param disp 変位の格納先、分解しない場合は0
+     * @return 基点のポインタ、分解しない場合はpointer
+     */
+    const llvm::Value* get_displacement(const llvm::Value* pointer, int* disp);
+
     /**
      * LLVMの定数をロードした実アドレスを取得する。
      * @param fc 解析中の関数の命令/変数
@@ -154,6 +195,38 @@ namespace processwarp {
      */
     uint8_t* get_ptr_by_dest(FunctionContext& fc, ValueDest dst);
 
+    /**
+     * getelementptrの結果が、型を特定した読み書きの変位としてのみ使われるかどうかを判定する。
+     * この場合、読み書きの命令が基点と変位を直接使うため、アドレスの計算を省略できる。
+     * @param inst 判定対象のgetelementptr命令
+     * @return アドレスの計算を省略できる場合true
+     */
+    bool is_folded_gep(const llvm::GetElementPtrInst& inst);
+
+    /**
+     * 命令配列の末尾が指定した格納先に結果を書き込む比較の融合命令かどうかを判定する。
+     * @param fc 解析中の関数の命令/変数
+     * @param output 比較結果の格納先
+     * @return 末尾が比較の融合命令の場合true
+     */
+    bool is_fused_compare(FunctionContext& fc, int output);
+
+    /**
+     * call命令を呼び出し元のStackInfoを置き換える末尾呼び出しにできるかどうかを判定する。
+     * LLVMでtailが指定され、直後のretで結果をそのまま返す場合が対象となる。
+     * @param inst 判定対象のcall命令
+     * @return 末尾呼び出しにできる場合true
+     */
+    bool is_tail_call(const llvm::CallInst& inst);
+
+    /**
+     * 型を特定した命令で扱う基本型かどうかを判定する。
+     * @param type 判定対象の型
+     * @param pointer ポインタ型を含める場合true
+     * @return 型を特定した命令で扱う基本型の場合true
+     */
+    bool is_typed_basic(vaddr_t type, bool pointer);
+
     /**
      * LLVMの定数(配列)を仮想マシンにロードする。
      * @param src LLVMの定数(配列)
@@ -252,6 +325,31 @@ namespace processwarp {
      */
     void load_zero(FunctionContext& fc, ValueDest dst, const llvm::ConstantAggregateZero* src);
 
+    /**
+     * 現在解析中の関数の命令配列に2項演算子の融合命令を追記する。
+     * 型、出力先、左辺値、右辺値はEXTRAとして融合命令に続けて追記する。
+     * 演算の型が基本型の場合、型を特定した融合命令にする。
+     * @param fc 解析中の関数の命令/変数
+     * @param opcode 演算のオペコード
+     * @param type 演算の型
+     * @param sign 符号考慮の場合true
+     * @param output 演算結果の格納先
+     * @param value 左辺値
+     * @param operand 右辺値
+     */
+    void push_binary_code(FunctionContext& fc, Opcode opcode,
+			  const llvm::Type* type, bool sign,
+			  int output, int value, int operand);
+
+    /**
+     * 現在解析中の関数の命令配列にキャスト命令を追記する。
+     * 変換元、変換先が共に基本型の場合、型を特定したキャスト命令にする。
+     * @param fc 解析中の関数の命令/変数
+     * @param inst LLVMのキャスト命令
+     * @param sign 符号考慮の場合true
+     */
+    void push_cast_code(FunctionContext& fc, const llvm::CastInst& inst, bool sign);
+
     /**
      * 現在解析中の関数の命令配列に命令を追記する。
      * @param fc 解析中の関数の命令/変数
@@ -260,6 +358,33 @@ namespace processwarp {
      */
     void push_code(FunctionContext& fc, Opcode opcode, int operand);
 
+    /**
+     * 分岐元から分岐先のブロックへ進む際にPHIの値をコピーするPHI_MOVE命令を追記する。
+     * 並列にコピーした場合と同じ結果になるよう、上書きされる値は一時領域に退避してからコピーする。
+     * @param fc 解析中の関数の命令/変数
+     * @param src 分岐元のブロック
+     * @param dst 分岐先のブロック
+     * @param block_start 分岐先のブロックの開始位置
+     * @param body_start 分岐先のブロックのPHI以外の命令の開始位置
+     */
+    void push_phi_move_code(FunctionContext& fc,
+			    const llvm::BasicBlock* src,
+			    const llvm::BasicBlock* dst,
+			    unsigned int block_start,
+			    unsigned int body_start);
+
+    /**
+     * 現在解析中の関数の命令配列にswitch命令に対応する分岐命令を追記する。
+     * 分岐先の値が密な場合は分岐表、疎な場合は二分探索で分岐先を決めるSWITCH命令にする。
+     * 値の表は定数領域に、分岐先はEXTRAとしてSWITCH命令に続けて追記する。
+     * @param fc 解析中の関数の命令/変数
+     * @param block 分岐元のブロック
+     * @param inst LLVMのswitch命令
+     */
+    void push_switch_code(FunctionContext& fc,
+			  const llvm::BasicBlock* block,
+			  const llvm::SwitchInst& inst);
+
     /**
      * 現在あるValueDestを元に、相対位置を変化させたValueDestを作成する。
      * @param dst 現在あるValueDest
@@ -267,5 +392,14 @@ namespace processwarp {
      * @return dstをdiff分だけずらしたValueDest
      */
     ValueDest relocate_dest(ValueDest dst, int diff);
+
+    /**
+     * getelementptrの添字を、定数のオフセットと変数の添字と要素のサイズの組に分ける。
+     * @param inst getelementptr命令
+     * @param offset 定数の添字、構造体のメンバの位置を合計したオフセットの格納先
+     * @param indices 変数の添字と要素のサイズの組の格納先
+     */
+    void split_gep_indices(const llvm::GetElementPtrInst& inst, int64_t* offset,
+			   std::vector<std::pair<const llvm::Value*, int64_t>>* indices);
   };
 }
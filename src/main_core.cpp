@@ -17,6 +17,9 @@
 
 using namespace processwarp;
 
+/** Longest time to sleep in main loop when there is nothing to execute (milli second). */
+static const unsigned int IDLE_WAIT_MSEC = 1000;
+
 class NativeVm : public ControllerDelegate, public SocketIoDelegate {
 public:
   Controller controller;
@@ -151,6 +154,11 @@ public:
     on_finish_proccess(pid);
   }
 
+  // Call when worker returned a process.
+  void wake_loop() override {
+    socket.notify();
+  }
+
   // Call when system error on server.
   void recv_sys_error(int code) override {
     throw_error(Error::SERVER_SYS);
@@ -371,6 +379,20 @@ public:
       }
     }
     
+    // Adapt quantum of processes to latency target (milli second).
+    if (conf.find("latency-target") != conf.end()) {
+      controller.set_latency_target
+	(static_cast<unsigned int>(conf.at("latency-target").get<double>() * 1000));
+    }
+
+    // Start workers to execute processes on multiple cores.
+    if (conf.find("workers") != conf.end()) {
+      unsigned int worker_num = static_cast<unsigned int>(conf.at("workers").get<double>());
+      bool is_pinned = (conf.find("cpu-pinning") != conf.end() &&
+			conf.at("cpu-pinning").get<bool>());
+      controller.start_workers(worker_num, is_pinned);
+    }
+
     // Get device-name.
     device_name = conf.at("device-name").get<std::string>();
   
@@ -401,6 +423,10 @@ public:
 #endif
       socket.pool();
       controller.loop();
+      // Sleep until a message or an event of process when there is nothing to execute.
+      if (controller.is_idle()) {
+	socket.wait(IDLE_WAIT_MSEC);
+      }
     }
   }
 };
@@ -72,6 +72,8 @@ int main(int argc, char* argv[]) {
 	if (*it == VADDR_NULL || *it == VADDR_NON) continue;
 	// VM組み込みのアドレスはexportしない
 	if (vm.builtin_addrs.find(*it) != vm.builtin_addrs.end()) continue;
+	// スタックセグメントはスレッドと一緒にexportする
+	if (*it == vm.threads.back()->stack_segment) continue;
 	
 	dump.insert(std::make_pair(Util::vaddr2str(*it), convert.export_store(*it, related)));
       }
@@ -51,6 +51,7 @@ void SocketIo::connect(const std::string& url) {
 		 print_debug("recv : %s\n", _name);			\
 		 std::lock_guard<std::mutex> guard(sio_mutex);		\
 		 sio_queue.push(make_pair(_name, data));		\
+		 sio_cond.notify_all();					\
 	       });							\
   }
   
@@ -186,6 +187,21 @@ void SocketIo::pool() {
   }
 }
 
+// Wake up thread blocked in wait.
+void SocketIo::notify() {
+  std::lock_guard<std::mutex> guard(sio_mutex);
+  sio_notified = true;
+  sio_cond.notify_all();
+}
+
+// Block until a message is received, notify is called or timeout.
+void SocketIo::wait(unsigned int msec) {
+  std::unique_lock<std::mutex> lock(sio_mutex);
+  sio_cond.wait_for(lock, std::chrono::milliseconds(msec),
+		    [this] { return !sio_queue.empty() || sio_notified; });
+  sio_notified = false;
+}
+
 // Send load llvm command.
 void SocketIo::send_load_llvm(const std::string& name,
 			      const std::string& file,
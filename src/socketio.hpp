@@ -1,6 +1,7 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 #include <queue>
@@ -184,6 +185,18 @@ namespace processwarp {
      */
     void pool();
 
+    /**
+     * Wake up thread blocked in wait.
+     * Can be called from any thread.
+     */
+    void notify();
+
+    /**
+     * Block until a message is received, notify is called or timeout.
+     * @param msec Timeout (milli second).
+     */
+    void wait(unsigned int msec);
+
     /**
      * Send load llvm command.
      * Packet format: {
@@ -356,6 +369,8 @@ namespace processwarp {
     std::condition_variable_any sio_cond;
     std::atomic<SioStatus> sio_status {SETUP};
     std::queue<std::pair<std::string, sio::message::ptr>> sio_queue;
+    // True if notify was called after last wait.
+    bool sio_notified {false};
     
     /**
      * Event listener for Socket.IO's close event.
@@ -16,22 +16,24 @@ namespace processwarp {
   class StackInfo {
   public:
     /// 関数
-    const vaddr_t func;
+    vaddr_t func;
     /// 関数領域のキャッシュ
     FuncStore* func_cache;
 
     /// return格納先
-    const vaddr_t ret_addr;
+    vaddr_t ret_addr;
 
     /// unwindなしに関数が終了した場合にpcに設定する値
-    const unsigned int normal_pc;
+    unsigned int normal_pc;
     /// unwindが発生した場合にpcに設定する値
-    const unsigned int unwind_pc;
+    unsigned int unwind_pc;
 
     /// スタック領域
-    const vaddr_t stack;
+    vaddr_t stack;
     /// スタック領域のキャッシュ(実アドレスへのポインタ)
-    DataStore* stack_cache;
+    uint8_t* stack_cache;
+    /// 呼び出し時点のスタックセグメントの使用量、関数の終了時にこの位置まで戻す
+    size_t stack_base;
 
     /// allocaで確保された領域
     std::vector<vaddr_t> alloca_addrs;
@@ -70,6 +72,9 @@ namespace processwarp {
     /// アドレスレジスタキャッシュ
     uint8_t* address_cache;
 
+    /// キャッシュを解決した時点の仮想メモリの世代番号(0の場合は未解決)
+    uint64_t cache_generation;
+
     /**
      * コンストラクタ。
      * @param func_ 関数
@@ -84,5 +89,19 @@ namespace processwarp {
 	      unsigned int unwind_pc_,
 	      vaddr_t stack_);
 
+    /**
+     * 再利用のため、コンストラクタ直後と同じ状態に戻す。
+     * alloca_addrsの確保済みの領域は解放せずに保持する。
+     * @param func_ 関数
+     * @param ret_addr_ return格納先
+     * @param normal_pc_ unwindなしに関数が終了した場合にpcに設定する値
+     * @param unwind_pc_ unwindが発生した場合にpcに設定する値
+     * @param stack_ スタック領域
+     */
+    void reset(vaddr_t func_,
+	       vaddr_t ret_addr_,
+	       unsigned int normal_pc_,
+	       unsigned int unwind_pc_,
+	       vaddr_t stack_);
   };
 }
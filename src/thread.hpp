@@ -1,8 +1,10 @@
 #pragma once
 
+#include <map>
 #include <vector>
 #include <memory>
 
+#include "async_call.hpp"
 #include "definitions.hpp"
 #include "stackinfo.hpp"
 
@@ -19,6 +21,8 @@ namespace processwarp {
     /// Type of warp parameter.
     typedef std::map<vm_int_t, vm_int_t> WarpParameter;
 
+    /// スレッドID(pthread_t)
+    vm_uint_t tid;
     /// 呼び出し階層
     StackInfos stackinfos;
     /// Functions that will be called at befor warp.
@@ -30,5 +34,50 @@ namespace processwarp {
 
     /// 複合型に対する演算命令
     TypeComplex type_complex;
+
+    /// 関数から戻った後、次の関数呼び出しで再利用するために保持しているStackInfo
+    StackInfos stackinfo_pool;
+    /// 関数のスタック領域とalloca領域を積み上げて確保するスタックセグメント
+    vaddr_t stack_segment;
+    /// スタックセグメントのキャッシュ
+    DataStore* stack_segment_cache;
+    /// スタックセグメントの使用量(次に確保する領域の先頭位置)
+    size_t stack_pointer;
+    /// 関数呼び出し時に可変長引数、ネイティブ関数用の引数を一時的に格納する領域
+    std::vector<uint8_t> call_work;
+    /// 末尾呼び出し時に呼び出し元の領域を開放するまで通常の引数を一時的に格納する領域
+    std::vector<uint8_t> tailcall_work;
+
+    /// 開始関数から戻り、スレッドが終了している場合true
+    bool is_finished;
+    /// pthread_detachで切り離されたスレッドの場合true、終了後にjoinを待たずに開放する
+    bool is_detached;
+    /// 組み込み関数で待ち状態になった場合true
+    /// 他のスレッドに切り替え、次に実行する時は待ちになったCALL命令からやり直す
+    bool is_waiting;
+    /// pthread_cond_waitで待っている条件変数(待っていない場合VADDR_NON)
+    vaddr_t waiting_cond;
+    /// 条件変数で待っている間にシグナルを受け取った場合true
+    bool is_signaled;
+    /// 組み込み関数が開始し、完了を待っている非同期処理(待っていない場合nullptr)
+    /// warpでは転送しないため、転送先では組み込み関数を最初からやり直す
+    std::shared_ptr<AsyncCall> async_call;
+
+    /**
+     * コンストラクタ。
+     * スタックセグメントは最初の関数呼び出し時に確保する。
+     * @param tid_ スレッドID(省略時は最初のスレッドのID)
+     */
+    Thread(vm_uint_t tid_ = MAIN_THREAD_ID) :
+      tid(tid_),
+      stack_segment(VADDR_NON),
+      stack_segment_cache(nullptr),
+      stack_pointer(0),
+      is_finished(false),
+      is_detached(false),
+      is_waiting(false),
+      waiting_cond(VADDR_NON),
+      is_signaled(false) {
+    }
   };
 }
@@ -178,13 +178,11 @@ namespace processwarp {
 
   M_BINARY_OPERATOR_UNSUPPORT(op_and, double); // and
   M_BINARY_OPERATOR_UNSUPPORT(op_or,  double); // or
-  M_BINARY_OPERATOR_UNSUPPORT(op_rem, double); // 剰余
   M_BINARY_OPERATOR_UNSUPPORT(op_shl, double); // 左シフト
   M_BINARY_OPERATOR_UNSUPPORT(op_shr, double); // 右シフト
   M_BINARY_OPERATOR_UNSUPPORT(op_xor, double); // xor
   M_BINARY_OPERATOR_UNSUPPORT(op_and, float); // and
   M_BINARY_OPERATOR_UNSUPPORT(op_or,  float); // or
-  M_BINARY_OPERATOR_UNSUPPORT(op_rem, float); // 剰余
   M_BINARY_OPERATOR_UNSUPPORT(op_shl, float); // 左シフト
   M_BINARY_OPERATOR_UNSUPPORT(op_shr, float); // 右シフト
   M_BINARY_OPERATOR_UNSUPPORT(op_xor, float); // xor
@@ -201,6 +199,24 @@ namespace processwarp {
 
 #undef M_BINARY_OPERATOR_UNSUPPORT
 
+  // rem命令に対応した剰余を行う。浮動小数点数はfmodと同じ結果とする。
+  template<> void TypeExtended<double>::op_rem(uint8_t* dst, uint8_t* a, uint8_t* b) {
+    *reinterpret_cast<double*>(dst) =
+      std::fmod(*reinterpret_cast<double*>(a), *reinterpret_cast<double*>(b));
+    print_debug("%p : %s = %s %% %s\n", dst, Util::numptr2str(dst, sizeof(double)).c_str(),
+		Util::numptr2str(a, sizeof(double)).c_str(),
+		Util::numptr2str(b, sizeof(double)).c_str());
+  }
+
+  // rem命令に対応した剰余を行う。浮動小数点数はfmodと同じ結果とする。
+  template<> void TypeExtended<float>::op_rem(uint8_t* dst, uint8_t* a, uint8_t* b) {
+    *reinterpret_cast<float*>(dst) =
+      std::fmod(*reinterpret_cast<float*>(a), *reinterpret_cast<float*>(b));
+    print_debug("%p : %s = %s %% %s\n", dst, Util::numptr2str(dst, sizeof(float)).c_str(),
+		Util::numptr2str(a, sizeof(float)).c_str(),
+		Util::numptr2str(b, sizeof(float)).c_str());
+  }
+
   // 比較命令(!isnan(a) && !isnan(b))に対応した演算を行う。
   template<> void TypeExtended<double>::op_not_nans(uint8_t* dst, uint8_t* a, uint8_t* b) {
     if (!std::isnan(*reinterpret_cast<double*>(a)) &&
@@ -397,6 +413,42 @@ void TypePointer::type_cast(uint8_t* dst, vaddr_t type, uint8_t* src) {
 	      Util::numptr2str(src, sizeof(vaddr_t)).c_str());
 }
 
+/// 128bit整数型のサイズ
+static const size_t WIDE_INTEGER_SIZE = 16;
+
+// 値をコピーする。
+void TypeWideInteger::copy(uint8_t* dst, uint8_t* src) {
+  memcpy(dst, src, WIDE_INTEGER_SIZE);
+  print_debug("copy %s (%p <- %p)\n",
+	      Util::numptr2str(dst, WIDE_INTEGER_SIZE).c_str(), dst, src);
+}
+
+// 比較命令(a==b)に対応した演算を行う。
+void TypeWideInteger::op_equal(uint8_t* dst, uint8_t* a, uint8_t* b) {
+  if (memcmp(a, b, WIDE_INTEGER_SIZE) == 0) {
+    *reinterpret_cast<uint8_t*>(dst) = I8_TRUE;
+  } else {
+    *reinterpret_cast<uint8_t*>(dst) = I8_FALSE;
+  }
+  print_debug("%p : %s = %s == %s\n", dst,
+	      Util::numptr2str(dst, 1).c_str(),
+	      Util::numptr2str(a, WIDE_INTEGER_SIZE).c_str(),
+	      Util::numptr2str(b, WIDE_INTEGER_SIZE).c_str());
+}
+
+// 比較命令(a!=b)に対応した演算を行う。
+void TypeWideInteger::op_not_equal(uint8_t* dst, uint8_t* a, uint8_t* b) {
+  if (memcmp(a, b, WIDE_INTEGER_SIZE) == 0) {
+    *reinterpret_cast<uint8_t*>(dst) = I8_FALSE;
+  } else {
+    *reinterpret_cast<uint8_t*>(dst) = I8_TRUE;
+  }
+  print_debug("%p : %s = %s != %s\n", dst,
+	      Util::numptr2str(dst, 1).c_str(),
+	      Util::numptr2str(a, WIDE_INTEGER_SIZE).c_str(),
+	      Util::numptr2str(b, WIDE_INTEGER_SIZE).c_str());
+}
+
 // 値をコピーする。
 void TypeComplex::copy(uint8_t* dst, uint8_t* src) {
   memcpy(dst, src, type_store->size);
@@ -398,6 +398,36 @@ namespace processwarp {
     void type_cast(uint8_t* dst, vaddr_t type, uint8_t* src) override;
   };
 
+  /**
+   * 128bit整数型に対する演算命令。
+   * 演算は未対応で、コピーと一致の判定(switchの分岐など)だけを行う。
+   */
+  class TypeWideInteger : public TypeBased {
+  public:
+    /**
+     * 値をコピーする。
+     * @param dst コピー先
+     * @param src コピー元
+     */
+    void copy(uint8_t* dst, uint8_t* src) override;
+
+    /**
+     * 比較命令(a==b)に対応した演算を行う。
+     * @param dst 出力先
+     * @param a
+     * @param b
+     */
+    void op_equal(uint8_t* dst, uint8_t* a, uint8_t* b) override;
+
+    /**
+     * 比較命令(a!=b)に対応した演算を行う。
+     * @param dst 出力先
+     * @param a
+     * @param b
+     */
+    void op_not_equal(uint8_t* dst, uint8_t* a, uint8_t* b) override;
+  };
+
   /**
    * 複合型に対する演算命令。
    */
@@ -54,6 +54,20 @@ static const char* OPCODE_STR[] = {
   "SELECT",
   "SHUFFLE",
   "VA_ARG",
+  "BINARY_OP",
+  "TEST_OP", // 50
+  "CAST_OP",
+  "LOAD_OP",
+  "STORE_OP",
+  "PHI_MOVE",
+  "SWITCH_TABLE",
+  "SWITCH_SEARCH",
+  "GET_ELEMENT_PTR",
+  "QUICK_CALL",
+  "QUICK_SET_TYPE",
+  "QUICK_CALL_INDIRECT",
+  "QUICK_TAILCALL",
+  "QUICK_TAILCALL_INDIRECT",
 };
 
 #if defined(ENABLE_LLVM) && !defined(NDEBUG) && !defined(EMSCRIPTEN)
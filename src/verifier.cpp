@@ -0,0 +1,692 @@
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "instruction.hpp"
+#include "verifier.hpp"
+#include "vmemory.hpp"
+
+using namespace processwarp;
+
+/// 検証で参照した型のアドレスとサイズの組
+typedef std::vector<std::pair<vaddr_t, vaddr_t>> TypeSizes;
+
+/// 検証中の関数の情報
+struct VerifyContext {
+  /// 命令配列
+  const std::vector<instruction_t>& code;
+  /// 関数で利用するスタックサイズ
+  vaddr_t stack_size;
+  /// 定数領域のサイズ
+  vaddr_t k_size;
+  /// 定数領域
+  const DataStore& k;
+  /// 定数領域が示す型を持つ仮想メモリ
+  VMemory& vmemory;
+  /// 命令の先頭位置(EXTRAなど前の命令の一部でない位置)ならtrue
+  std::vector<bool> is_head;
+  /// 分岐先や分岐命令の直後など、直前の命令から順に実行が進むとは限らない位置ならtrue
+  std::vector<bool> is_entry;
+  /// 分岐先の一覧
+  std::vector<unsigned int> targets;
+  /// 検証で参照した型
+  TypeSizes types;
+};
+
+/// 検証済みの関数の内容
+struct VerifiedCode {
+  /// 関数で利用するスタックサイズ
+  vaddr_t stack_size;
+  /// 定数領域
+  std::vector<uint8_t> k;
+  /// 命令配列
+  std::vector<instruction_t> code;
+  /// 検証で参照した型
+  TypeSizes types;
+};
+
+/**
+ * 型のサイズに依存する幅の検証で、出力先や左辺値として設定されている領域。
+ * 設定したSET_OUTPUTなどの命令か、以下の特別な値をとる。
+ */
+/// 設定されていないか、直前の命令から順に実行が進むとは限らないため分からない
+static const instruction_t SLOT_UNKNOWN = 0xFFFFFFFF;
+/// ポインタが指すメモリ(ポインタ経由の読み書きは範囲を検査しない)
+static const instruction_t SLOT_MEMORY = 0xFFFFFFFE;
+
+/// 型に依存する命令が使う、直前の命令が設定した実行状態
+struct TypeState {
+  /// 現在の型、分からない場合nullptr
+  const TypeStore* type;
+  /// 出力先
+  instruction_t output;
+  /// 左辺値
+  instruction_t value;
+};
+
+/// 命令列のハッシュ値と検証済みの関数の内容の対応
+/// 同じプロセス内の全てのVMで共有し、同じ関数を何度展開しても検証は1度で済ませる
+/// 記録はメモリ上のみで、プロセスを越えては残らない
+/// キーには検証が読む入力(命令配列、スタックサイズ、定数領域の内容、参照した型のサイズ)を全て含める
+/// 型のアドレスはVMごとに割り当てるため、参照した型のサイズは判定するVMの仮想メモリで比較する
+/// 検証が読む入力を増やす場合は、VerifiedCodeとfind_verifiedにも加えること
+static std::multimap<uint64_t, VerifiedCode> verified_cache;
+/// verified_cacheの排他制御
+static std::mutex verified_mutex;
+
+// 検証結果に影響する関数の内容からハッシュ値(FNV-1a)を計算する。
+static uint64_t get_code_hash(const std::vector<instruction_t>& code,
+			      vaddr_t stack_size, const DataStore& k) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  hash = (hash ^ stack_size) * 0x100000001b3ULL;
+  hash = (hash ^ k.size) * 0x100000001b3ULL;
+  for (size_t i = 0; i < k.size; i ++) {
+    hash = (hash ^ k.head[i]) * 0x100000001b3ULL;
+  }
+  for (instruction_t inst : code) {
+    hash = (hash ^ inst) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// 型のアドレスがVMに存在し、記録したサイズと一致するかを判定する。
+static bool is_same_types(const TypeSizes& types, VMemory& vmemory) {
+  for (auto& it : types) {
+    if (!VMemory::addr_is_type(it.first) || !vmemory.addr_is_used(it.first) ||
+	vmemory.get_type(it.first).size != it.second) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// 検証済みの関数の中に内容の一致するものがあるかどうかを判定する。
+// verified_mutexを確保した状態で呼び出す。
+static bool find_verified(uint64_t hash, const std::vector<instruction_t>& code,
+			  vaddr_t stack_size, const DataStore& k, VMemory& vmemory) {
+  auto range = verified_cache.equal_range(hash);
+  for (auto it = range.first; it != range.second; it ++) {
+    // ハッシュ値の衝突で未検証の命令列を通さないよう、内容を全て比較する
+    if (it->second.stack_size == stack_size && it->second.k.size() == k.size &&
+	std::equal(it->second.k.begin(), it->second.k.end(), k.head.get()) &&
+	it->second.code == code && is_same_types(it->second.types, vmemory)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// 融合命令の対象となる基本型のサイズを取得する。対象外の型の場合0を戻す。
+static unsigned int get_basic_size(vaddr_t type) {
+  switch (type) {
+  case BasicType::TY_POINTER: return sizeof(vaddr_t);
+  case BasicType::TY_UI8:  case BasicType::TY_SI8:  return sizeof(uint8_t);
+  case BasicType::TY_UI16: case BasicType::TY_SI16: return sizeof(uint16_t);
+  case BasicType::TY_UI32: case BasicType::TY_SI32: return sizeof(uint32_t);
+  case BasicType::TY_UI64: case BasicType::TY_SI64: return sizeof(uint64_t);
+  case BasicType::TY_F32: return sizeof(float);
+  case BasicType::TY_F64: return sizeof(double);
+  default: return 0;
+  }
+}
+
+// 整数のビット幅から、値の格納に使うサイズを取得する。
+static vaddr_t get_int_width(vaddr_t bits) {
+  return bits <= 8 ? 1 : bits <= 16 ? 2 : bits <= 32 ? 4 : 8;
+}
+
+// 比較の演算かどうかを判定する。
+static bool is_compare(instruction_t sub) {
+  return (sub == Opcode::EQUAL || sub == Opcode::NOT_EQUAL ||
+	  sub == Opcode::GREATER || sub == Opcode::GREATER_EQUAL ||
+	  sub == Opcode::NOT_NANS);
+}
+
+// 2項演算子の融合命令で利用できる演算かどうかを判定する。
+static bool is_binary(instruction_t sub) {
+  switch (sub) {
+  case Opcode::ADD: case Opcode::SUB: case Opcode::MUL: case Opcode::DIV:
+  case Opcode::REM: case Opcode::SHL: case Opcode::SHR: case Opcode::AND:
+  case Opcode::OR:  case Opcode::XOR:
+    return true;
+
+  default:
+    return is_compare(sub);
+  }
+}
+
+// 指定位置の命令がEXTRAかどうかを判定する。
+static bool is_extra(const VerifyContext& ctx, unsigned int pc) {
+  return pc < ctx.code.size() && Instruction::get_opcode(ctx.code[pc]) == Opcode::EXTRA;
+}
+
+// オペランドの指す値の領域がスタック、定数領域の範囲内に収まっているかを判定する。
+static bool check_operand(const VerifyContext& ctx, instruction_t code, vaddr_t width) {
+  instruction_t operand = Instruction::get_operand(code);
+  if ((operand & HEAD_OPERAND) != 0) {
+    // 定数の場合1の補数表現からの復元
+    vaddr_t position = FILL_OPERAND - operand;
+    return position + width <= ctx.k_size;
+
+  } else {
+    return operand + width <= ctx.stack_size;
+  }
+}
+
+// 型を指すオペランドが定数領域の範囲内に収まっているかを判定する。
+static bool check_type(const VerifyContext& ctx, instruction_t code) {
+  return ((Instruction::get_operand(code) & HEAD_OPERAND) != 0 &&
+	  check_operand(ctx, code, sizeof(vaddr_t)));
+}
+
+// 型を指すオペランドから型を取得する。型が存在しない場合nullptrを戻す。
+// オペランドはcheck_typeで確認済みであること。取得した型は検証結果と共に記録する。
+static const TypeStore* get_type(VerifyContext& ctx, instruction_t code) {
+  vaddr_t addr = *reinterpret_cast<const vaddr_t*>
+    (ctx.k.head.get() + (FILL_OPERAND - Instruction::get_operand(code)));
+  if (!VMemory::addr_is_type(addr) || !ctx.vmemory.addr_is_used(addr)) return nullptr;
+
+  const TypeStore& type = ctx.vmemory.get_type(addr);
+  ctx.types.push_back(std::make_pair(addr, type.size));
+  return &type;
+}
+
+// 出力先や左辺値として設定されている領域に、指定サイズ分の値が収まっているかを判定する。
+static bool check_slot(const VerifyContext& ctx, instruction_t slot, vaddr_t width) {
+  if (slot == SLOT_UNKNOWN) return false;
+  if (slot == SLOT_MEMORY) return true;
+  return check_operand(ctx, slot, width);
+}
+
+// 1命令分(続くEXTRAを含む)を検証し、命令の語数と次の命令に進むかどうかを取得する。
+static bool verify_instruction(VerifyContext& ctx, unsigned int pc,
+			       unsigned int* length, bool* is_fall_through) {
+  const std::vector<instruction_t>& code = ctx.code;
+  const instruction_t head = code[pc];
+  *length = 1;
+  *is_fall_through = true;
+
+  /**
+   * 条件を満たさない場合に検証失敗とするマクロ。
+   * @param cond 条件
+   */
+#define M_REQUIRE(cond) if (!(cond)) return false
+
+  /**
+   * 続くEXTRAの数を確認するマクロ。
+   * @param n EXTRAの数
+   */
+#define M_REQUIRE_EXTRA(n)				\
+  for (unsigned int i = 1; i <= (n); i ++) {		\
+    M_REQUIRE(is_extra(ctx, pc + i));			\
+  }							\
+  *length = 1 + (n)
+
+  switch (Instruction::get_opcode(head)) {
+  case Opcode::NOP:
+  case Opcode::SET_ALIGN:
+  case Opcode::ADD_ADR:
+  case Opcode::MUL_ADR: {
+    // オペランドは数値
+  } break;
+
+  case Opcode::CALL:
+  case Opcode::TAILCALL: {
+    M_REQUIRE(check_operand(ctx, head, sizeof(vaddr_t)));
+    // 正常時、異常時の戻り先、戻り値の格納先と、引数の型と値の組が続く
+    unsigned int extras = 0;
+    while (is_extra(ctx, pc + 1 + extras)) extras ++;
+    M_REQUIRE(extras >= 3 && extras % 2 == 1);
+    for (unsigned int i = 1; i <= 2; i ++) {
+      instruction_t label = Instruction::get_operand(code[pc + i]);
+      if (label != FILL_OPERAND) ctx.targets.push_back(label);
+    }
+    M_REQUIRE(Instruction::get_operand(code[pc + 3]) == FILL_OPERAND ||
+	      check_operand(ctx, code[pc + 3], 1));
+    // 引数の値は型のサイズ分コピーされる
+    // 呼び出し先のスタックに収まるかは、呼び出し先が実行時に決まるためCALL命令で確認する
+    for (unsigned int i = 4; i < 1 + extras; i += 2) {
+      M_REQUIRE(check_type(ctx, code[pc + i]));
+      const TypeStore* type = get_type(ctx, code[pc + i]);
+      M_REQUIRE(type != nullptr);
+      M_REQUIRE(check_operand(ctx, code[pc + i + 1], type->size));
+    }
+    *length = 1 + extras;
+  } break;
+
+  case Opcode::RETURN: {
+    // 戻り値がある場合、値のサイズが続く
+    if (Instruction::get_operand(head) != FILL_OPERAND) {
+      M_REQUIRE_EXTRA(1);
+      M_REQUIRE(check_operand(ctx, head, Instruction::get_operand(code[pc + 1])));
+    }
+    *is_fall_through = false;
+  } break;
+
+  case Opcode::SET_TYPE:
+  case Opcode::TYPE_CAST:
+  case Opcode::BIT_CAST: {
+    M_REQUIRE(check_type(ctx, head));
+  } break;
+
+  case Opcode::SET_OV_PTR:
+  case Opcode::SET_PTR:
+  case Opcode::GET_ADR: {
+    // オペランドはアドレスを格納している
+    M_REQUIRE(check_operand(ctx, head, sizeof(vaddr_t)));
+  } break;
+
+  case Opcode::ALLOCA: {
+    // オペランドは確保する要素数(32bit)
+    M_REQUIRE(check_operand(ctx, head, sizeof(uint32_t)));
+  } break;
+
+  case Opcode::SET_OUTPUT:
+  case Opcode::SET_VALUE:
+  case Opcode::ADD:
+  case Opcode::SUB:
+  case Opcode::MUL:
+  case Opcode::DIV:
+  case Opcode::REM:
+  case Opcode::SHL:
+  case Opcode::SHR:
+  case Opcode::AND:
+  case Opcode::OR:
+  case Opcode::XOR:
+  case Opcode::SET:
+  case Opcode::SET_ADR:
+  case Opcode::LOAD:
+  case Opcode::STORE:
+  case Opcode::CMPXCHG:
+  case Opcode::EQUAL:
+  case Opcode::NOT_EQUAL:
+  case Opcode::GREATER:
+  case Opcode::GREATER_EQUAL:
+  case Opcode::NOT_NANS: {
+    M_REQUIRE(check_operand(ctx, head, 1));
+  } break;
+
+  case Opcode::OR_NANS: {
+    // 比較不能な場合は次の命令を飛ばす
+    M_REQUIRE(check_operand(ctx, head, 1));
+    ctx.targets.push_back(pc + 2);
+  } break;
+
+  case Opcode::TEST:
+  case Opcode::TEST_EQ: {
+    M_REQUIRE(check_operand(ctx, head, 1));
+    M_REQUIRE_EXTRA(1);
+    ctx.targets.push_back(Instruction::get_operand(code[pc + 1]));
+  } break;
+
+  case Opcode::JUMP: {
+    ctx.targets.push_back(Instruction::get_operand(head));
+    *is_fall_through = false;
+  } break;
+
+  case Opcode::INDIRECT_JUMP: {
+    // 分岐先が実行時に決まり、分岐先での型の状態を追えないため検証しない
+    return false;
+  } break;
+
+  case Opcode::PHI: {
+    // 値と分岐元ラベルの組が続き、PHI命令の後には必ず次の命令がある
+    unsigned int count = 0;
+    do {
+      M_REQUIRE(check_operand(ctx, code[pc + count], 1));
+      M_REQUIRE(is_extra(ctx, pc + count + 1));
+      count += 2;
+      M_REQUIRE(pc + count < code.size());
+    } while (Instruction::get_opcode(code[pc + count]) == Opcode::PHI ||
+	     Instruction::get_opcode(code[pc + count]) == Opcode::EXTRA);
+    *length = count;
+  } break;
+
+  case Opcode::PHI_MOVE: {
+    // phi_move <n> (<dst> <src> <size>)×n <block start> <body start>
+    unsigned int moves = Instruction::get_operand(head);
+    M_REQUIRE_EXTRA(moves * 3 + 2);
+    for (unsigned int i = 0; i < moves; i ++) {
+      instruction_t dst = code[pc + 1 + i * 3];
+      instruction_t src = code[pc + 2 + i * 3];
+      vaddr_t size = Instruction::get_operand(code[pc + 3 + i * 3]);
+      // コピー先はスタック
+      M_REQUIRE((Instruction::get_operand(dst) & HEAD_OPERAND) == 0);
+      M_REQUIRE(check_operand(ctx, dst, size));
+      M_REQUIRE(check_operand(ctx, src, size));
+    }
+    ctx.targets.push_back(Instruction::get_operand(code[pc + 1 + moves * 3]));
+    ctx.targets.push_back(Instruction::get_operand(code[pc + 2 + moves * 3]));
+    *is_fall_through = false;
+  } break;
+
+  case Opcode::SWITCH_TABLE:
+  case Opcode::SWITCH_SEARCH: {
+    // switch_table <value> <bits> <min> <n> <default> <dest>×n
+    // switch_search <value> <bits> <keys> <n> <default> <dest>×n
+    M_REQUIRE(is_extra(ctx, pc + 1) && is_extra(ctx, pc + 2) && is_extra(ctx, pc + 3));
+    vaddr_t bits  = Instruction::get_operand(code[pc + 1]);
+    vaddr_t count = Instruction::get_operand(code[pc + 3]);
+    M_REQUIRE(bits != 0 && bits <= 64);
+    M_REQUIRE(check_operand(ctx, head, get_int_width(bits)));
+    // 値の表は定数領域に置かれている
+    M_REQUIRE((Instruction::get_operand(code[pc + 2]) & HEAD_OPERAND) != 0);
+    M_REQUIRE(check_operand(ctx, code[pc + 2], sizeof(int64_t) *
+			    (Instruction::get_opcode(head) == Opcode::SWITCH_TABLE ? 1 : count)));
+    M_REQUIRE_EXTRA(count + 4);
+    for (unsigned int i = 4; i <= count + 4; i ++) {
+      ctx.targets.push_back(Instruction::get_operand(code[pc + i]));
+    }
+    *is_fall_through = false;
+  } break;
+
+  case Opcode::GET_ELEMENT_PTR: {
+    // get_element_ptr <n> <output> <pointer> <offset> (<index> <bits> <size>)×n
+    unsigned int count = Instruction::get_operand(head);
+    M_REQUIRE_EXTRA(count * 3 + 3);
+    M_REQUIRE(check_operand(ctx, code[pc + 1], sizeof(vaddr_t)));
+    M_REQUIRE(check_operand(ctx, code[pc + 2], sizeof(vaddr_t)));
+    M_REQUIRE(check_operand(ctx, code[pc + 3], sizeof(int64_t)));
+    for (unsigned int i = 0; i < count; i ++) {
+      vaddr_t bits = Instruction::get_operand(code[pc + 5 + i * 3]);
+      M_REQUIRE(bits != 0 && bits <= 64);
+      M_REQUIRE(check_operand(ctx, code[pc + 4 + i * 3], get_int_width(bits)));
+      M_REQUIRE(check_operand(ctx, code[pc + 6 + i * 3], sizeof(int64_t)));
+    }
+  } break;
+
+  case Opcode::SELECT: {
+    M_REQUIRE(check_operand(ctx, head, 1));
+    M_REQUIRE_EXTRA(1);
+    M_REQUIRE(check_operand(ctx, code[pc + 1], 1));
+  } break;
+
+  case Opcode::SHUFFLE: {
+    M_REQUIRE_EXTRA(2);
+    M_REQUIRE(check_operand(ctx, code[pc + 1], 1));
+    M_REQUIRE(check_operand(ctx, code[pc + 2], 1));
+  } break;
+
+  case Opcode::BINARY_OP:
+  case Opcode::TEST_OP: {
+    // binary_op <(ty << 6) | op> <type> <output> <value> <operand>
+    // test_op <(ty << 6) | op> <type> <output> <value> <operand> <then> <else>
+    bool is_test = (Instruction::get_opcode(head) == Opcode::TEST_OP);
+    instruction_t operand = Instruction::get_operand(head);
+    instruction_t sub = Instruction::get_fused_sub(operand);
+    vaddr_t type = Instruction::get_fused_type(operand);
+    M_REQUIRE(operand == static_cast<instruction_t>
+	      (Instruction::make_fused_operand(type, sub)));
+    M_REQUIRE(is_test ? is_compare(sub) : is_binary(sub));
+    M_REQUIRE_EXTRA(is_test ? 6 : 4);
+    M_REQUIRE(check_type(ctx, code[pc + 1]));
+    // 型を特定しない場合、値のサイズは続くEXTRAが示す型による
+    vaddr_t width = get_basic_size(type);
+    if (type == 0) {
+      const TypeStore* store = get_type(ctx, code[pc + 1]);
+      M_REQUIRE(store != nullptr);
+      width = store->size;
+    }
+    M_REQUIRE(width != 0);
+    M_REQUIRE(check_operand(ctx, code[pc + 2], is_compare(sub) ? 1 : width));
+    M_REQUIRE(check_operand(ctx, code[pc + 3], width));
+    M_REQUIRE(check_operand(ctx, code[pc + 4], width));
+    if (is_test) {
+      ctx.targets.push_back(Instruction::get_operand(code[pc + 5]));
+      ctx.targets.push_back(Instruction::get_operand(code[pc + 6]));
+      *is_fall_through = false;
+    }
+  } break;
+
+  case Opcode::CAST_OP: {
+    // cast_op <(src << 6) | dst> <output> <value>
+    instruction_t operand = Instruction::get_operand(head);
+    vaddr_t src = Instruction::get_fused_type(operand);
+    vaddr_t dst = Instruction::get_fused_sub(operand);
+    M_REQUIRE(operand == static_cast<instruction_t>
+	      (Instruction::make_fused_operand(src, dst)));
+    M_REQUIRE(src != BasicType::TY_POINTER && get_basic_size(src) != 0);
+    M_REQUIRE(dst != BasicType::TY_POINTER && get_basic_size(dst) != 0);
+    M_REQUIRE_EXTRA(2);
+    M_REQUIRE(check_operand(ctx, code[pc + 1], get_basic_size(dst)));
+    M_REQUIRE(check_operand(ctx, code[pc + 2], get_basic_size(src)));
+  } break;
+
+  case Opcode::LOAD_OP:
+  case Opcode::STORE_OP: {
+    // load_op <ty> <output> <pointer> <disp>
+    // store_op <ty> <pointer> <value> <disp>
+    bool is_load = (Instruction::get_opcode(head) == Opcode::LOAD_OP);
+    vaddr_t width = get_basic_size(Instruction::get_operand(head));
+    M_REQUIRE(width != 0);
+    M_REQUIRE_EXTRA(3);
+    M_REQUIRE(check_operand(ctx, code[pc + 1], is_load ? width : sizeof(vaddr_t)));
+    M_REQUIRE(check_operand(ctx, code[pc + 2], is_load ? sizeof(vaddr_t) : width));
+  } break;
+
+  default: {
+    // EXTRA単体や実行できない命令
+    return false;
+  } break;
+  }
+
+#undef M_REQUIRE
+#undef M_REQUIRE_EXTRA
+  return true;
+}
+
+// 型のサイズ分を読み書きする命令のオペランド、出力先、左辺値が、その型のサイズ分の領域に収まっているかを検証する。
+// 型と出力先、左辺値は直前のSET_TYPEなどで設定された実行状態に従うため、命令列の先頭から状態を追う。
+// 分岐先など直前の命令から順に実行が進むとは限らない位置では、状態は分からないものとする。
+static bool verify_type_widths(VerifyContext& ctx) {
+  const std::vector<instruction_t>& code = ctx.code;
+  TypeState state = { nullptr, SLOT_UNKNOWN, SLOT_UNKNOWN };
+
+  /**
+   * 条件を満たさない場合に検証失敗とするマクロ。
+   * @param cond 条件
+   */
+#define M_REQUIRE(cond) if (!(cond)) return false
+
+  for (unsigned int pc = 0; pc < code.size(); pc ++) {
+    if (!ctx.is_head[pc]) continue;
+    if (ctx.is_entry[pc]) {
+      state.type   = nullptr;
+      state.output = SLOT_UNKNOWN;
+      state.value  = SLOT_UNKNOWN;
+    }
+    const instruction_t head = code[pc];
+    // 現在の型のサイズ、型が分からない場合は確認できないので検証失敗とする
+    const vaddr_t size = (state.type != nullptr ? state.type->size : 0);
+
+    switch (Instruction::get_opcode(head)) {
+    case Opcode::CALL:
+    case Opcode::TAILCALL: {
+      // 戻り値の格納先が出力先になる
+      instruction_t output = code[pc + 3];
+      state.output = (Instruction::get_operand(output) == FILL_OPERAND ? SLOT_UNKNOWN : output);
+    } break;
+
+    case Opcode::SET_TYPE: {
+      state.type = get_type(ctx, head);
+    } break;
+
+    case Opcode::SET_OUTPUT: {
+      state.output = head;
+    } break;
+
+    case Opcode::SET_VALUE: {
+      state.value = head;
+    } break;
+
+    case Opcode::SET_OV_PTR: {
+      // ポインタの指す値を出力先にコピーし、以降はポインタの指す先を出力先、左辺値とする
+      M_REQUIRE(size != 0 && check_slot(ctx, state.output, size));
+      state.output = SLOT_MEMORY;
+      state.value  = SLOT_MEMORY;
+    } break;
+
+    case Opcode::ADD:
+    case Opcode::SUB:
+    case Opcode::MUL:
+    case Opcode::DIV:
+    case Opcode::REM:
+    case Opcode::SHL:
+    case Opcode::SHR:
+    case Opcode::AND:
+    case Opcode::OR:
+    case Opcode::XOR: {
+      M_REQUIRE(size != 0 && check_slot(ctx, state.output, size));
+      M_REQUIRE(check_slot(ctx, state.value, size) && check_operand(ctx, head, size));
+    } break;
+
+    case Opcode::EQUAL:
+    case Opcode::NOT_EQUAL:
+    case Opcode::GREATER:
+    case Opcode::GREATER_EQUAL:
+    case Opcode::NOT_NANS:
+    case Opcode::OR_NANS: {
+      // 比較の結果は1byte
+      M_REQUIRE(size != 0 && check_slot(ctx, state.output, 1));
+      M_REQUIRE(check_slot(ctx, state.value, size) && check_operand(ctx, head, size));
+    } break;
+
+    case Opcode::SET: {
+      M_REQUIRE(size != 0 && check_slot(ctx, state.output, size));
+      M_REQUIRE(check_operand(ctx, head, size));
+    } break;
+
+    case Opcode::LOAD:
+    case Opcode::STORE: {
+      M_REQUIRE(size != 0 && check_operand(ctx, head, size));
+    } break;
+
+    case Opcode::CMPXCHG: {
+      // 出力先は値と書き換えの成否のフラグ
+      M_REQUIRE(size != 0 && check_slot(ctx, state.output, size + 1));
+      M_REQUIRE(check_slot(ctx, state.value, size) && check_operand(ctx, head, size));
+    } break;
+
+    case Opcode::ALLOCA: {
+      M_REQUIRE(size != 0 && check_slot(ctx, state.output, sizeof(vaddr_t)));
+    } break;
+
+    case Opcode::MUL_ADR: {
+      M_REQUIRE(size != 0 && check_slot(ctx, state.value, size));
+    } break;
+
+    case Opcode::TEST_EQ: {
+      M_REQUIRE(size != 0 && check_slot(ctx, state.value, size));
+      M_REQUIRE(check_operand(ctx, head, size));
+    } break;
+
+    case Opcode::TYPE_CAST:
+    case Opcode::BIT_CAST: {
+      // 左辺値を現在の型から、オペランドの型に変換して出力する
+      const TypeStore* dst = get_type(ctx, head);
+      M_REQUIRE(size != 0 && dst != nullptr);
+      M_REQUIRE(check_slot(ctx, state.output, dst->size) && check_slot(ctx, state.value, size));
+    } break;
+
+    case Opcode::PHI: {
+      // 分岐元に対応する値を出力先にコピーする
+      M_REQUIRE(size != 0 && check_slot(ctx, state.output, size));
+      for (unsigned int i = pc; i < code.size() && (i == pc || !ctx.is_head[i]); i += 2) {
+	M_REQUIRE(check_operand(ctx, code[i], size));
+      }
+    } break;
+
+    case Opcode::SELECT: {
+      // 左辺値は条件(1byte)
+      M_REQUIRE(size != 0 && check_slot(ctx, state.output, size));
+      M_REQUIRE(check_slot(ctx, state.value, 1));
+      M_REQUIRE(check_operand(ctx, head, size) && check_operand(ctx, code[pc + 1], size));
+    } break;
+
+    case Opcode::SHUFFLE: {
+      // shuffle <m> <mask> <v2>
+      // 左辺値とv2はvector、マスクはm個のuint32、出力先は要素m個
+      M_REQUIRE(size != 0 && VMemory::addr_is_type(state.type->element) &&
+		ctx.vmemory.addr_is_used(state.type->element));
+      const TypeStore& element = ctx.vmemory.get_type(state.type->element);
+      ctx.types.push_back(std::make_pair(element.addr, element.size));
+      vaddr_t lanes = Instruction::get_operand(head);
+      M_REQUIRE(check_slot(ctx, state.output, element.size * lanes));
+      M_REQUIRE(check_slot(ctx, state.value, size));
+      M_REQUIRE(check_operand(ctx, code[pc + 1], sizeof(uint32_t) * lanes));
+      M_REQUIRE(check_operand(ctx, code[pc + 2], size));
+    } break;
+
+    default: {
+      // 型の状態に依存しない命令
+    } break;
+    }
+  }
+
+#undef M_REQUIRE
+  return true;
+}
+
+// 通常の関数の命令列を検証する。
+bool Verifier::verify(const FuncStore& func, const DataStore& k, VMemory& vmemory) {
+  const std::vector<instruction_t>& code = func.normal_prop.code;
+  VerifyContext ctx = {
+    code, func.normal_prop.stack_size, k.size, k, vmemory,
+    std::vector<bool>(code.size(), false), std::vector<bool>(code.size(), false),
+    std::vector<unsigned int>(), TypeSizes()
+  };
+
+  if (code.empty()) return false;
+
+  // 同じ内容の関数を検証済みの場合は検証を省略する
+  uint64_t hash = get_code_hash(code, ctx.stack_size, k);
+  {
+    std::lock_guard<std::mutex> guard(verified_mutex);
+    if (find_verified(hash, code, ctx.stack_size, k, vmemory)) return true;
+  }
+
+  // 命令を先頭から順に検証し、各命令の先頭位置を記録する
+  ctx.is_entry[0] = true;
+  for (unsigned int pc = 0; pc < code.size();) {
+    unsigned int length;
+    bool is_fall_through;
+    ctx.is_head[pc] = true;
+    if (!verify_instruction(ctx, pc, &length, &is_fall_through)) return false;
+    pc += length;
+    // 命令列の末尾を超えて実行が進むことはない
+    if (is_fall_through && pc >= code.size()) return false;
+    if (!is_fall_through && pc < code.size()) ctx.is_entry[pc] = true;
+  }
+
+  // 分岐先は命令の先頭位置でなければならない
+  for (unsigned int target : ctx.targets) {
+    if (target >= code.size() || !ctx.is_head[target]) return false;
+    ctx.is_entry[target] = true;
+  }
+
+  if (!verify_type_widths(ctx)) return false;
+
+  // 検証できた関数の内容を記録する
+  std::lock_guard<std::mutex> guard(verified_mutex);
+  if (verified_cache.size() < VERIFIED_CACHE_MAX &&
+      !find_verified(hash, code, ctx.stack_size, k, vmemory)) {
+    VerifiedCode verified = {
+      ctx.stack_size, std::vector<uint8_t>(k.head.get(), k.head.get() + k.size),
+      code, std::move(ctx.types)
+    };
+    verified_cache.insert(std::make_pair(hash, std::move(verified)));
+  }
+
+  return true;
+}
+
+// 同じ内容の関数を検証済みかどうかを判定する。
+bool Verifier::is_verified(const FuncStore& func, const DataStore& k, VMemory& vmemory) {
+  const std::vector<instruction_t>& code = func.normal_prop.code;
+  uint64_t hash = get_code_hash(code, func.normal_prop.stack_size, k);
+
+  std::lock_guard<std::mutex> guard(verified_mutex);
+  return find_verified(hash, code, func.normal_prop.stack_size, k, vmemory);
+}
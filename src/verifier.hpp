@@ -0,0 +1,39 @@
+#pragma once
+
+#include "data_store.hpp"
+#include "definitions.hpp"
+#include "func_store.hpp"
+
+namespace processwarp {
+  class VMemory;
+
+  /**
+   * 命令列の検証器クラス。
+   * 関数の展開時に1度だけ命令列を検査し、
+   * 実行時の命令ごとの検査を省略できるかどうかを判定する。
+   */
+  class Verifier {
+  public:
+    /**
+     * 通常の関数の命令列を検証する。
+     * 分岐先、EXTRAの並び、オペランドの範囲、PHIの構造が正しいことを確認する。
+     * 型のサイズ分を読み書きするオペランドは、直前のSET_TYPEなどが示す型のサイズで範囲を確認する。
+     * @param func 検証対象の関数
+     * @param k 関数の定数領域
+     * @param vmemory 定数領域が示す型を持つ仮想メモリ
+     * @return 実行時の検査を省略して実行できる場合true
+     */
+    static bool verify(const FuncStore& func, const DataStore& k, VMemory& vmemory);
+
+    /**
+     * 命令列、スタックサイズ、定数領域、参照する型のサイズが一致する関数を検証済みかどうかを判定する。
+     * 検証に成功した関数の内容はプロセス内で記録しておき、
+     * 同じプログラムの再実行やwarpで再び受け取った関数の検証を省略する。
+     * @param func 判定対象の関数
+     * @param k 関数の定数領域
+     * @param vmemory 定数領域が示す型を持つ仮想メモリ
+     * @return 同じ内容の関数を検証済みの場合true
+     */
+    static bool is_verified(const FuncStore& func, const DataStore& k, VMemory& vmemory);
+  };
+}
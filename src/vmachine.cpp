@@ -1,7 +1,10 @@
 
+#include <algorithm>
+#include <cmath>
 #include <cstring>
 #include <inttypes.h>
 #include <memory>
+#include <mutex>
 
 #if (defined(__APPLE__) && defined(__MACH__))
 #include <ffi/ffi.h>
@@ -29,15 +32,23 @@
 #include "builtin_memory.hpp"
 #include "builtin_overflow.hpp"
 #include "builtin_posix.hpp"
+#include "builtin_pthread.hpp"
 #include "builtin_va_arg.hpp"
 #include "builtin_warp.hpp"
 #include "stackinfo.hpp"
 #include "type_based.hpp"
 #include "util.hpp"
+#include "verifier.hpp"
 #include "vmachine.hpp"
 
 using namespace processwarp;
 
+// GCC、Clangなどcomputed gotoを利用できる環境ではthreaded dispatchで命令を実行する。
+// EMSCRIPTENの場合とDISABLE_THREADED_DISPATCHが指定された場合はswitchで命令を実行する。
+#if defined(__GNUC__) && !defined(EMSCRIPTEN) && !defined(DISABLE_THREADED_DISPATCH)
+#define ENABLE_THREADED_DISPATCH
+#endif
+
 static TypeBased* TYPE_BASES[] = {
   nullptr, // 0
   nullptr, // 1 void
@@ -60,7 +71,7 @@ static TypeBased* TYPE_BASES[] = {
   new TypeExtended<uint16_t>(), // 12 16bit整数型
   new TypeExtended<uint32_t>(), // 13 32bit整数型
   new TypeExtended<uint64_t>(), // 14 64bit整数型
-  nullptr,
+  new TypeWideInteger(), // 15 128bit整数型
   nullptr,
   nullptr,
   nullptr,
@@ -76,7 +87,7 @@ static TypeBased* TYPE_BASES[] = {
   new TypeExtended<int16_t>(), // 22 16bit整数型
   new TypeExtended<int32_t>(), // 23 32bit整数型
   new TypeExtended<int64_t>(), // 24 64bit整数型
-  nullptr,
+  new TypeWideInteger(), // 25 128bit整数型
   nullptr,
   nullptr,
   nullptr,
@@ -96,25 +107,30 @@ static TypeBased* TYPE_BASES[] = {
 };
 
 struct OperandRet {
-  DataStore& data;
   vaddr_t addr;
   uint8_t* cache;
 };
 
 struct OperandParam {
-  DataStore& stack;
+  uint8_t* stack;
+  vaddr_t stack_addr;
+  size_t stack_size;
   DataStore& k;
   VMemory& vmemory;
 };
 
 inline uint8_t* get_cache(vaddr_t addr, VMemory& vmemory) {
-  DataStore& store = vmemory.get_data(addr);
-  return store.head.get() + VMemory::get_addr_lower(addr);
+  return vmemory.get_data_ptr(addr);
 }
 
-inline FuncStore& get_function(instruction_t code, OperandParam& param) {
+// オペランドが示す関数を取得する。
+// 検証済みの関数でない場合、オペランドが範囲外であればエラーとする。
+template<bool VERIFIED> inline FuncStore& get_function(instruction_t code, OperandParam& param) {
   int operand = Instruction::get_operand(code);
   if ((operand & HEAD_OPERAND) != 0) {
+    if (!VERIFIED && (FILL_OPERAND - operand) + sizeof(vaddr_t) > param.k.size) {
+      throw_error(Error::INST_VIOLATION);
+    }
     assert((FILL_OPERAND - operand) < param.k.size);
     // 定数の場合1の補数表現からの復元
     vaddr_t addr =
@@ -122,41 +138,117 @@ inline FuncStore& get_function(instruction_t code, OperandParam& param) {
     return param.vmemory.get_func(addr);
     
   } else {
-    assert(operand < static_cast<signed>(param.stack.size));
-    vaddr_t addr = *reinterpret_cast<vaddr_t*>(param.stack.head.get() + operand);
+    if (!VERIFIED && operand + sizeof(vaddr_t) > param.stack_size) {
+      throw_error(Error::INST_VIOLATION);
+    }
+    assert(operand < static_cast<signed>(param.stack_size));
+    vaddr_t addr = *reinterpret_cast<vaddr_t*>(param.stack + operand);
     return param.vmemory.get_func(addr);
   }
 }
 
-inline OperandRet get_operand(instruction_t code, OperandParam& param) {
+// 関数ポインタ経由の呼び出し先をインラインキャッシュから取得する。
+// キャッシュにない場合は解決して先頭に追加し、溢れた最も古いものを捨てる。
+inline FuncStore* get_cached_function(FuncStore::CallCache& cache, vaddr_t addr,
+				      VMemory& vmemory) {
+  for (unsigned int i = 0; i < cache.count; i ++) {
+    if (cache.addrs[i] == addr) return cache.funcs[i];
+  }
+
+  FuncStore& target = vmemory.get_func(addr);
+  unsigned int last = (cache.count < FuncStore::CALL_CACHE_SIZE ?
+		       cache.count ++ : FuncStore::CALL_CACHE_SIZE - 1);
+  for (unsigned int i = last; i > 0; i --) {
+    cache.addrs[i] = cache.addrs[i - 1];
+    cache.funcs[i] = cache.funcs[i - 1];
+  }
+  cache.addrs[0] = addr;
+  cache.funcs[0] = &target;
+  return &target;
+}
+
+// オペランドが示す値の格納先を取得する。
+// 検証済みの関数でない場合、オペランドが範囲外であればエラーとする。
+template<bool VERIFIED> inline OperandRet get_operand(instruction_t code, OperandParam& param) {
   int operand = Instruction::get_operand(code);
   if ((operand & HEAD_OPERAND) != 0) {
     vaddr_t position = (FILL_OPERAND - operand);
+    if (!VERIFIED && position >= param.k.size) {
+      throw_error(Error::INST_VIOLATION);
+    }
     assert(position < param.k.size);
     // 定数の場合1の補数表現からの復元
-    return {param.k, param.k.addr + position, param.k.head.get() + position};
+    return {param.k.addr + position, param.k.head.get() + position};
     
   } else {
-    assert(operand < static_cast<signed>(param.stack.size));
-    return {param.stack, param.stack.addr + operand, param.stack.head.get() + operand};
+    if (!VERIFIED && operand >= static_cast<signed>(param.stack_size)) {
+      throw_error(Error::INST_VIOLATION);
+    }
+    assert(operand < static_cast<signed>(param.stack_size));
+    return {param.stack_addr + operand, param.stack + operand};
   }
 }
 
-inline TypeStore& get_type(instruction_t code, OperandParam& param) {
+// オペランドが示す型を取得する。
+// 検証済みの関数でない場合、オペランドが範囲外であればエラーとする。
+template<bool VERIFIED> inline TypeStore& get_type(instruction_t code, OperandParam& param) {
   int operand = Instruction::get_operand(code);
   // 型は定数領域に置かれているはず
+  if (!VERIFIED && ((operand & HEAD_OPERAND) == 0 ||
+		    (FILL_OPERAND - operand) + sizeof(vaddr_t) > param.k.size)) {
+    throw_error(Error::INST_VIOLATION);
+  }
   assert((operand & HEAD_OPERAND) != 0);
 
   vaddr_t addr = *reinterpret_cast<vaddr_t*>(param.k.head.get() + (FILL_OPERAND - operand));
   return param.vmemory.get_type(addr);
 }
 
+// 型情報に対応する型ごとの演算インスタンスを取得する。
+inline TypeBased* get_type_cache(TypeStore& store, TypeComplex& type_complex) {
+  if (store.addr < sizeof(TYPE_BASES) / sizeof(TYPE_BASES[0])) {
+    assert(TYPE_BASES[store.addr] != nullptr); // TODO 未対応の型
+    return TYPE_BASES[store.addr];
+
+  } else {
+    type_complex.type_store = &store;
+    return &type_complex;
+  }
+}
+
+// ビット幅を指定した整数を、符号拡張して取得する。
+inline int64_t get_sext_value(const uint8_t* ptr, unsigned int bits) {
+  int64_t value;
+  if (bits <= 8) {
+    value = *reinterpret_cast<const int8_t*>(ptr);
+  } else if (bits <= 16) {
+    value = *reinterpret_cast<const int16_t*>(ptr);
+  } else if (bits <= 32) {
+    value = *reinterpret_cast<const int32_t*>(ptr);
+  } else {
+    value = *reinterpret_cast<const int64_t*>(ptr);
+  }
+  // ビット幅より上位のビットは不定なため、符号ビットで埋め直す
+  unsigned int shift = 64 - bits;
+  return static_cast<int64_t>(static_cast<uint64_t>(value) << shift) >> shift;
+}
+
+// 命令の実行を継続できる状態かどうかを判定する。
+inline bool is_running(VMachine::Status status) {
+  return (status == VMachine::ACTIVE || status == VMachine::EXITING ||
+	  status == VMachine::WAIT_WARP || status == VMachine::BEFOR_WARP ||
+	  status == VMachine::AFTER_WARP);
+}
+
 // Constructor.
 VMachine::VMachine(std::vector<void*>& _libs,
 		   const std::map<std::string, std::string>& _lib_filter) :
   libs(_libs),
   lib_filter(_lib_filter),
-  status(SETUP) {
+  status(SETUP),
+  current_thread(0),
+  last_tid(MAIN_THREAD_ID),
+  is_stalled(false) {
 }
 
 // 仮想アドレスとネイティブポインタのペアを解消する。
@@ -169,10 +261,53 @@ void VMachine::destory_native_ptr(vaddr_t addr) {
 }
 
 // VM命令を実行する。
-void VMachine::execute(int max_clock) {
-  Thread& thread = *(threads.front().get());
+int VMachine::execute(int max_clock) {
+  // 仮想メモリはロックを持たないため、他のworkerが同じVMを実行していないことを確認する
+  VMemory::Owner owner(vmemory);
+  int clock = max_clock;
+  bool is_progressed = false;
+  size_t count = threads.size();
+  // 各スレッドを1度ずつ、クロック数を使い切るまで順番に実行する
+  for (; count > 0 && clock > 0 && is_running(status); count --) {
+    if (current_thread >= threads.size()) current_thread = 0;
+    Thread& thread = *threads.at(current_thread);
+    current_thread ++;
+
+    if (!thread.is_finished) {
+      bool was_waiting = thread.is_waiting;
+      int before = clock;
+      // 待ち状態のスレッドは待ちになったCALL命令からやり直す
+      thread.is_waiting = false;
+      execute_thread(thread, clock);
+      // やり直したCALL命令で再び待ちになった場合はクロックを消費しない
+      // それ以外の場合はスレッドが進み、他のスレッドの待ちを解いた可能性がある
+      if (!was_waiting || !thread.is_waiting || clock != before) {
+	is_progressed = true;
+      }
+    }
+    // 切り離されたスレッドはjoinを待たずに開放する
+    if (thread.is_finished && thread.is_detached) {
+      free_thread(thread);
+    }
+  }
+  // 全てのスレッドを一巡して進まなかった場合、非同期処理が完了するまで状態は変わらない
+  is_stalled = (count == 0 && !is_progressed);
+
+  return max_clock - clock;
+}
+
+// 1つのスレッドの命令を実行する。
+void VMachine::execute_thread(Thread& thread, int& max_clock) {
  re_entry: {
+    // 組み込み関数で待ち状態になった場合は他のスレッドに切り替える
+    if (thread.is_waiting) return;
+
     if (thread.stackinfos.size() == 1) {
+      // main関数以外のスレッドは開始関数から戻った時点で終了する
+      if (thread.tid != MAIN_THREAD_ID) {
+	thread.is_finished = true;
+	return;
+      }
       // calls_at_exitに関数が登録されている場合、順番に実行する
       if (!calls_at_exit.empty() && status != ERROR && status != FINISH) {
 	vaddr_t func_addr = calls_at_exit.top();
@@ -212,84 +347,501 @@ void VMachine::execute(int max_clock) {
     StackInfo& stackinfo = *(thread.stackinfos.back().get());
     resolve_stackinfo_cache(&thread, &stackinfo);
 
-    const FuncStore& func = *stackinfo.func_cache;
-    const std::vector<instruction_t>& insts = func.normal_prop.code;
+    FuncStore& func = *stackinfo.func_cache;
+    // warpで受け取った実行途中の関数は呼び出しを経ずに再開するので、ここで初回の確認をする
+    if (func.verify_status == FuncStore::VS_UNKNOWN && func.hotness == 0) {
+      count_hotness(func);
+    }
+    // 未検証の関数は命令ごとに検査しながら実行し、
+    // 呼び出しと後方への分岐の回数が閾値に達した時点で検証する
+    if (func.verify_status == FuncStore::VS_UNKNOWN &&
+	func.hotness >= TIER_UP_THRESHOLD) {
+      verify_function(func);
+      // 検査しながら実行していた時のハンドラのアドレスは使えないので作り直す
+      func.threaded_code.clear();
+    }
+
+    if (func.verify_status == FuncStore::VS_VERIFIED ?
+	execute_code<true>(thread, stackinfo, max_clock) :
+	execute_code<false>(thread, stackinfo, max_clock)) {
+      goto re_entry;
+    }
+  }
+}
+
+// 関数の命令列を実行する。
+template<bool VERIFIED> bool VMachine::execute_code(Thread& thread, StackInfo& stackinfo,
+						    int& max_clock) {
+  {
+    FuncStore& func = *stackinfo.func_cache;
+    // 実行用の命令列は初回実行時に作成し、以降は解決済みの命令を書き換えながら使う
+    if (func.quick_code.size() != func.normal_prop.code.size()) {
+      func.quick_code = func.normal_prop.code;
+    }
+    std::vector<instruction_t>& insts = func.quick_code;
     DataStore& k = vmemory.get_data(func.normal_prop.k);
-    OperandParam op_param = {*stackinfo.stack_cache, k, vmemory};
+    OperandParam op_param = {stackinfo.stack_cache, stackinfo.stack,
+			     func.normal_prop.stack_size, k, vmemory};
+
+    /**
+     * 型を特定した融合命令のオペランドを作るマクロ。
+     * Instruction::make_fused_operandと同じ値になる。
+     * @param ty 基本型の名前
+     * @param sub 演算の種類
+     */
+#define M_TYPED(ty, sub) ((BasicType::TY_##ty << 6) | (sub))
+
+    /**
+     * 実行中の命令から相対位置にある命令を取得するマクロ。
+     * 検証済みの関数では範囲の検査を省略する。
+     * @param n 実行中の命令からの相対位置
+     */
+#define M_INST(n) (VERIFIED ? insts[stackinfo.pc + (n)] : insts.at(stackinfo.pc + (n)))
+
+    /**
+     * 型を特定した命令を作るための基本型の一覧。
+     * M(基本型の名前, C++での型)
+     */
+#define M_INTEGER_TYPES(M)					\
+    M(UI8, uint8_t) M(UI16, uint16_t) M(UI32, uint32_t) M(UI64, uint64_t) \
+    M(SI8, int8_t)  M(SI16, int16_t)  M(SI32, int32_t)  M(SI64, int64_t)
+#define M_FLOAT_TYPES(M)			\
+    M(F32, float) M(F64, double)
+#define M_NUMERIC_TYPES(M)			\
+    M_INTEGER_TYPES(M) M_FLOAT_TYPES(M)
+
+#ifdef ENABLE_THREADED_DISPATCH
+    // オペコードごとのハンドラのアドレス
+    static const void* dispatch_table[0x40];
+    // 融合命令のオペランドが示す演算と型ごとのハンドラのアドレス
+    static const void* binary_op_table[0x1000];
+    static const void* test_op_table[0x1000];
+    static const void* cast_op_table[0x1000];
+    static const void* load_op_table[0x40];
+    static const void* store_op_table[0x40];
+
+    // ラベルのアドレスは他の関数(ラムダ式を含む)からは取れないため、
+    // 定数として初期化される一覧に置き、最初の呼び出しで一度だけ表に展開する
+    struct TableRange {
+      const void** table;
+      size_t size;
+      const void* label;
+    };
+    struct TableEntry {
+      const void** table;
+      instruction_t index;
+      const void* label;
+    };
+    // 表ごとの既定のハンドラ
+    static const TableRange table_ranges[] = {
+#define M_TABLE_RANGE(table, label)					\
+      { table, sizeof(table) / sizeof(table[0]), &&LABEL_##label },
+      M_TABLE_RANGE(dispatch_table, DEFAULT)
+      M_TABLE_RANGE(binary_op_table, BINARY_OP_DEFAULT)
+      M_TABLE_RANGE(test_op_table, TEST_OP_DEFAULT)
+      M_TABLE_RANGE(cast_op_table, CAST_OP_DEFAULT)
+      M_TABLE_RANGE(load_op_table, LOAD_OP_DEFAULT)
+      M_TABLE_RANGE(store_op_table, STORE_OP_DEFAULT)
+#undef M_TABLE_RANGE
+    };
+    // 表の要素ごとのハンドラ
+    static const TableEntry table_entries[] = {
+#define M_DISPATCH_TABLE(name) { dispatch_table, Opcode::name, &&LABEL_##name },
+      M_DISPATCH_TABLE(NOP)
+      M_DISPATCH_TABLE(CALL)
+      M_DISPATCH_TABLE(TAILCALL)
+      M_DISPATCH_TABLE(RETURN)
+      M_DISPATCH_TABLE(SET_TYPE)
+      M_DISPATCH_TABLE(SET_OUTPUT)
+      M_DISPATCH_TABLE(SET_VALUE)
+      M_DISPATCH_TABLE(SET_OV_PTR)
+      M_DISPATCH_TABLE(ADD)
+      M_DISPATCH_TABLE(SUB)
+      M_DISPATCH_TABLE(MUL)
+      M_DISPATCH_TABLE(DIV)
+      M_DISPATCH_TABLE(REM)
+      M_DISPATCH_TABLE(SHL)
+      M_DISPATCH_TABLE(SHR)
+      M_DISPATCH_TABLE(AND)
+      M_DISPATCH_TABLE(OR)
+      M_DISPATCH_TABLE(XOR)
+      M_DISPATCH_TABLE(SET)
+      M_DISPATCH_TABLE(SET_PTR)
+      M_DISPATCH_TABLE(SET_ADR)
+      M_DISPATCH_TABLE(SET_ALIGN)
+      M_DISPATCH_TABLE(ADD_ADR)
+      M_DISPATCH_TABLE(MUL_ADR)
+      M_DISPATCH_TABLE(GET_ADR)
+      M_DISPATCH_TABLE(LOAD)
+      M_DISPATCH_TABLE(STORE)
+      M_DISPATCH_TABLE(CMPXCHG)
+      M_DISPATCH_TABLE(ALLOCA)
+      M_DISPATCH_TABLE(TEST)
+      M_DISPATCH_TABLE(TEST_EQ)
+      M_DISPATCH_TABLE(JUMP)
+      M_DISPATCH_TABLE(INDIRECT_JUMP)
+      M_DISPATCH_TABLE(PHI)
+      M_DISPATCH_TABLE(TYPE_CAST)
+      M_DISPATCH_TABLE(BIT_CAST)
+      M_DISPATCH_TABLE(EQUAL)
+      M_DISPATCH_TABLE(NOT_EQUAL)
+      M_DISPATCH_TABLE(GREATER)
+      M_DISPATCH_TABLE(GREATER_EQUAL)
+      M_DISPATCH_TABLE(NOT_NANS)
+      M_DISPATCH_TABLE(OR_NANS)
+      M_DISPATCH_TABLE(SELECT)
+      M_DISPATCH_TABLE(SHUFFLE)
+      M_DISPATCH_TABLE(BINARY_OP)
+      M_DISPATCH_TABLE(TEST_OP)
+      M_DISPATCH_TABLE(CAST_OP)
+      M_DISPATCH_TABLE(LOAD_OP)
+      M_DISPATCH_TABLE(STORE_OP)
+      M_DISPATCH_TABLE(PHI_MOVE)
+      M_DISPATCH_TABLE(SWITCH_TABLE)
+      M_DISPATCH_TABLE(SWITCH_SEARCH)
+      M_DISPATCH_TABLE(GET_ELEMENT_PTR)
+      M_DISPATCH_TABLE(QUICK_CALL)
+      M_DISPATCH_TABLE(QUICK_SET_TYPE)
+      M_DISPATCH_TABLE(QUICK_CALL_INDIRECT)
+      M_DISPATCH_TABLE(QUICK_TAILCALL)
+      M_DISPATCH_TABLE(QUICK_TAILCALL_INDIRECT)
+
+#define M_SUBDISPATCH_TABLE(table, label, value) { table, value, &&LABEL_##label },
+      // 型を特定しない融合命令
+      M_SUBDISPATCH_TABLE(binary_op_table, BINARY_OP_ADD, Opcode::ADD)
+      M_SUBDISPATCH_TABLE(binary_op_table, BINARY_OP_SUB, Opcode::SUB)
+      M_SUBDISPATCH_TABLE(binary_op_table, BINARY_OP_MUL, Opcode::MUL)
+      M_SUBDISPATCH_TABLE(binary_op_table, BINARY_OP_DIV, Opcode::DIV)
+      M_SUBDISPATCH_TABLE(binary_op_table, BINARY_OP_REM, Opcode::REM)
+      M_SUBDISPATCH_TABLE(binary_op_table, BINARY_OP_SHL, Opcode::SHL)
+      M_SUBDISPATCH_TABLE(binary_op_table, BINARY_OP_SHR, Opcode::SHR)
+      M_SUBDISPATCH_TABLE(binary_op_table, BINARY_OP_AND, Opcode::AND)
+      M_SUBDISPATCH_TABLE(binary_op_table, BINARY_OP_OR,  Opcode::OR)
+      M_SUBDISPATCH_TABLE(binary_op_table, BINARY_OP_XOR, Opcode::XOR)
+      M_SUBDISPATCH_TABLE(binary_op_table, BINARY_OP_EQUAL,         Opcode::EQUAL)
+      M_SUBDISPATCH_TABLE(binary_op_table, BINARY_OP_NOT_EQUAL,     Opcode::NOT_EQUAL)
+      M_SUBDISPATCH_TABLE(binary_op_table, BINARY_OP_GREATER,       Opcode::GREATER)
+      M_SUBDISPATCH_TABLE(binary_op_table, BINARY_OP_GREATER_EQUAL, Opcode::GREATER_EQUAL)
+      M_SUBDISPATCH_TABLE(binary_op_table, BINARY_OP_NOT_NANS,      Opcode::NOT_NANS)
+      M_SUBDISPATCH_TABLE(test_op_table, TEST_OP_EQUAL,         Opcode::EQUAL)
+      M_SUBDISPATCH_TABLE(test_op_table, TEST_OP_NOT_EQUAL,     Opcode::NOT_EQUAL)
+      M_SUBDISPATCH_TABLE(test_op_table, TEST_OP_GREATER,       Opcode::GREATER)
+      M_SUBDISPATCH_TABLE(test_op_table, TEST_OP_GREATER_EQUAL, Opcode::GREATER_EQUAL)
+      M_SUBDISPATCH_TABLE(test_op_table, TEST_OP_NOT_NANS,      Opcode::NOT_NANS)
+
+      // 型を特定した融合命令
+#define M_TYPED_BINARY_TABLE(ty, name)					\
+      M_SUBDISPATCH_TABLE(binary_op_table, BINARY_OP_##name##_##ty, M_TYPED(ty, Opcode::name))
+#define M_TYPED_TEST_TABLE(ty, name)					\
+      M_SUBDISPATCH_TABLE(test_op_table, TEST_OP_##name##_##ty, M_TYPED(ty, Opcode::name))
+#define M_TYPED_COMPARE_TABLE(ty, T)					\
+      M_TYPED_BINARY_TABLE(ty, EQUAL) M_TYPED_BINARY_TABLE(ty, NOT_EQUAL) \
+      M_TYPED_BINARY_TABLE(ty, GREATER) M_TYPED_BINARY_TABLE(ty, GREATER_EQUAL) \
+      M_TYPED_TEST_TABLE(ty, EQUAL) M_TYPED_TEST_TABLE(ty, NOT_EQUAL)	\
+      M_TYPED_TEST_TABLE(ty, GREATER) M_TYPED_TEST_TABLE(ty, GREATER_EQUAL)
+#define M_TYPED_INTEGER_TABLE(ty, T)					\
+      M_TYPED_COMPARE_TABLE(ty, T)					\
+      M_TYPED_BINARY_TABLE(ty, ADD) M_TYPED_BINARY_TABLE(ty, SUB)	\
+      M_TYPED_BINARY_TABLE(ty, MUL) M_TYPED_BINARY_TABLE(ty, DIV)	\
+      M_TYPED_BINARY_TABLE(ty, REM) M_TYPED_BINARY_TABLE(ty, SHL)	\
+      M_TYPED_BINARY_TABLE(ty, SHR) M_TYPED_BINARY_TABLE(ty, AND)	\
+      M_TYPED_BINARY_TABLE(ty, OR)  M_TYPED_BINARY_TABLE(ty, XOR)
+#define M_TYPED_FLOAT_TABLE(ty, T)					\
+      M_TYPED_COMPARE_TABLE(ty, T)					\
+      M_TYPED_BINARY_TABLE(ty, ADD) M_TYPED_BINARY_TABLE(ty, SUB)	\
+      M_TYPED_BINARY_TABLE(ty, MUL) M_TYPED_BINARY_TABLE(ty, DIV)	\
+      M_TYPED_BINARY_TABLE(ty, REM) M_TYPED_BINARY_TABLE(ty, NOT_NANS)	\
+      M_TYPED_TEST_TABLE(ty, NOT_NANS)
+#define M_TYPED_CAST_TABLE(src, dst)					\
+      M_SUBDISPATCH_TABLE(cast_op_table, CAST_OP_##src##_##dst, M_TYPED(src, BasicType::TY_##dst))
+#define M_TYPED_CAST_FROM_TABLE(ty, T)					\
+      M_TYPED_CAST_TABLE(ty, UI8) M_TYPED_CAST_TABLE(ty, UI16)		\
+      M_TYPED_CAST_TABLE(ty, UI32) M_TYPED_CAST_TABLE(ty, UI64)		\
+      M_TYPED_CAST_TABLE(ty, SI8) M_TYPED_CAST_TABLE(ty, SI16)		\
+      M_TYPED_CAST_TABLE(ty, SI32) M_TYPED_CAST_TABLE(ty, SI64)		\
+      M_TYPED_CAST_TABLE(ty, F32) M_TYPED_CAST_TABLE(ty, F64)
+#define M_TYPED_MEMORY_TABLE(ty, T)					\
+      M_SUBDISPATCH_TABLE(load_op_table, LOAD_OP_##ty, BasicType::TY_##ty) \
+      M_SUBDISPATCH_TABLE(store_op_table, STORE_OP_##ty, BasicType::TY_##ty)
+
+      M_INTEGER_TYPES(M_TYPED_INTEGER_TABLE)
+      M_FLOAT_TYPES(M_TYPED_FLOAT_TABLE)
+      M_TYPED_COMPARE_TABLE(POINTER, vaddr_t)
+      M_NUMERIC_TYPES(M_TYPED_CAST_FROM_TABLE)
+      M_NUMERIC_TYPES(M_TYPED_MEMORY_TABLE)
+      M_TYPED_MEMORY_TABLE(POINTER, vaddr_t)
+#undef M_TYPED_BINARY_TABLE
+#undef M_TYPED_TEST_TABLE
+#undef M_TYPED_COMPARE_TABLE
+#undef M_TYPED_INTEGER_TABLE
+#undef M_TYPED_FLOAT_TABLE
+#undef M_TYPED_CAST_TABLE
+#undef M_TYPED_CAST_FROM_TABLE
+#undef M_TYPED_MEMORY_TABLE
+#undef M_SUBDISPATCH_TABLE
+#undef M_DISPATCH_TABLE
+    };
+    static std::once_flag table_flag;
+    std::call_once(table_flag, [] {
+	for (auto& range : table_ranges) {
+	  std::fill(range.table, range.table + range.size, range.label);
+	}
+	for (auto& entry : table_entries) {
+	  entry.table[entry.index] = entry.label;
+	}
+      });
+
+    // 関数の命令列をハンドラのアドレス列に事前に変換しておく
+    // 末尾には命令列の範囲外に出た場合のための番兵を置く
+    if (func.threaded_code.size() != insts.size() + 1) {
+      func.threaded_code.resize(insts.size() + 1);
+      for (unsigned int pc = 0; pc < insts.size(); pc ++) {
+	instruction_t operand = Instruction::get_operand(insts[pc]);
+	// 融合命令はオペランドが示す演算と型のハンドラに直接変換する
+#define M_SUBTABLE(table)						\
+	(operand < sizeof(table) / sizeof(table[0]) ? table[operand] : &&LABEL_DEFAULT)
+	switch (Instruction::get_opcode(insts[pc])) {
+	case Opcode::BINARY_OP: func.threaded_code[pc] = M_SUBTABLE(binary_op_table); break;
+	case Opcode::TEST_OP:   func.threaded_code[pc] = M_SUBTABLE(test_op_table);   break;
+	case Opcode::CAST_OP:   func.threaded_code[pc] = M_SUBTABLE(cast_op_table);   break;
+	case Opcode::LOAD_OP:   func.threaded_code[pc] = M_SUBTABLE(load_op_table);   break;
+	case Opcode::STORE_OP:  func.threaded_code[pc] = M_SUBTABLE(store_op_table);  break;
+	default: func.threaded_code[pc] = dispatch_table[Instruction::get_opcode(insts[pc])]; break;
+	}
+#undef M_SUBTABLE
+      }
+      func.threaded_code.back() = &&LABEL_DEFAULT;
+    }
+    const void* const* handlers = func.threaded_code.data();
+    instruction_t code;
+
+    /**
+     * 命令ディスパッチ用のマクロ。
+     * M_CASE 命令に対応する処理の開始位置
+     * M_SUBSWITCH 融合命令のオペランドが示す演算と型に対応する処理に進む
+     * M_SUBCASE 融合命令の演算と型に対応する処理の開始位置
+     * M_NEXT 次の命令に進む
+     * M_JUMP pcを書き換えた後、その位置の命令に進む
+     * M_BRANCH 分岐命令でpcを書き換えた後、その位置の命令に進む
+     */
+#define M_CASE(name) LABEL_##name
+#define M_CASE_DEFAULT LABEL_DEFAULT
+#define M_SUBSWITCH(table) {						\
+      instruction_t sub = Instruction::get_operand(code);		\
+      goto *(sub < sizeof(table) / sizeof(table[0]) ? table[sub] : &&LABEL_DEFAULT); \
+    }
+#define M_SUBCASE(label, value) LABEL_##label
+#define M_SUBCASE_DEFAULT(name) LABEL_##name##_DEFAULT
+#define M_DISPATCH() {							\
+      code = M_INST(0);							\
+      print_debug("pc:%d, k:%ld, insts:%ld, code:%08x %s\n",		\
+		  stackinfo.pc, k.size / sizeof(vaddr_t),		\
+		  insts.size(), code, Util::code2str(code).c_str());	\
+      goto *handlers[stackinfo.pc];					\
+    }
+#define M_JUMP() {				\
+      if (-- max_clock <= 0) return false;		\
+      M_DISPATCH();				\
+    }
+#define M_QUICKEN(name, index) {					\
+      insts[stackinfo.pc] = Instruction::make_instruction(Opcode::name, (index)); \
+      func.threaded_code[stackinfo.pc] = &&LABEL_##name;		\
+    }
+#define M_NEXT() {				\
+      stackinfo.pc ++;				\
+      M_JUMP();					\
+    }
+
+    /**
+     * 未検証の関数で後方への分岐を数え、閾値に達した場合は検証してから
+     * 実行し直すためにre_entryに戻る。分岐先のpcは設定済み。
+     */
+#define M_BRANCH() {							\
+      if (!VERIFIED && stackinfo.phi1 <= stackinfo.phi0 &&		\
+	  func.verify_status == FuncStore::VS_UNKNOWN &&		\
+	  ++ func.hotness >= TIER_UP_THRESHOLD) {			\
+	return true;							\
+      }									\
+      M_JUMP();								\
+    }
 
-    for (; (status == ACTIVE || status == EXITING || status == WAIT_WARP ||
-	    status == BEFOR_WARP || status == AFTER_WARP) &&
-	   max_clock > 0; max_clock --) {
-      instruction_t code = insts.at(stackinfo.pc);
+    // 実行状態はre_entryと組み込み関数、外部の関数の呼び出し後にだけ確認する
+    if (!is_running(status) || max_clock <= 0) return false;
+    M_DISPATCH();
+
+    {
+#else // ENABLE_THREADED_DISPATCH
+#define M_CASE(name) case Opcode::name
+#define M_CASE_DEFAULT default
+#define M_SUBSWITCH(table) switch (Instruction::get_operand(code))
+#define M_SUBCASE(label, value) case (value)
+#define M_SUBCASE_DEFAULT(name) default
+#define M_JUMP() continue
+#define M_NEXT() break
+
+    /**
+     * 未検証の関数で後方への分岐を数え、閾値に達した場合は検証してから
+     * 実行し直すためにre_entryに戻る。分岐先のpcは設定済み。
+     */
+#define M_BRANCH() {							\
+      if (!VERIFIED && stackinfo.phi1 <= stackinfo.phi0 &&		\
+	  func.verify_status == FuncStore::VS_UNKNOWN &&		\
+	  ++ func.hotness >= TIER_UP_THRESHOLD) {			\
+	return true;							\
+      }									\
+      M_JUMP();								\
+    }
+#define M_QUICKEN(name, index) {					\
+      insts[stackinfo.pc] = Instruction::make_instruction(Opcode::name, (index)); \
+    }
+
+    for (; is_running(status) && max_clock > 0; max_clock --) {
+      instruction_t code = M_INST(0);
       print_debug("pc:%d, k:%ld, insts:%ld, code:%08x %s\n",
 		  stackinfo.pc, k.size / sizeof(vaddr_t),
 		  insts.size(), code, Util::code2str(code).c_str());
 
-      // call命令の判定(call命令の場合falseに変える)
-      bool is_tailcall = true;
-
       switch (static_cast<uint8_t>(Instruction::get_opcode(code))) {
+#endif // ENABLE_THREADED_DISPATCH
 
 #define M_BINARY_OPERATOR(name, op)				\
-	case Opcode::name: {					\
-	  OperandRet operand = get_operand(code, op_param);	\
+	M_CASE(name): {						\
+	  OperandRet operand = get_operand<VERIFIED>(code, op_param);	\
 	  stackinfo.type_cache1->op(stackinfo.output_cache,	\
 				    stackinfo.value_cache,	\
 				    operand.cache);		\
-	} break;
+	} M_NEXT();
 
-      case Opcode::NOP: {
+      M_CASE(NOP): {
 	// 何もしない命令
-      } break;
-	
-      case Opcode::CALL:
-	is_tailcall = false;
+      } M_NEXT();
 	
-      case Opcode::TAILCALL: {
-	std::unique_ptr<StackInfo> new_stackinfo;
-	FuncStore& new_func = get_function(code, op_param);
+      M_CASE(CALL):
+      M_CASE(TAILCALL):
+      M_CASE(QUICK_CALL):
+      M_CASE(QUICK_CALL_INDIRECT):
+      M_CASE(QUICK_TAILCALL):
+      M_CASE(QUICK_TAILCALL_INDIRECT): {
+	// call命令の判定
+	instruction_t opcode = Instruction::get_opcode(code);
+	bool is_tailcall = (opcode == Opcode::TAILCALL ||
+			    opcode == Opcode::QUICK_TAILCALL ||
+			    opcode == Opcode::QUICK_TAILCALL_INDIRECT);
+	FuncStore* new_func_ptr;
+	if (opcode == Opcode::QUICK_CALL || opcode == Opcode::QUICK_TAILCALL) {
+	  instruction_t index = Instruction::get_operand(code);
+	  if (!VERIFIED && index >= func.quick_funcs.size()) {
+	    throw_error(Error::INST_VIOLATION);
+	  }
+	  new_func_ptr = func.quick_funcs[index];
 
-	assert(!is_tailcall); // TODO 動きを確認する。
+	} else if (opcode == Opcode::QUICK_CALL_INDIRECT ||
+		   opcode == Opcode::QUICK_TAILCALL_INDIRECT) {
+	  instruction_t index = Instruction::get_operand(code);
+	  if (!VERIFIED && index >= func.quick_call_caches.size()) {
+	    throw_error(Error::INST_VIOLATION);
+	  }
+	  // 書き換え前の命令で範囲を確認済みのオペランドから呼び出し先のアドレスを読む
+	  FuncStore::CallCache& cache = func.quick_call_caches[index];
+	  vaddr_t addr = *reinterpret_cast<vaddr_t*>(op_param.stack + cache.operand);
+	  new_func_ptr = get_cached_function(cache, addr, vmemory);
 
-	int normal_pc = Instruction::get_operand(insts.at(stackinfo.pc + 1));
-	int unwind_pc = Instruction::get_operand(insts.at(stackinfo.pc + 2));
+	} else {
+	  new_func_ptr = &get_function<VERIFIED>(code, op_param);
+	  instruction_t operand = Instruction::get_operand(code);
+	  // 末尾呼び出しは末尾呼び出しのまま書き換える
+	  if ((operand & HEAD_OPERAND) != 0) {
+	    // 定数で指定された呼び出し先は変わらないので、解決済みの関数を参照する命令に書き換える
+	    if (func.quick_funcs.size() < HEAD_OPERAND) {
+	      if (is_tailcall) {
+		M_QUICKEN(QUICK_TAILCALL, func.quick_funcs.size());
+	      } else {
+		M_QUICKEN(QUICK_CALL, func.quick_funcs.size());
+	      }
+	      func.quick_funcs.push_back(new_func_ptr);
+	    }
+
+	  } else if (func.quick_call_caches.size() < HEAD_OPERAND) {
+	    // 関数ポインタ経由の呼び出しは呼び出し先をインラインキャッシュに記録する命令に書き換える
+	    FuncStore::CallCache cache;
+	    cache.operand  = operand;
+	    cache.count    = 1;
+	    cache.addrs[0] = new_func_ptr->addr;
+	    cache.funcs[0] = new_func_ptr;
+	    if (is_tailcall) {
+	      M_QUICKEN(QUICK_TAILCALL_INDIRECT, func.quick_call_caches.size());
+	    } else {
+	      M_QUICKEN(QUICK_CALL_INDIRECT, func.quick_call_caches.size());
+	    }
+	    func.quick_call_caches.push_back(cache);
+	  }
+	}
+	FuncStore& new_func = *new_func_ptr;
+	// 通常の関数の末尾呼び出しは呼び出し元のStackInfoを呼び出し先のもので置き換える
+	// それ以外の関数の場合はCALLと同じく呼び出し、続くRETURNで戻り値を返す
+	bool is_replace = is_tailcall && new_func.type == FuncType::FC_NORMAL;
+
+	int normal_pc = Instruction::get_operand(M_INST(1));
+	int unwind_pc = Instruction::get_operand(M_INST(2));
+	// 戻り値の格納先を設定する
+	instruction_t output_inst = M_INST(3);
+	if (Instruction::get_operand(output_inst) == FILL_OPERAND) {
+	  stackinfo.output       = VADDR_NON;
+	  stackinfo.output_cache = nullptr;
+	} else {
+	  OperandRet output = get_operand<VERIFIED>(output_inst, op_param);
+	  stackinfo.output       = output.addr;
+	  stackinfo.output_cache = output.cache;
+	}
 	// CALL命令の次の命令の場所を取得する
 	int next_pc = 1;
 	while(stackinfo.pc + next_pc < insts.size() &&
-	      Instruction::get_opcode(insts.at(stackinfo.pc + next_pc)) == Opcode::EXTRA)
+	      Instruction::get_opcode(M_INST(next_pc)) == Opcode::EXTRA)
 	  next_pc ++;
 	
-	// スタックのサイズの有無により作りを変える
-	new_stackinfo.reset
-	  (new StackInfo(new_func.addr,
-			 // tailcallの場合、戻り値の格納先を現行のものから引き継ぐ
-			 is_tailcall ? stackinfo.ret_addr : stackinfo.output,
-			 (normal_pc != FILL_OPERAND ? normal_pc : stackinfo.pc + next_pc),
-			 (unwind_pc != FILL_OPERAND ? unwind_pc : stackinfo.pc + next_pc),
-			 (new_func.normal_prop.stack_size != 0 ?
-			  vmemory.alloc_data(new_func.normal_prop.stack_size, false).addr :
-			  VADDR_NON)));
-	resolve_stackinfo_cache(&thread, new_stackinfo.get());
+	// 通常の関数の場合、呼び出し先のStackInfoを作成する
+	// 置き換える場合は呼び出し元の領域を開放した後に作成する
+	std::unique_ptr<StackInfo> new_stackinfo;
+	if (new_func.type == FuncType::FC_NORMAL && !is_replace) {
+	  new_stackinfo = create_stackinfo
+	    (thread, new_func, stackinfo.output,
+	     (normal_pc != FILL_OPERAND ? normal_pc : stackinfo.pc + next_pc),
+	     (unwind_pc != FILL_OPERAND ? unwind_pc : stackinfo.pc + next_pc));
+	}
 
 	// 引数を集める
 	unsigned int args = 0;
 	int written_size = 0;
 	instruction_t type_inst;
 	instruction_t value_inst;
-	std::vector<uint8_t> work; // 可変長引数、ネイティブメソッド用引数を一時的に格納する領域
-	while (stackinfo.pc + 4 + args * 2 < insts.size() &&
-	       Instruction::get_opcode(type_inst  = insts.at(stackinfo.pc + 3 + args * 2))
+	// 可変長引数、ネイティブメソッド用引数を一時的に格納する領域
+	std::vector<uint8_t>& work = thread.call_work;
+	work.clear();
+	// 置き換える場合の通常の引数を一時的に格納する領域
+	std::vector<uint8_t>& tailcall_work = thread.tailcall_work;
+	tailcall_work.clear();
+	while (stackinfo.pc + 5 + args * 2 < insts.size() &&
+	       Instruction::get_opcode(type_inst  = M_INST(4 + args * 2))
 	       == Opcode::EXTRA &&
-	       Instruction::get_opcode(value_inst = insts.at(stackinfo.pc + 4 + args * 2))
+	       Instruction::get_opcode(value_inst = M_INST(5 + args * 2))
 	       == Opcode::EXTRA) {
 
-	  const TypeStore& type  = get_type(type_inst, op_param);
-	  OperandRet value = get_operand(value_inst, op_param);
+	  const TypeStore& type  = get_type<VERIFIED>(type_inst, op_param);
+	  OperandRet value = get_operand<VERIFIED>(value_inst, op_param);
 
 	  if (new_func.type == FuncType::FC_NORMAL &&
 	      args < new_func.arg_num) {
 	    // 通常の引数はスタックの先頭にコピー
-	    memcpy(new_stackinfo->stack_cache->head.get() + written_size, value.cache, type.size);
+	    // 呼び出し先は実行時に決まるため、検証済みの関数でもスタックに収まるかを確認する
+	    if (written_size + type.size > new_func.normal_prop.stack_size) {
+	      throw_error(Error::INST_VIOLATION);
+	    }
+	    if (is_replace) {
+	      tailcall_work.resize(written_size + type.size);
+	      memcpy(tailcall_work.data() + written_size, value.cache, type.size);
+	    } else {
+	      memcpy(new_stackinfo->stack_cache + written_size, value.cache, type.size);
+	    }
 	    written_size += type.size;
 
 	  } else {
@@ -304,7 +856,7 @@ void VMachine::execute(int max_clock) {
 	}
 
 	// pcの書き換え
-	stackinfo.pc += args * 2 + 2;
+	stackinfo.pc += args * 2 + 3;
 	print_debug("call %s\n", new_func.name.str().c_str());
 	if (new_func.type == FuncType::FC_NORMAL) {
 	  // 可変長引数でない場合、引数の数をチェック
@@ -312,6 +864,24 @@ void VMachine::execute(int max_clock) {
 	      (!new_func.is_var_arg && args != new_func.arg_num))
 	    throw_error(Error::TYPE_VIOLATION);
 
+	  if (is_replace) {
+	    // 呼び出し元のスタック領域、allocaで確保した領域を開放し、同じ位置に呼び出し先の
+	    // StackInfoを作成する。戻り値の格納先と戻り先は呼び出し元のものを引き継ぐ
+	    vaddr_t ret_addr = stackinfo.ret_addr;
+	    unsigned int upper_normal_pc = stackinfo.normal_pc;
+	    unsigned int upper_unwind_pc = stackinfo.unwind_pc;
+	    free_stackinfo(thread, std::move(thread.stackinfos.back()));
+	    thread.stackinfos.pop_back();
+	    new_stackinfo = create_stackinfo(thread, new_func, ret_addr,
+					     upper_normal_pc, upper_unwind_pc);
+	    if (written_size != 0) {
+	      memcpy(new_stackinfo->stack_cache, tailcall_work.data(), written_size);
+	    }
+
+	  } else {
+	    stackinfo.pc ++;
+	  }
+
 	  // 可変長引数分がある場合、別領域を作成
 	  if (work.size() != 0) {
 	    new_stackinfo->var_arg = v_malloc(work.size(), false);
@@ -320,25 +890,18 @@ void VMachine::execute(int max_clock) {
 	  } else {
 	    new_stackinfo->var_arg = VADDR_NON;
 	  }
-	  
-	  if (is_tailcall) {
-	    // 末尾再帰の場合、既存のstackinfoを削除
-	    // 次の命令はRETURNのはず
-	    assert(Instruction::get_opcode(insts.at(stackinfo.pc + 2)) == Opcode::RETURN);
-	    thread.stackinfos.pop_back();
-	  } else {
-	    stackinfo.pc ++;
-	    // TODO assert(false);
-	    // 末尾再帰でない場合、callinfosを追加
-	  }
-	  thread.stackinfos.push_back(std::unique_ptr<StackInfo>(new_stackinfo.release()));
-	  goto re_entry;
+	  thread.stackinfos.push_back(std::move(new_stackinfo));
+	  return true;
 	  
 	} else if (new_func.type == FuncType::FC_BUILTIN) {
 	  // VM組み込み関数の呼び出し
 	  assert(new_func.builtin != nullptr);
 	  if (new_func.builtin(*this, thread, new_func.builtin_param, stackinfo.output, work)) {
-	    goto re_entry;
+	    // 待ち状態になった場合、次に実行する時はCALL命令からやり直す
+	    if (thread.is_waiting) {
+	      stackinfo.pc -= args * 2 + 3;
+	    }
+	    return true;
 	  }
 
 	} else { // func.type == FuncType::EXTERNAL
@@ -349,68 +912,92 @@ void VMachine::execute(int max_clock) {
 	  // 関数の呼び出し
 	  call_external(new_func, stackinfo.output_cache, work);
 	}
-	
-      } break;
 
-      case Opcode::RETURN: {
+#ifdef ENABLE_THREADED_DISPATCH
+	// 呼び出し先で実行状態が変更された場合は実行を中断する
+	if (!is_running(status)) {
+	  stackinfo.pc ++;
+	  return false;
+	}
+#endif
+      } M_NEXT();
+
+      M_CASE(RETURN): {
 	StackInfo& upperinfo = *(thread.stackinfos.at(thread.stackinfos.size() - 2).get());
 	resolve_stackinfo_cache(&thread, &upperinfo);
 
-	if (Instruction::get_operand(code) == FILL_OPERAND) {
-	  // 戻り値がないので何もしない
+	if (Instruction::get_operand(code) == FILL_OPERAND ||
+	    upperinfo.output_cache == nullptr) {
+	  // 戻り値がない、または呼び出し元で戻り値を使わないので何もしない
 
 	} else {
-	  // 戻り値を設定する
-	  OperandRet operand = get_operand(code, op_param);
-	  
-	  stackinfo.type_cache1->copy(upperinfo.output_cache, operand.cache);
-	}
-	// スタック領域を開放
-	vmemory.free(stackinfo.stack);
-
-	// alloca領域を開放
-	for (vaddr_t addr : stackinfo.alloca_addrs) {
-	  vmemory.free(addr);
+	  // 戻り値を続くEXTRAのサイズ分設定する
+	  OperandRet operand = get_operand<VERIFIED>(code, op_param);
+	  size_t size = Instruction::get_operand(M_INST(1));
+	  // 格納先は呼び出し元のスタックにあり、呼び出し元では戻り値のサイズが分からないためここで確認する
+	  // スレッドの最下段は関数を持たず、戻り値を受け取る領域をスタックとしている
+	  size_t upper_size = (upperinfo.func_cache != nullptr ?
+			       upperinfo.func_cache->normal_prop.stack_size :
+			       vmemory.get_data(upperinfo.stack).size);
+	  if (upperinfo.output_cache < upperinfo.stack_cache ||
+	      upperinfo.output_cache + size > upperinfo.stack_cache + upper_size) {
+	    throw_error(Error::INST_VIOLATION);
+	  }
+	  switch (size) {
+	  case 1: *upperinfo.output_cache = *operand.cache; break;
+	  case 4: memcpy(upperinfo.output_cache, operand.cache, 4); break;
+	  case 8: memcpy(upperinfo.output_cache, operand.cache, 8); break;
+	  default: memcpy(upperinfo.output_cache, operand.cache, size); break;
+	  }
 	}
-	
 	// 1段上のスタックのpcを設定(normal_pc)
 	upperinfo.pc = stackinfo.normal_pc;
 
 	// stackinfoを1つ除去してre_entryに移動
+	// スタック領域はスタックポインタを戻して開放し、StackInfoは次の関数呼び出しで再利用する
+	free_stackinfo(thread, std::move(thread.stackinfos.back()));
 	thread.stackinfos.pop_back();
-	goto re_entry;
-      } break;
+	return true;
+      } M_NEXT();
 
-      case Opcode::SET_TYPE: {
-	TypeStore& store = get_type(code, op_param);
+      M_CASE(SET_TYPE): {
+	TypeStore& store = get_type<VERIFIED>(code, op_param);
 	stackinfo.type = store.addr;
-	if (store.addr < sizeof(TYPE_BASES) / sizeof(TYPE_BASES[0])) {
-	  stackinfo.type_cache1 = TYPE_BASES[store.addr];
-	  if (stackinfo.type_cache1 == nullptr) {
-	    assert(false); // TODO 未対応の型
-	  }
+	stackinfo.type_cache1 = get_type_cache(store, thread.type_complex);
+	stackinfo.type_cache2 = &store;
+	print_debug("set_type = %016" PRIx64 "\n", stackinfo.type);
+	// 型は定数領域にあり変わらないので、解決済みの型を参照する命令に書き換える
+	if (func.quick_types.size() < HEAD_OPERAND) {
+	  M_QUICKEN(QUICK_SET_TYPE, func.quick_types.size());
+	  func.quick_types.push_back(&store);
+	}
+      } M_NEXT();
 
-	} else {
-	  stackinfo.type_cache1 = &thread.type_complex;
-	  thread.type_complex.type_store = &store;
+      M_CASE(QUICK_SET_TYPE): {
+	instruction_t index = Instruction::get_operand(code);
+	if (!VERIFIED && index >= func.quick_types.size()) {
+	  throw_error(Error::INST_VIOLATION);
 	}
+	TypeStore& store = *func.quick_types[index];
+	stackinfo.type = store.addr;
+	stackinfo.type_cache1 = get_type_cache(store, thread.type_complex);
 	stackinfo.type_cache2 = &store;
 	print_debug("set_type = %016" PRIx64 "\n", stackinfo.type);
-      } break;
+      } M_NEXT();
 
-      case Opcode::SET_OUTPUT: {
-	OperandRet operand = get_operand(code, op_param);
+      M_CASE(SET_OUTPUT): {
+	OperandRet operand = get_operand<VERIFIED>(code, op_param);
 	stackinfo.output       = operand.addr;
 	stackinfo.output_cache = operand.cache;
 	print_debug("output = %016" PRIx64 "(%p)\n", stackinfo.output, stackinfo.output_cache);
-      } break;
+      } M_NEXT();
 
-      case Opcode::SET_VALUE: {
-	OperandRet operand = get_operand(code, op_param);
+      M_CASE(SET_VALUE): {
+	OperandRet operand = get_operand<VERIFIED>(code, op_param);
 	stackinfo.value       = operand.addr;
 	stackinfo.value_cache = operand.cache;
 	print_debug("value = %016" PRIx64 "(%p)\n", stackinfo.value, stackinfo.value_cache);
-      } break;
+      } M_NEXT();
 
 	M_BINARY_OPERATOR(ADD, op_add); // 加算
 	M_BINARY_OPERATOR(SUB, op_sub); // 減算
@@ -423,8 +1010,8 @@ void VMachine::execute(int max_clock) {
 	M_BINARY_OPERATOR(OR,  op_or);  // or
 	M_BINARY_OPERATOR(XOR, op_xor); // xor
 
-      case SET_OV_PTR: {
-	OperandRet operand = get_operand(code, op_param);
+      M_CASE(SET_OV_PTR): {
+	OperandRet operand = get_operand<VERIFIED>(code, op_param);
 	stackinfo.value        = *reinterpret_cast<vaddr_t*>(operand.cache);
 	stackinfo.value_cache  = get_cache(stackinfo.value, vmemory);
 	stackinfo.type_cache1->copy(stackinfo.output_cache, stackinfo.value_cache);
@@ -432,69 +1019,95 @@ void VMachine::execute(int max_clock) {
 	stackinfo.output_cache = stackinfo.value_cache;
 	print_debug("output = %016" PRIx64 "\n", stackinfo.output);
 	print_debug("value = %016" PRIx64 "\n", stackinfo.value);
-      } break;
+      } M_NEXT();
 
-      case Opcode::SET: {
-	OperandRet operand = get_operand(code, op_param);
+      M_CASE(SET): {
+	OperandRet operand = get_operand<VERIFIED>(code, op_param);
 	memcpy(stackinfo.output_cache, operand.cache, stackinfo.type_cache2->size);
-      } break;
+      } M_NEXT();
 
-      case Opcode::SET_PTR: {
-	OperandRet operand = get_operand(code, op_param);
+      M_CASE(SET_PTR): {
+	OperandRet operand = get_operand<VERIFIED>(code, op_param);
 	stackinfo.address = *reinterpret_cast<vaddr_t*>(operand.cache);
 	stackinfo.address_cache = get_cache(stackinfo.address, vmemory);
 	print_debug("address = %016" PRIx64 "(%p)\n", stackinfo.address, stackinfo.address_cache);
-      } break;
+      } M_NEXT();
 
-      case Opcode::SET_ADR: {
-	OperandRet operand = get_operand(code, op_param);
+      M_CASE(SET_ADR): {
+	OperandRet operand = get_operand<VERIFIED>(code, op_param);
 	stackinfo.address = operand.addr;
 	stackinfo.address_cache = operand.cache;
 	print_debug("address = %016" PRIx64 "(%p)\n", stackinfo.address, stackinfo.address_cache);
-      } break;
+      } M_NEXT();
 
-      case Opcode::SET_ALIGN: {
+      M_CASE(SET_ALIGN): {
 	int operand = Instruction::get_operand_value(code);
 	stackinfo.alignment = operand;
-      } break;
+      } M_NEXT();
 
-      case Opcode::ADD_ADR: {
+      M_CASE(ADD_ADR): {
 	int operand = Instruction::get_operand_value(code);
 	stackinfo.address += operand;
 	stackinfo.address_cache += operand;
 	print_debug("+%d address = %016" PRIx64 "\n", operand, stackinfo.address);
-      } break;
+      } M_NEXT();
 
-      case Opcode::MUL_ADR: {
+      M_CASE(MUL_ADR): {
 	int operand = Instruction::get_operand_value(code);
 	const vm_int_t diff = operand * stackinfo.type_cache1->get(stackinfo.value_cache);
 	stackinfo.address += diff;
 	stackinfo.address_cache += diff;
 	print_debug("+%d * %" PRIu64 " address = %16" PRIx64 "\n",
 		    operand, stackinfo.type_cache1->get(stackinfo.value_cache), stackinfo.address);
-      } break;
+      } M_NEXT();
 
-      case Opcode::GET_ADR: {
-	OperandRet operand = get_operand(code, op_param);
+      M_CASE(GET_ADR): {
+	OperandRet operand = get_operand<VERIFIED>(code, op_param);
 	*reinterpret_cast<vaddr_t*>(operand.cache) = stackinfo.address;
 	print_debug("*%016" PRIx64 " = %016" PRIx64 "\n", operand.addr, stackinfo.address);
-      } break;
+      } M_NEXT();
+
+      M_CASE(GET_ELEMENT_PTR): {
+	// ポインタにオフセットと、添字×要素のサイズを加算する
+	// アドレスの計算のみで、メモリには触れない
+	unsigned int count = Instruction::get_operand(code);
+	if (!VERIFIED && insts.size() <= stackinfo.pc + count * 3 + 3) {
+	  throw_error(Error::INST_VIOLATION);
+	}
+	OperandRet output  = get_operand<VERIFIED>(M_INST(1), op_param);
+	OperandRet pointer = get_operand<VERIFIED>(M_INST(2), op_param);
+	OperandRet offset  = get_operand<VERIFIED>(M_INST(3), op_param);
+	vaddr_t address = *reinterpret_cast<vaddr_t*>(pointer.cache) +
+	  *reinterpret_cast<int64_t*>(offset.cache);
+	for (unsigned int i = 0; i < count; i ++) {
+	  OperandRet index = get_operand<VERIFIED>(M_INST(4 + i * 3), op_param);
+	  unsigned int bits = Instruction::get_operand(M_INST(5 + i * 3));
+	  OperandRet size  = get_operand<VERIFIED>(M_INST(6 + i * 3), op_param);
+	  if (!VERIFIED && (bits == 0 || bits > 64)) {
+	    throw_error(Error::INST_VIOLATION);
+	  }
+	  address += get_sext_value(index.cache, bits) * *reinterpret_cast<int64_t*>(size.cache);
+	}
+	*reinterpret_cast<vaddr_t*>(output.cache) = address;
+	print_debug("*%016" PRIx64 " = %016" PRIx64 "\n", output.addr, address);
+	stackinfo.pc += count * 3 + 3; // EXTRA分pcを進める
+      } M_NEXT();
 
-      case Opcode::LOAD: {
-	OperandRet operand = get_operand(code, op_param);
+      M_CASE(LOAD): {
+	OperandRet operand = get_operand<VERIFIED>(code, op_param);
 	stackinfo.type_cache1->copy(operand.cache, stackinfo.address_cache);
 	print_debug("*%016" PRIx64 " = *%016" PRIx64 "(size = %ld)\n",
 		    operand.addr, stackinfo.address, stackinfo.type_cache2->size);
-      } break;
+      } M_NEXT();
 
-      case Opcode::STORE: {
-	OperandRet operand = get_operand(code, op_param);
+      M_CASE(STORE): {
+	OperandRet operand = get_operand<VERIFIED>(code, op_param);
 	print_debug("store %016" PRIx64 "\n", stackinfo.address);
 	stackinfo.type_cache1->copy(stackinfo.address_cache, operand.cache);
-      } break;
+      } M_NEXT();
 
-      case Opcode::CMPXCHG: {
-	OperandRet operand = get_operand(code, op_param);
+      M_CASE(CMPXCHG): {
+	OperandRet operand = get_operand<VERIFIED>(code, op_param);
 	int is_eq = 0;
 	stackinfo.type_cache1->op_equal(reinterpret_cast<uint8_t*>(&is_eq),
 					stackinfo.address_cache, stackinfo.value_cache);
@@ -508,41 +1121,41 @@ void VMachine::execute(int max_clock) {
 	  stackinfo.type_cache1->copy(stackinfo.output_cache, stackinfo.address_cache);
 	  *(stackinfo.output_cache + stackinfo.type_cache2->size) = 0;
 	}
-      } break;
+      } M_NEXT();
 
-      case Opcode::ALLOCA: {
-	OperandRet operand = get_operand(code, op_param);
+      M_CASE(ALLOCA): {
+	OperandRet operand = get_operand<VERIFIED>(code, op_param);
 	// サイズを計算
 	size_t size = *reinterpret_cast<uint32_t*>(operand.cache) * stackinfo.type_cache2->size;
-	// 領域を確保
-	DataStore& data = vmemory.alloc_data(size, false);
+	// スタックセグメントから領域を確保
+	// 関数の終了時にスタックポインタを戻すことで開放される
+	uint8_t* cache;
+	vaddr_t addr = alloc_stack_area(thread, stackinfo, size, &cache);
 	// 確保領域のアドレスを設定
-	*reinterpret_cast<vaddr_t*>(stackinfo.output_cache) = data.addr;
-	// allocaで確保した領域はスタック終了時に開放できるように記録しておく
-	stackinfo.alloca_addrs.push_back(data.addr);
+	*reinterpret_cast<vaddr_t*>(stackinfo.output_cache) = addr;
 	print_debug("alloca *%016" PRIx64 " = %016" PRIx64 "(%ld byte)\n",
-		    stackinfo.output, data.addr, data.size);
-      } break;
+		    stackinfo.output, addr, size);
+      } M_NEXT();
 
-      case Opcode::TEST: {
-	OperandRet operand = get_operand(code, op_param);
-	instruction_t code2 = insts.at(stackinfo.pc + 1);
+      M_CASE(TEST): {
+	OperandRet operand = get_operand<VERIFIED>(code, op_param);
+	instruction_t code2 = M_INST(1);
 	// operandの指し先がtrueかどうか判定。
 	if (*operand.cache) {
 	  stackinfo.phi0 = stackinfo.phi1;
 	  stackinfo.phi1 = stackinfo.pc = Instruction::get_operand(code2);
 	  print_debug("pc = %d\n", stackinfo.pc);
-	  continue;
+	  M_BRANCH();
 
 	} else {
 	  stackinfo.pc ++;
 	}
-      } break;
+      } M_NEXT();
 
-      case Opcode::TEST_EQ: {
+      M_CASE(TEST_EQ): {
 	// vector未対応な点に注意
-	OperandRet operand = get_operand(code, op_param);
-	instruction_t code2 = insts.at(stackinfo.pc + 1);
+	OperandRet operand = get_operand<VERIFIED>(code, op_param);
+	instruction_t code2 = M_INST(1);
 	// 値を比較
 	uint8_t res;
 	stackinfo.type_cache1->op_equal(&res, stackinfo.value_cache, operand.cache);
@@ -550,65 +1163,137 @@ void VMachine::execute(int max_clock) {
 	  stackinfo.phi0 = stackinfo.phi1;
 	  stackinfo.phi1 = stackinfo.pc = Instruction::get_operand(code2);
 	  print_debug("pc = %d\n", stackinfo.pc);
-	  continue;
+	  M_BRANCH();
 
 	} else {
 	  stackinfo.pc ++;
 	}
-      } break;
+      } M_NEXT();
 
-      case Opcode::JUMP: {
+      M_CASE(JUMP): {
 	stackinfo.phi0 = stackinfo.phi1;
 	stackinfo.phi1 = stackinfo.pc = Instruction::get_operand(code);
 	print_debug("pc = %d\n", stackinfo.pc);
-	continue;
-      } break;
+	M_BRANCH();
+      } M_NEXT();
 
-      case Opcode::INDIRECT_JUMP: {
-	OperandRet operand = get_operand(code, op_param);
+      M_CASE(INDIRECT_JUMP): {
+	OperandRet operand = get_operand<VERIFIED>(code, op_param);
 	stackinfo.phi0 = stackinfo.phi1;
 	stackinfo.phi1 = stackinfo.pc =
 	  static_cast<unsigned int>(*reinterpret_cast<vaddr_t*>(operand.cache));
+	// 分岐先は実行時に決まるため、検証済みの関数でも範囲を確認する
+	if (stackinfo.pc >= insts.size()) {
+	  throw_error(Error::INST_VIOLATION);
+	}
 	print_debug("pc = %d\n", stackinfo.pc);
-	continue;
-      } break;
+	M_BRANCH();
+      } M_NEXT();
 
-      case Opcode::PHI: {
-	instruction_t code2 = insts.at(stackinfo.pc + 1);
+      M_CASE(PHI): {
 	int count = 0;
-	while ((Instruction::get_opcode(code) == Opcode::PHI ||
-		Instruction::get_opcode(code) == Opcode::EXTRA)) {
+	do {
+	  instruction_t code2 = M_INST(count + 1);
 	  // PHI命令はEXTRA含め、偶数個
-	  if (Instruction::get_opcode(code2) != Opcode::EXTRA) {
+	  if (!VERIFIED && Instruction::get_opcode(code2) != Opcode::EXTRA) {
 	    throw_error(Error::INST_VIOLATION);
 	  }
 
 	  if (stackinfo.phi0 == Instruction::get_operand(code2)) {
-	    OperandRet operand = get_operand(code, op_param);
+	    OperandRet operand = get_operand<VERIFIED>(code, op_param);
 	    stackinfo.type_cache1->copy(stackinfo.output_cache, operand.cache);
 	  }
 	  count += 2;
-	  if (insts.size() <= stackinfo.pc + count + 1) break;
-	  code  = insts.at(stackinfo.pc + count);
-	  code2 = insts.at(stackinfo.pc + count + 1);
-	}
+	  // 検証済みの関数では、PHI命令の後に必ず次の命令がある
+	  if (!VERIFIED && insts.size() <= stackinfo.pc + count + 1) break;
+	  code = M_INST(count);
+	} while ((Instruction::get_opcode(code) == Opcode::PHI ||
+		  Instruction::get_opcode(code) == Opcode::EXTRA));
 	stackinfo.pc += count - 1;
 		      
-      } break;
+      } M_NEXT();
+
+      M_CASE(PHI_MOVE): {
+	// 分岐元から分岐先へのPHIの値をまとめてコピーし、PHIの後の命令に進む
+	unsigned int moves = Instruction::get_operand(code);
+	if (!VERIFIED && insts.size() <= stackinfo.pc + moves * 3 + 2) {
+	  throw_error(Error::INST_VIOLATION);
+	}
+	for (unsigned int i = 0; i < moves; i ++) {
+	  instruction_t dst_code = M_INST(1 + i * 3);
+	  instruction_t src_code = M_INST(2 + i * 3);
+	  size_t size = Instruction::get_operand(M_INST(3 + i * 3));
+	  if (!VERIFIED &&
+	      ((Instruction::get_operand(dst_code) & HEAD_OPERAND) != 0 ||
+	       Instruction::get_operand(dst_code) + size > op_param.stack_size)) {
+	    throw_error(Error::INST_VIOLATION);
+	  }
+	  uint8_t* dst = op_param.stack + Instruction::get_operand(dst_code);
+	  uint8_t* src = get_operand<VERIFIED>(src_code, op_param).cache;
+	  // 基本型のサイズは固定長でコピーする
+	  switch (size) {
+	  case 1: *dst = *src; break;
+	  case 2: memcpy(dst, src, 2); break;
+	  case 4: memcpy(dst, src, 4); break;
+	  case 8: memcpy(dst, src, 8); break;
+	  default: memcpy(dst, src, size); break;
+	  }
+	}
+	// 分岐命令で設定した分岐元のラベルはそのまま、分岐先はブロックの先頭とする
+	stackinfo.phi1 = Instruction::get_operand(M_INST(moves * 3 + 1));
+	stackinfo.pc   = Instruction::get_operand(M_INST(moves * 3 + 2));
+	print_debug("pc = %d\n", stackinfo.pc);
+	M_BRANCH();
+      } M_NEXT();
+
+      M_CASE(SWITCH_TABLE):
+      M_CASE(SWITCH_SEARCH): {
+	OperandRet operand = get_operand<VERIFIED>(code, op_param);
+	unsigned int bits  = Instruction::get_operand(M_INST(1));
+	instruction_t keys = M_INST(2);
+	unsigned int count = Instruction::get_operand(M_INST(3));
+	bool is_table = (Instruction::get_opcode(code) == Opcode::SWITCH_TABLE);
+	if (!VERIFIED &&
+	    (bits == 0 || bits > 64 || insts.size() <= stackinfo.pc + count + 4 ||
+	     (Instruction::get_operand(keys) & HEAD_OPERAND) == 0 ||
+	     (FILL_OPERAND - Instruction::get_operand(keys)) +
+	     sizeof(int64_t) * (is_table ? 1 : count) > op_param.k.size)) {
+	  throw_error(Error::INST_VIOLATION);
+	}
+	const int64_t* table = reinterpret_cast<const int64_t*>
+	  (op_param.k.head.get() + (FILL_OPERAND - Instruction::get_operand(keys)));
+	int64_t value = get_sext_value(operand.cache, bits);
+	// 一致する値がない場合はdefaultの分岐先
+	unsigned int index = 0;
+	if (is_table) {
+	  // 最小値からの差で分岐表を引く
+	  uint64_t diff = static_cast<uint64_t>(value) - static_cast<uint64_t>(*table);
+	  if (diff < count) index = diff + 1;
+
+	} else {
+	  // 昇順に並んだ値を二分探索する
+	  const int64_t* found = std::lower_bound(table, table + count, value);
+	  if (found != table + count && *found == value) index = found - table + 1;
+	}
+	stackinfo.phi0 = stackinfo.phi1;
+	stackinfo.phi1 = stackinfo.pc = Instruction::get_operand(M_INST(4 + index));
+	print_debug("pc = %d\n", stackinfo.pc);
+	M_BRANCH();
+      } M_NEXT();
 
-      case Opcode::TYPE_CAST: {
-	TypeStore& type = get_type(code, op_param);
+      M_CASE(TYPE_CAST): {
+	TypeStore& type = get_type<VERIFIED>(code, op_param);
 	stackinfo.type_cache1->type_cast(stackinfo.output_cache,
 					 type.addr,
 					 stackinfo.value_cache);
-      } break;
+      } M_NEXT();
 
-      case Opcode::BIT_CAST: {
-	TypeStore& type = get_type(code, op_param);
+      M_CASE(BIT_CAST): {
+	TypeStore& type = get_type<VERIFIED>(code, op_param);
 	stackinfo.type_cache1->bit_cast(stackinfo.output_cache,
 					type.size,
 					stackinfo.value_cache);
-      } break;
+      } M_NEXT();
 
 	M_BINARY_OPERATOR(EQUAL,         op_equal);         // o = v == A
 	M_BINARY_OPERATOR(NOT_EQUAL,     op_not_equal);     // o = v != A
@@ -616,53 +1301,347 @@ void VMachine::execute(int max_clock) {
 	M_BINARY_OPERATOR(GREATER_EQUAL, op_greater_equal); // o = v >= A
 	M_BINARY_OPERATOR(NOT_NANS,      op_not_nans);      // o = !isnan(v) && !isnan(A)
 
-      case Opcode::OR_NANS: {
-	OperandRet operand = get_operand(code, op_param);
+      M_CASE(OR_NANS): {
+	OperandRet operand = get_operand<VERIFIED>(code, op_param);
 	if (stackinfo.type_cache1->is_or_nans(stackinfo.value_cache, operand.cache)) {
 	  *stackinfo.output_cache = I8_TRUE;
 	  stackinfo.pc += 1; // 次の命令をスキップ
 	}
-      } break;
+      } M_NEXT();
 
-      case Opcode::SELECT: {
-	OperandRet operand1 = get_operand(code, op_param);
-	OperandRet operand2 = get_operand(insts.at(stackinfo.pc + 1), op_param);
+      M_CASE(SELECT): {
+	OperandRet operand1 = get_operand<VERIFIED>(code, op_param);
+	OperandRet operand2 = get_operand<VERIFIED>(M_INST(1), op_param);
 	if (*stackinfo.value_cache) {
 	  stackinfo.type_cache1->copy(stackinfo.output_cache, operand1.cache);
 	} else {
 	  stackinfo.type_cache1->copy(stackinfo.output_cache, operand2.cache);
 	}
 	stackinfo.pc += 1; // EXTRA分pcを進める
-      } break;
+      } M_NEXT();
 
-      case Opcode::SHUFFLE: {
+      M_CASE(SHUFFLE): {
 	int m = Instruction::get_operand_value(code);
-	OperandRet operand_mask = get_operand(insts.at(stackinfo.pc + 1), op_param);
-	OperandRet operand_v2 = get_operand(insts.at(stackinfo.pc + 2), op_param);
+	OperandRet operand_mask = get_operand<VERIFIED>(M_INST(1), op_param);
+	OperandRet operand_v2 = get_operand<VERIFIED>(M_INST(2), op_param);
 	TypeStore& element_store = vmemory.get_type(stackinfo.type_cache2->element);
 	TypeBased* element_based = get_type_based(stackinfo.type_cache2->element);
 	uint32_t len = stackinfo.type_cache2->num;
 	for (int i = 0; i < m; i ++) {
 	  uint32_t mask = reinterpret_cast<uint32_t*>(operand_mask.cache)[i];
-	  element_based->copy(stackinfo.output_cache + i * stackinfo.type_cache2->size,
-			      (mask < len ?
-			       stackinfo.value_cache + element_store.size * mask :
-			       operand_v2.cache + element_store.size * (mask - len)));
+	  // 範囲外(undef)の要素は値を設定しない
+	  if (mask < len) {
+	    element_based->copy(stackinfo.output_cache + i * element_store.size,
+				stackinfo.value_cache + element_store.size * mask);
+	  } else if (mask < len * 2) {
+	    element_based->copy(stackinfo.output_cache + i * element_store.size,
+				operand_v2.cache + element_store.size * (mask - len));
+	  }
 	}
 	stackinfo.pc += 2; // EXTRA分pcを進める
-      } break;
+      } M_NEXT();
+
+      /**
+       * 2項演算子の融合命令を作るマクロ。
+       * set_type, set_output, set_value, 演算命令を1命令で行う。
+       * 型、出力先、左辺値、右辺値を続くEXTRAから取得する。
+       */
+#define M_FUSED_BINARY_OPERATOR(name, op)				\
+	M_SUBCASE(BINARY_OP_##name, Opcode::name): {			\
+	  TypeBased* type = get_type_cache(get_type<VERIFIED>(M_INST(1), op_param), \
+					   thread.type_complex);	\
+	  OperandRet output  = get_operand<VERIFIED>(M_INST(2), op_param); \
+	  OperandRet value   = get_operand<VERIFIED>(M_INST(3), op_param); \
+	  OperandRet operand = get_operand<VERIFIED>(M_INST(4), op_param); \
+	  type->op(output.cache, value.cache, operand.cache);		\
+	  stackinfo.pc += 4; /* EXTRA分pcを進める */			\
+	} M_NEXT();
+
+      /**
+       * 型を特定した2項演算子の融合命令を作るマクロ。
+       * TypeBasedを介さず、左辺値a、右辺値bから演算結果を直接計算する。
+       * @param ty 基本型の名前
+       * @param T C++での型
+       * @param R 演算結果のC++での型
+       * @param name 演算のオペコード
+       * @param expr 演算の式
+       */
+#define M_TYPED_BINARY_OPERATOR(ty, T, R, name, expr)			\
+	M_SUBCASE(BINARY_OP_##name##_##ty, M_TYPED(ty, Opcode::name)): { \
+	  OperandRet output = get_operand<VERIFIED>(M_INST(2), op_param); \
+	  T a = *reinterpret_cast<T*>(get_operand<VERIFIED>(M_INST(3), op_param).cache); \
+	  T b = *reinterpret_cast<T*>(get_operand<VERIFIED>(M_INST(4), op_param).cache); \
+	  *reinterpret_cast<R*>(output.cache) = (expr);			\
+	  print_debug("%p : %s\n", output.cache,			\
+		      Util::numptr2str(output.cache, sizeof(R)).c_str()); \
+	  stackinfo.pc += 4; /* EXTRA分pcを進める */			\
+	} M_NEXT();
+
+#define M_TYPED_COMPARE_OPERATORS(ty, T)				\
+	M_TYPED_BINARY_OPERATOR(ty, T, uint8_t, EQUAL,         a == b ? I8_TRUE : I8_FALSE) \
+	M_TYPED_BINARY_OPERATOR(ty, T, uint8_t, NOT_EQUAL,     a != b ? I8_TRUE : I8_FALSE) \
+	M_TYPED_BINARY_OPERATOR(ty, T, uint8_t, GREATER,       a >  b ? I8_TRUE : I8_FALSE) \
+	M_TYPED_BINARY_OPERATOR(ty, T, uint8_t, GREATER_EQUAL, a >= b ? I8_TRUE : I8_FALSE)
+
+#define M_TYPED_INTEGER_OPERATORS(ty, T)				\
+	M_TYPED_COMPARE_OPERATORS(ty, T)				\
+	M_TYPED_BINARY_OPERATOR(ty, T, T, ADD, a + b)			\
+	M_TYPED_BINARY_OPERATOR(ty, T, T, SUB, a - b)			\
+	M_TYPED_BINARY_OPERATOR(ty, T, T, MUL, a * b)			\
+	M_TYPED_BINARY_OPERATOR(ty, T, T, DIV, a / b)			\
+	M_TYPED_BINARY_OPERATOR(ty, T, T, REM, a % b)			\
+	M_TYPED_BINARY_OPERATOR(ty, T, T, SHL, a << static_cast<unsigned>(b)) \
+	M_TYPED_BINARY_OPERATOR(ty, T, T, SHR, a >> static_cast<unsigned>(b)) \
+	M_TYPED_BINARY_OPERATOR(ty, T, T, AND, a & b)			\
+	M_TYPED_BINARY_OPERATOR(ty, T, T, OR,  a | b)			\
+	M_TYPED_BINARY_OPERATOR(ty, T, T, XOR, a ^ b)
+
+#define M_TYPED_FLOAT_OPERATORS(ty, T)					\
+	M_TYPED_COMPARE_OPERATORS(ty, T)				\
+	M_TYPED_BINARY_OPERATOR(ty, T, T, ADD, a + b)			\
+	M_TYPED_BINARY_OPERATOR(ty, T, T, SUB, a - b)			\
+	M_TYPED_BINARY_OPERATOR(ty, T, T, MUL, a * b)			\
+	M_TYPED_BINARY_OPERATOR(ty, T, T, DIV, a / b)			\
+	M_TYPED_BINARY_OPERATOR(ty, T, T, REM, std::fmod(a, b))		\
+	M_TYPED_BINARY_OPERATOR(ty, T, uint8_t, NOT_NANS,		\
+				!std::isnan(a) && !std::isnan(b) ? I8_TRUE : I8_FALSE)
+
+      M_CASE(BINARY_OP): {
+	M_SUBSWITCH(binary_op_table) {
+	  M_FUSED_BINARY_OPERATOR(ADD, op_add);
+	  M_FUSED_BINARY_OPERATOR(SUB, op_sub);
+	  M_FUSED_BINARY_OPERATOR(MUL, op_mul);
+	  M_FUSED_BINARY_OPERATOR(DIV, op_div);
+	  M_FUSED_BINARY_OPERATOR(REM, op_rem);
+	  M_FUSED_BINARY_OPERATOR(SHL, op_shl);
+	  M_FUSED_BINARY_OPERATOR(SHR, op_shr);
+	  M_FUSED_BINARY_OPERATOR(AND, op_and);
+	  M_FUSED_BINARY_OPERATOR(OR,  op_or);
+	  M_FUSED_BINARY_OPERATOR(XOR, op_xor);
+	  M_FUSED_BINARY_OPERATOR(EQUAL,         op_equal);
+	  M_FUSED_BINARY_OPERATOR(NOT_EQUAL,     op_not_equal);
+	  M_FUSED_BINARY_OPERATOR(GREATER,       op_greater);
+	  M_FUSED_BINARY_OPERATOR(GREATER_EQUAL, op_greater_equal);
+	  M_FUSED_BINARY_OPERATOR(NOT_NANS,      op_not_nans);
+
+	  M_INTEGER_TYPES(M_TYPED_INTEGER_OPERATORS)
+	  M_FLOAT_TYPES(M_TYPED_FLOAT_OPERATORS)
+	  M_TYPED_COMPARE_OPERATORS(POINTER, vaddr_t)
+
+	  M_SUBCASE_DEFAULT(BINARY_OP): {
+	    throw_error_message(Error::INST_VIOLATION, Util::num2hex_str(code));
+	  } M_NEXT();
+	}
+      } M_NEXT();
+#undef M_FUSED_BINARY_OPERATOR
+#undef M_TYPED_BINARY_OPERATOR
+#undef M_TYPED_COMPARE_OPERATORS
+#undef M_TYPED_INTEGER_OPERATORS
+#undef M_TYPED_FLOAT_OPERATORS
+
+      /**
+       * 比較と分岐の融合命令を作るマクロ。
+       * 比較結果を出力先に書き込んだ上で、
+       * 結果がtrueの場合は5番目、falseの場合は6番目のEXTRAが示す位置に分岐する。
+       */
+#define M_FUSED_TEST_OPERATOR(name, op)					\
+	M_SUBCASE(TEST_OP_##name, Opcode::name): {			\
+	  TypeBased* type = get_type_cache(get_type<VERIFIED>(M_INST(1), op_param), \
+					   thread.type_complex);	\
+	  OperandRet output  = get_operand<VERIFIED>(M_INST(2), op_param); \
+	  OperandRet value   = get_operand<VERIFIED>(M_INST(3), op_param); \
+	  OperandRet operand = get_operand<VERIFIED>(M_INST(4), op_param); \
+	  type->op(output.cache, value.cache, operand.cache);		\
+	  instruction_t label = M_INST(*output.cache ? 5 : 6); \
+	  stackinfo.phi0 = stackinfo.phi1;				\
+	  stackinfo.phi1 = stackinfo.pc = Instruction::get_operand(label); \
+	  print_debug("pc = %d\n", stackinfo.pc);			\
+	  M_BRANCH();							\
+	} M_NEXT();
+
+      /**
+       * 型を特定した比較と分岐の融合命令を作るマクロ。
+       * @param ty 基本型の名前
+       * @param T C++での型
+       * @param name 比較のオペコード
+       * @param expr 左辺値a、右辺値bの比較の式
+       */
+#define M_TYPED_TEST_OPERATOR(ty, T, name, expr)			\
+	M_SUBCASE(TEST_OP_##name##_##ty, M_TYPED(ty, Opcode::name)): {	\
+	  OperandRet output = get_operand<VERIFIED>(M_INST(2), op_param); \
+	  T a = *reinterpret_cast<T*>(get_operand<VERIFIED>(M_INST(3), op_param).cache); \
+	  T b = *reinterpret_cast<T*>(get_operand<VERIFIED>(M_INST(4), op_param).cache); \
+	  bool result = (expr);						\
+	  *output.cache = (result ? I8_TRUE : I8_FALSE);		\
+	  instruction_t label = M_INST(result ? 5 : 6); \
+	  stackinfo.phi0 = stackinfo.phi1;				\
+	  stackinfo.phi1 = stackinfo.pc = Instruction::get_operand(label); \
+	  print_debug("pc = %d\n", stackinfo.pc);			\
+	  M_BRANCH();							\
+	} M_NEXT();
+
+#define M_TYPED_COMPARE_TESTS(ty, T)					\
+	M_TYPED_TEST_OPERATOR(ty, T, EQUAL,         a == b)		\
+	M_TYPED_TEST_OPERATOR(ty, T, NOT_EQUAL,     a != b)		\
+	M_TYPED_TEST_OPERATOR(ty, T, GREATER,       a >  b)		\
+	M_TYPED_TEST_OPERATOR(ty, T, GREATER_EQUAL, a >= b)
+
+#define M_TYPED_FLOAT_TESTS(ty, T)					\
+	M_TYPED_COMPARE_TESTS(ty, T)					\
+	M_TYPED_TEST_OPERATOR(ty, T, NOT_NANS, !std::isnan(a) && !std::isnan(b))
+
+      M_CASE(TEST_OP): {
+	M_SUBSWITCH(test_op_table) {
+	  M_FUSED_TEST_OPERATOR(EQUAL,         op_equal);
+	  M_FUSED_TEST_OPERATOR(NOT_EQUAL,     op_not_equal);
+	  M_FUSED_TEST_OPERATOR(GREATER,       op_greater);
+	  M_FUSED_TEST_OPERATOR(GREATER_EQUAL, op_greater_equal);
+	  M_FUSED_TEST_OPERATOR(NOT_NANS,      op_not_nans);
+
+	  M_INTEGER_TYPES(M_TYPED_COMPARE_TESTS)
+	  M_FLOAT_TYPES(M_TYPED_FLOAT_TESTS)
+	  M_TYPED_COMPARE_TESTS(POINTER, vaddr_t)
+
+	  M_SUBCASE_DEFAULT(TEST_OP): {
+	    throw_error_message(Error::INST_VIOLATION, Util::num2hex_str(code));
+	  } M_NEXT();
+	}
+      } M_NEXT();
+#undef M_FUSED_TEST_OPERATOR
+#undef M_TYPED_TEST_OPERATOR
+#undef M_TYPED_COMPARE_TESTS
+#undef M_TYPED_FLOAT_TESTS
+
+      /**
+       * 型を特定したキャストの命令を作るマクロ。
+       * set_type, set_output, set_value, type_cast命令を1命令で行う。
+       * 出力先、入力元を続くEXTRAから取得する。
+       * @param src 入力元の基本型の名前
+       * @param S 入力元のC++での型
+       * @param dst 出力先の基本型の名前
+       * @param D 出力先のC++での型
+       */
+#define M_TYPED_CAST(src, S, dst, D)					\
+	M_SUBCASE(CAST_OP_##src##_##dst, M_TYPED(src, BasicType::TY_##dst)): { \
+	  OperandRet output = get_operand<VERIFIED>(M_INST(1), op_param); \
+	  OperandRet value  = get_operand<VERIFIED>(M_INST(2), op_param); \
+	  *reinterpret_cast<D*>(output.cache) = static_cast<D>(*reinterpret_cast<S*>(value.cache)); \
+	  print_debug("type_cast:%s\n", Util::numptr2str(output.cache, sizeof(D)).c_str()); \
+	  stackinfo.pc += 2; /* EXTRA分pcを進める */			\
+	} M_NEXT();
+
+#define M_TYPED_CAST_FROM(ty, T)					\
+	M_TYPED_CAST(ty, T, UI8,  uint8_t)  M_TYPED_CAST(ty, T, UI16, uint16_t) \
+	M_TYPED_CAST(ty, T, UI32, uint32_t) M_TYPED_CAST(ty, T, UI64, uint64_t) \
+	M_TYPED_CAST(ty, T, SI8,  int8_t)   M_TYPED_CAST(ty, T, SI16, int16_t) \
+	M_TYPED_CAST(ty, T, SI32, int32_t)  M_TYPED_CAST(ty, T, SI64, int64_t) \
+	M_TYPED_CAST(ty, T, F32,  float)    M_TYPED_CAST(ty, T, F64,  double)
+
+      M_CASE(CAST_OP): {
+	M_SUBSWITCH(cast_op_table) {
+	  M_NUMERIC_TYPES(M_TYPED_CAST_FROM)
+
+	  M_SUBCASE_DEFAULT(CAST_OP): {
+	    throw_error_message(Error::INST_VIOLATION, Util::num2hex_str(code));
+	  } M_NEXT();
+	}
+      } M_NEXT();
+#undef M_TYPED_CAST
+#undef M_TYPED_CAST_FROM
+
+      /**
+       * 型を特定したloadの命令を作るマクロ。
+       * set_type, set_ptr, load命令を1命令で行う。
+       * 出力先、読み込み元のアドレスを格納したポインタ、変位を続くEXTRAから取得する。
+       * @param ty 基本型の名前
+       * @param T C++での型
+       */
+#define M_TYPED_LOAD(ty, T)						\
+	M_SUBCASE(LOAD_OP_##ty, BasicType::TY_##ty): {			\
+	  OperandRet output  = get_operand<VERIFIED>(M_INST(1), op_param); \
+	  OperandRet pointer = get_operand<VERIFIED>(M_INST(2), op_param); \
+	  vaddr_t address = *reinterpret_cast<vaddr_t*>(pointer.cache) + \
+	    Instruction::get_operand_value(M_INST(3));			\
+	  *reinterpret_cast<T*>(output.cache) =				\
+	    *reinterpret_cast<T*>(get_cache(address, vmemory));		\
+	  print_debug("*%016" PRIx64 " = *%016" PRIx64 "\n", output.addr, address); \
+	  stackinfo.pc += 3; /* EXTRA分pcを進める */			\
+	} M_NEXT();
+
+      M_CASE(LOAD_OP): {
+	M_SUBSWITCH(load_op_table) {
+	  M_NUMERIC_TYPES(M_TYPED_LOAD)
+	  M_TYPED_LOAD(POINTER, vaddr_t)
+
+	  M_SUBCASE_DEFAULT(LOAD_OP): {
+	    throw_error_message(Error::INST_VIOLATION, Util::num2hex_str(code));
+	  } M_NEXT();
+	}
+      } M_NEXT();
+#undef M_TYPED_LOAD
+
+      /**
+       * 型を特定したstoreの命令を作るマクロ。
+       * set_type, set_ptr, store命令を1命令で行う。
+       * 書き込み先のアドレスを格納したポインタ、書き込む値、変位を続くEXTRAから取得する。
+       * @param ty 基本型の名前
+       * @param T C++での型
+       */
+#define M_TYPED_STORE(ty, T)						\
+	M_SUBCASE(STORE_OP_##ty, BasicType::TY_##ty): {			\
+	  OperandRet pointer = get_operand<VERIFIED>(M_INST(1), op_param); \
+	  OperandRet value   = get_operand<VERIFIED>(M_INST(2), op_param); \
+	  vaddr_t address = *reinterpret_cast<vaddr_t*>(pointer.cache) + \
+	    Instruction::get_operand_value(M_INST(3));			\
+	  *reinterpret_cast<T*>(get_cache(address, vmemory)) =		\
+	    *reinterpret_cast<T*>(value.cache);				\
+	  print_debug("store %016" PRIx64 "\n", address);		\
+	  stackinfo.pc += 3; /* EXTRA分pcを進める */			\
+	} M_NEXT();
+
+      M_CASE(STORE_OP): {
+	M_SUBSWITCH(store_op_table) {
+	  M_NUMERIC_TYPES(M_TYPED_STORE)
+	  M_TYPED_STORE(POINTER, vaddr_t)
+
+	  M_SUBCASE_DEFAULT(STORE_OP): {
+	    throw_error_message(Error::INST_VIOLATION, Util::num2hex_str(code));
+	  } M_NEXT();
+	}
+      } M_NEXT();
+#undef M_TYPED_STORE
 
-      default: {
+      M_CASE_DEFAULT: {
 	// EXTRAARGを含む想定外の命令
 	throw_error_message(Error::INST_VIOLATION, Util::num2hex_str(insts.at(stackinfo.pc)));
-      } break;
-
-#undef M_BIN_OPERATOR
+      } M_NEXT();
+
+#undef M_BINARY_OPERATOR
+#undef M_CASE
+#undef M_CASE_DEFAULT
+#undef M_SUBSWITCH
+#undef M_SUBCASE
+#undef M_SUBCASE_DEFAULT
+#undef M_TYPED
+#undef M_INST
+#undef M_INTEGER_TYPES
+#undef M_FLOAT_TYPES
+#undef M_NUMERIC_TYPES
+#undef M_JUMP
+#undef M_NEXT
+#undef M_BRANCH
+#undef M_QUICKEN
+#ifdef ENABLE_THREADED_DISPATCH
+#undef M_DISPATCH
+    }
+#else // ENABLE_THREADED_DISPATCH
       }
       
       stackinfo.pc ++;
     }
+#endif // ENABLE_THREADED_DISPATCH
   }
+  return false;
 }
 
 // 外部の関数を呼び出す。
@@ -976,19 +1955,43 @@ void VMachine::call_external(const FuncStore& func,
 
 
 
+// スレッドのスタックセグメントから領域を確保する。
+vaddr_t VMachine::alloc_stack_area(Thread& thread, StackInfo& stackinfo,
+				   size_t size, uint8_t** cache) {
+  // スタックセグメントは最初に利用する時に確保する
+  if (thread.stack_segment == VADDR_NON) {
+    DataStore& segment = vmemory.alloc_data(STACK_SEGMENT_SIZE, false);
+    thread.stack_segment       = segment.addr;
+    thread.stack_segment_cache = &segment;
+    thread.stack_pointer       = 0;
+  }
+
+  // 領域の先頭をアライメントに揃えるため、サイズを切り上げる
+  size_t aligned_size =
+    (size + STACK_SEGMENT_ALIGNMENT - 1) & ~(STACK_SEGMENT_ALIGNMENT - 1);
+  if (thread.stack_pointer + aligned_size <= STACK_SEGMENT_SIZE) {
+    size_t offset = thread.stack_pointer;
+    thread.stack_pointer += aligned_size;
+    *cache = thread.stack_segment_cache->head.get() + offset;
+    return thread.stack_segment + offset;
+
+  } else {
+    // セグメントに空きがない場合は個別に確保し、関数の終了時に開放できるように記録しておく
+    DataStore& data = vmemory.alloc_data(size, false);
+    stackinfo.alloca_addrs.push_back(data.addr);
+    *cache = data.head.get();
+    return data.addr;
+  }
+}
+
 // Setup to call function that type : void (*)(void).
 void VMachine::call_setup_voidfunc(Thread& thread, vaddr_t func_addr) {
   FuncStore& func = vmemory.get_func(func_addr);
-  std::unique_ptr<StackInfo> stackinfo
-    (new StackInfo(func.addr,
-		   VADDR_NON, // 戻り値なし
-		   0, 0, // 正常、異常終了時のpc設定もなし
-		   (func.normal_prop.stack_size != 0 ?
-		    vmemory.alloc_data(func.normal_prop.stack_size, false).addr :
-		    VADDR_NON)));  
   // 関数の型に合わせて呼び出す。
   if (func.type == FuncType::FC_NORMAL) {
-    thread.stackinfos.push_back(std::unique_ptr<StackInfo>(stackinfo.release()));
+    thread.stackinfos.push_back(create_stackinfo(thread, func,
+						 VADDR_NON, // 戻り値なし
+						 0, 0)); // 正常、異常終了時のpc設定もなし
     
   } else if (func.type == FuncType::FC_BUILTIN) {
     // VM組み込み関数の呼び出し
@@ -1039,6 +2042,19 @@ std::pair<size_t, unsigned int> VMachine::calc_type_size(vaddr_t type) {
 void VMachine::close() {
 }
 
+// 未検証の関数の呼び出しを数える。
+void VMachine::count_hotness(FuncStore& func) {
+  if (func.verify_status != FuncStore::VS_UNKNOWN) return;
+
+  // 初回は同じ内容の関数を検証済みかどうかを確認する
+  if (func.hotness == 0 &&
+      Verifier::is_verified(func, vmemory.get_data(func.normal_prop.k), vmemory)) {
+    func.verify_status = FuncStore::VS_VERIFIED;
+    return;
+  }
+  func.hotness ++;
+}
+
 // ネイティブポインタに仮想アドレス対応付ける。
 vaddr_t VMachine::create_native_ptr(void* ptr) {
   while(native_ptr.find(last_free_native_ptr) != native_ptr.end()) {
@@ -1051,6 +2067,64 @@ vaddr_t VMachine::create_native_ptr(void* ptr) {
   return (last_free_native_ptr ++);
 }
 
+// 関数呼び出し用のStackInfoを作成する。
+std::unique_ptr<StackInfo> VMachine::create_stackinfo(Thread& thread,
+						      FuncStore& func,
+						      vaddr_t ret_addr,
+						      unsigned int normal_pc,
+						      unsigned int unwind_pc) {
+  std::unique_ptr<StackInfo> stackinfo;
+  if (thread.stackinfo_pool.empty()) {
+    stackinfo.reset(new StackInfo(func.addr, ret_addr, normal_pc, unwind_pc, VADDR_NON));
+
+  } else {
+    stackinfo = std::move(thread.stackinfo_pool.back());
+    thread.stackinfo_pool.pop_back();
+    stackinfo->reset(func.addr, ret_addr, normal_pc, unwind_pc, VADDR_NON);
+  }
+  // 関数の終了時にスタックポインタを戻す位置を記録し、スタック領域を確保する
+  stackinfo->stack_base = thread.stack_pointer;
+  if (func.normal_prop.stack_size != 0) {
+    stackinfo->stack = alloc_stack_area(thread, *stackinfo, func.normal_prop.stack_size,
+					&stackinfo->stack_cache);
+  }
+  // 呼び出し直後に利用するキャッシュを解決しておく
+  stackinfo->func_cache = &func;
+  stackinfo->cache_generation = vmemory.get_generation();
+  // 未検証の関数は呼び出し回数を検証に切り替える判断に使う
+  count_hotness(func);
+
+  return stackinfo;
+}
+
+// スレッドを作成し、スレッド一覧の末尾に追加する。
+Thread& VMachine::create_thread(vaddr_t func_addr, vaddr_t arg) {
+  FuncStore& func = vmemory.get_func(func_addr);
+  // 開始関数はvoid* (*)(void*)の通常の関数に限る
+  if (func.type != FuncType::FC_NORMAL || func.arg_num > 1) {
+    throw_error(Error::SPEC_VIOLATION);
+  }
+  std::unique_ptr<Thread> thread(new Thread(++ last_tid));
+
+  // 開始関数のreturnを受け取るためのスタックを1段確保する
+  DataStore& ret_store = vmemory.alloc_data(sizeof(vaddr_t), false);
+  StackInfo* ret_stackinfo = new StackInfo(VADDR_NON, VADDR_NON, 0, 0, ret_store.addr);
+  ret_stackinfo->output = ret_store.addr;
+  ret_stackinfo->output_cache = ret_store.head.get();
+  thread->stackinfos.push_back(std::unique_ptr<StackInfo>(ret_stackinfo));
+
+  // 開始関数の引数をスタックの先頭に格納する
+  std::unique_ptr<StackInfo> stackinfo =
+    create_stackinfo(*thread, func, ret_store.addr, 0, 0);
+  if (func.arg_num == 1) {
+    memcpy(stackinfo->stack_cache, &arg, sizeof(vaddr_t));
+  }
+  thread->stackinfos.push_back(std::move(stackinfo));
+
+  threads.push_back(std::move(thread));
+  return *threads.back();
+}
+
 // 配列型の型情報を作成する。
 TypeStore& VMachine::create_type_array(vaddr_t element, unsigned int num) {
   // サイズ、アライメントを計算
@@ -1108,6 +2182,7 @@ void VMachine::deploy_function_normal(const std::string& name,
 				      const FuncStore::NormalProp& prop,
 				      vaddr_t addr) {
   // 関数領域を確保
+  // 命令列の検証は展開時には行わず、呼び出しと後方への分岐の回数が閾値に達した時点で行う
   vmemory.alloc_func(symbols.get(name), ret_type, arg_num, is_var_arg, prop, addr);
 }
 
@@ -1122,7 +2197,11 @@ void VMachine::exit() {
 	     status == BEFOR_WARP || status == WARP ||
 	     status == AFTER_WARP) {
     status = ACTIVE;
-    threads.front().get()->stackinfos.resize(1);
+    Thread& thread = *threads.front();
+    while (thread.stackinfos.size() > 1) {
+      free_stackinfo(thread, std::move(thread.stackinfos.back()));
+      thread.stackinfos.pop_back();
+    }
     
   } else if (status ==  EXITING) {
     // Do noting.
@@ -1132,6 +2211,42 @@ void VMachine::exit() {
   }
 }
 
+// 関数から戻ったStackInfoを開放する。
+void VMachine::free_stackinfo(Thread& thread, std::unique_ptr<StackInfo> stackinfo) {
+  // 個別に確保した領域を開放
+  for (vaddr_t addr : stackinfo->alloca_addrs) {
+    vmemory.free(addr);
+  }
+  stackinfo->alloca_addrs.clear();
+
+  // スタックセグメント上の領域はスタックポインタを呼び出し前の位置に戻して開放する
+  thread.stack_pointer = stackinfo->stack_base;
+  thread.stackinfo_pool.push_back(std::move(stackinfo));
+}
+
+// 終了したスレッドを開放し、スレッド一覧から除去する。
+void VMachine::free_thread(Thread& thread) {
+  assert(thread.tid != MAIN_THREAD_ID);
+  // 呼び出し階層とスタックセグメント、開始関数の戻り値を受け取った領域を開放する
+  while (thread.stackinfos.size() > 1) {
+    free_stackinfo(thread, std::move(thread.stackinfos.back()));
+    thread.stackinfos.pop_back();
+  }
+  vmemory.free(thread.stackinfos.front()->stack);
+  if (thread.stack_segment != VADDR_NON) {
+    vmemory.free(thread.stack_segment);
+  }
+
+  for (size_t i = 0; i < threads.size(); i ++) {
+    if (threads.at(i).get() == &thread) {
+      threads.erase(threads.begin() + i);
+      // 次に実行するスレッドの位置がずれないようにする
+      if (i < current_thread) current_thread --;
+      break;
+    }
+  }
+}
+
 // ライブラリなど、外部の関数へのポインタを取得する。
 external_func_t VMachine::get_external_func(const Symbols::Symbol& name) {
   print_debug("get external func:%s\n", name.str().c_str());
@@ -1182,8 +2297,6 @@ uint8_t* VMachine::get_raw_addr(vaddr_t addr) {
 
 // 型依存の演算インスタンスを取得する。
 TypeBased* VMachine::get_type_based(vaddr_t type) {
-  // 複合型に対する演算命令
-  static TypeComplex type_complex;
   if (type < sizeof(TYPE_BASES) / sizeof(TYPE_BASES[0])) {
     // 存在する基本型の場合、TYPE_BASESからインスタンスを取得
     assert(TYPE_BASES[type] != nullptr);
@@ -1196,6 +2309,26 @@ TypeBased* VMachine::get_type_based(vaddr_t type) {
   }
 }
 
+// 非同期処理の完了を待つ以外に進められるスレッドがないかどうかを判定する。
+bool VMachine::is_blocked() const {
+#ifndef EMSCRIPTEN
+  if (!is_stalled) return false;
+
+  bool is_waiting_async = false;
+  for (auto& it : threads) {
+    if (!it->async_call) continue;
+    // 完了した非同期処理があれば、待っていたスレッドは次の実行で進む
+    if (it->async_call->is_done()) return false;
+    is_waiting_async = true;
+  }
+  return is_waiting_async;
+
+#else
+  // 完了を通知するホストのスレッドがないため、止めずに実行して完了を確認する
+  return false;
+#endif
+}
+
 /**
  * 組み込み関数用に引数を取り出すメソッドを作成するマクロ。
  * @param name メソッド名
@@ -1244,6 +2377,16 @@ void VMachine::regist_builtin_func(const std::string& name,
 
 // StackInfoのキャッシュを解決し、実行前の状態にする。
 void VMachine::resolve_stackinfo_cache(Thread* thread, StackInfo* stackinfo) {
+  // 解決した後に領域の開放がなければキャッシュはそのまま利用できる
+  if (stackinfo->cache_generation == vmemory.get_generation()) {
+    // 複合型の演算命令はスレッドで共有しているので、操作対象の型を戻しておく
+    if (stackinfo->type_cache1 == &(thread->type_complex)) {
+      thread->type_complex.type_store = stackinfo->type_cache2;
+    }
+    return;
+  }
+  stackinfo->cache_generation = vmemory.get_generation();
+
   // 関数
   if (stackinfo->func != VADDR_NON) {
     stackinfo->func_cache = &vmemory.get_func(stackinfo->func);
@@ -1252,7 +2395,7 @@ void VMachine::resolve_stackinfo_cache(Thread* thread, StackInfo* stackinfo) {
   }
   // スタック領域
   if (stackinfo->stack != VADDR_NON) {
-    stackinfo->stack_cache = &vmemory.get_data(stackinfo->stack);
+    stackinfo->stack_cache = get_cache(stackinfo->stack, vmemory);
   } else {
     stackinfo->stack_cache = nullptr;
   }
@@ -1297,6 +2440,31 @@ vaddr_t VMachine::reserve_func_addr() {
   return vmemory.reserve_func_addr();
 }
 
+// スレッドが開始した非同期処理の状態を確認する。
+bool VMachine::resume_async(Thread& thread, vaddr_t dst) {
+  std::vector<uint8_t> result;
+  if (!resume_async(thread, &result)) return false;
+
+  if (dst != VADDR_NON && !result.empty()) {
+    std::memcpy(get_raw_addr(dst), result.data(), result.size());
+  }
+  return true;
+}
+
+// スレッドが開始した非同期処理の状態を確認し、完了していれば結果を受け取る。
+bool VMachine::resume_async(Thread& thread, std::vector<uint8_t>* result) {
+  if (!thread.async_call) return false;
+
+  if (!thread.async_call->is_done()) {
+    thread.is_waiting = true;
+    return true;
+  }
+
+  result->swap(thread.async_call->result);
+  thread.async_call.reset();
+  return true;
+}
+
 // VMの初期設定をする。
 void VMachine::run(const std::vector<std::string>& args,
 		   const std::map<std::string, std::string>& envs) {
@@ -1312,11 +2480,10 @@ void VMachine::run(const std::vector<std::string>& args,
     throw_error_message(Error::SYM_NOT_FOUND, "main");
   FuncStore& main_func = vmemory.get_func(it_main_func->second);
 
-  // main関数用のスタックを確保する
-  DataStore* main_stack = nullptr;
-  if (main_func.normal_prop.stack_size != 0) {
-    main_stack = &vmemory.alloc_data(main_func.normal_prop.stack_size, false);
-  }
+  // main関数用のスタックをスタックセグメントに確保する
+  std::unique_ptr<StackInfo> main_stackinfo =
+    create_stackinfo(*init_thread, main_func, VADDR_NON, 0, 0);
+  uint8_t* main_stack = main_stackinfo->stack_cache;
 
   // maink関数の内容に応じて、init_stackを作成する
   DataStore* init_stack;
@@ -1341,8 +2508,8 @@ void VMachine::run(const std::vector<std::string>& args,
     // main関数のスタックの先頭にargc, argvを格納する
     vm_int_t argc = args.size();
     vaddr_t  argv = init_stack->addr + ret_size;
-    memcpy(main_stack->head.get(), &argc, sizeof(argc));
-    memcpy(main_stack->head.get() + 4, &argv, sizeof(argv));
+    memcpy(main_stack, &argc, sizeof(argc));
+    memcpy(main_stack + 4, &argv, sizeof(argv));
 
     // init_stack_dataにmain関数の戻り値、argvとして渡すポインタの配列、引数文字列、、を格納する
     vaddr_t sum = ret_size + sizeof(vaddr_t) * args.size();
@@ -1360,7 +2527,7 @@ void VMachine::run(const std::vector<std::string>& args,
       // main関数のスタックにenvpを格納する。
       unsigned int arg_size = sum;
       vaddr_t envp = init_stack->addr + sum;
-      memcpy(main_stack->head.get() + 4 + sizeof(vaddr_t), &envp, sizeof(envp));
+      memcpy(main_stack + 4 + sizeof(vaddr_t), &envp, sizeof(envp));
       sum += sizeof(vaddr_t) * (envs.size() + 1);
       int i = 0;
       for (auto pair : envs) {
@@ -1389,14 +2556,8 @@ void VMachine::run(const std::vector<std::string>& args,
   init_stackinfo->output_cache = init_stack->head.get();
   init_thread->stackinfos.push_back(std::unique_ptr<StackInfo>(init_stackinfo));
   
-  StackInfo* main_stackinfo;
-  if (main_stack != nullptr) {
-    main_stackinfo = new StackInfo(main_func.addr, init_stack->addr, 0, 0, main_stack->addr);
-  } else {
-    main_stackinfo = new StackInfo(main_func.addr, init_stack->addr, 0, 0, VADDR_NON);
-  }
-
-  init_thread->stackinfos.push_back(std::unique_ptr<StackInfo>(main_stackinfo));
+  main_stackinfo->ret_addr = init_stack->addr;
+  init_thread->stackinfos.push_back(std::move(main_stackinfo));
 
   status = ACTIVE;
 }
@@ -1452,6 +2613,7 @@ void VMachine::setup() {
   BuiltinMemory::regist(*this);
   BuiltinOverflow::regist(*this);
   BuiltinPosix::regist(*this);
+  BuiltinPthread::regist(*this);
   BuiltinVaArg::regist(*this);
   BuiltinWarp::regist(*this);
 
@@ -1472,9 +2634,16 @@ bool VMachine::setup_warpin(const std::string& address) {
     return false;
   }
 
+  bool is_anytime =
+    threads.back()->warp_parameter[PW_KEY_WARP_TIMING] == PW_VAL_ON_ANYTIME;
+  // スレッドが複数ある間は全てを送れないので、warpを始めない
+  if (is_anytime && threads.size() != 1) {
+    return false;
+  }
+
   warp_to = address;
   
-  if (threads.back()->warp_parameter[PW_KEY_WARP_TIMING] == PW_VAL_ON_ANYTIME) {
+  if (is_anytime) {
     warp_stack_size = threads.back()->stackinfos.size();
     warp_call_count = 0;
     status = BEFOR_WARP;
@@ -1486,6 +2655,21 @@ bool VMachine::setup_warpin(const std::string& address) {
   return true;
 }
 
+// 処理をホストのスレッドプールで開始し、スレッドを完了まで待ち状態にする。
+void VMachine::start_async_task(Thread& thread, const AsyncCall::Task& task) {
+  assert(!thread.async_call);
+  thread.async_call = AsyncCall::start_task(task, async_handler);
+  thread.is_waiting = true;
+}
+
+// 指定した時間が経過すると完了するタイマーを開始し、スレッドを完了まで待ち状態にする。
+void VMachine::start_async_timer(Thread& thread, AsyncCall::Clock::duration duration,
+				 const std::vector<uint8_t>& result) {
+  assert(!thread.async_call);
+  thread.async_call = AsyncCall::start_timer(duration, result, async_handler);
+  thread.is_waiting = true;
+}
+
 // 仮想アドレスに対応づくネイティブポインタを変更する。
 void VMachine::update_native_ptr(vaddr_t addr, void* ptr) {
   assert(addr != VADDR_NULL && ptr != nullptr);
@@ -1517,3 +2701,17 @@ void VMachine::v_memset(vaddr_t dst, int c, size_t len) {
   }
   memset(store.head.get(), c, len);
 }
+
+// 通常の関数の命令列を検証し、検証状態を設定する。
+void VMachine::verify_function(FuncStore& func) {
+  assert(func.type == FuncType::FC_NORMAL);
+  DataStore& k = vmemory.get_data(func.normal_prop.k);
+  if (Verifier::verify(func, k, vmemory)) {
+    func.verify_status = FuncStore::VS_VERIFIED;
+
+  } else {
+    // 検証できない関数は命令ごとに検査しながら実行する
+    print_debug("verify failed:%s\n", func.name.str().c_str());
+    func.verify_status = FuncStore::VS_REJECTED;
+  }
+}
@@ -58,7 +58,9 @@ namespace processwarp {
     Globals globals;    ///< 大域変数、関数シンボル→アドレス
     Status  status;     ///< VM実行状態
     Symbols symbols;    ///< シンボル
-    Threads threads;    ///< スレッド一覧
+    Threads threads;    ///< スレッド一覧(先頭はmain関数を実行するスレッド)
+    size_t current_thread; ///< 次に実行するスレッドの位置
+    vm_uint_t last_tid; ///< 最後に割り当てたスレッドID
     VMemory vmemory;    ///< 仮想メモリ空間
     std::map<vaddr_t, void*> native_ptr; ///< 仮想アドレスとネイティブポインタのペア
     vaddr_t last_free_native_ptr;
@@ -66,6 +68,11 @@ namespace processwarp {
     std::string warp_to; ///< id for warp to
     vm_uint_t warp_stack_size; ///< stack size when befor warp
     vm_uint_t warp_call_count;
+    TypeComplex type_complex; ///< get_type_basedが戻す複合型に対する演算命令
+
+    /// 非同期処理が完了した時に呼び出す関数(完了させたホストのスレッドから呼び出す)
+    AsyncCall::Handler async_handler;
+    bool is_stalled; ///< 直前のexecuteで全てのスレッドが待ちのやり直しで進めなかった場合true
     
     /**
      * Constructor.
@@ -75,6 +82,18 @@ namespace processwarp {
     VMachine(std::vector<void*>& libs,
 	     const std::map<std::string, std::string>& lib_filter);
 
+    /**
+     * スレッドのスタックセグメントから領域を確保する。
+     * 確保した領域は関数の終了時にスタックポインタを戻すことでまとめて開放される。
+     * セグメントに空きがない場合は個別の領域を確保し、stackinfoのalloca_addrsに記録する。
+     * @param thread 領域を確保するスレッド
+     * @param stackinfo 領域を利用する呼び出し階層
+     * @param size 確保するサイズ
+     * @param cache 確保した領域の実アドレスの格納先
+     * @return 確保した領域の仮想アドレス
+     */
+    vaddr_t alloc_stack_area(Thread& thread, StackInfo& stackinfo, size_t size, uint8_t** cache);
+
     /**
      * 外部の関数を呼び出す。
      * @param func 外部の関数情報
@@ -111,6 +130,14 @@ namespace processwarp {
      */
     void close();
 
+    /**
+     * 未検証の関数の呼び出しを数える。
+     * 初回は同じ内容の関数を検証済みかどうかを確認し、検証済みであれば
+     * 命令ごとの検査を省略した実行に直ちに切り替える。
+     * @param func 呼び出す通常の関数
+     */
+    void count_hotness(FuncStore& func);
+
     /**
      * ネイティブポインタに仮想アドレス対応付ける。
      * get_raw_addr利用時に、引数に指定したアドレスが取得可能となる。
@@ -120,6 +147,32 @@ namespace processwarp {
      */
     vaddr_t create_native_ptr(void* ptr);
 
+    /**
+     * 関数呼び出し用のStackInfoを作成する。
+     * スレッドが保持している再利用可能なStackInfoがあればそれを利用し、
+     * スタック領域はスレッドのスタックセグメントから確保する。
+     * @param thread 関数を呼び出すスレッド
+     * @param func 呼び出す通常の関数
+     * @param ret_addr return格納先
+     * @param normal_pc unwindなしに関数が終了した場合にpcに設定する値
+     * @param unwind_pc unwindが発生した場合にpcに設定する値
+     * @return 作成したStackInfo(関数領域、スタック領域のキャッシュは解決済み)
+     */
+    std::unique_ptr<StackInfo> create_stackinfo(Thread& thread,
+						FuncStore& func,
+						vaddr_t ret_addr,
+						unsigned int normal_pc,
+						unsigned int unwind_pc);
+
+    /**
+     * スレッドを作成し、スレッド一覧の末尾に追加する。
+     * 開始関数の戻り値を受け取るためのStackInfoを1段確保し、その上で開始関数を呼び出す。
+     * @param func_addr 開始関数のアドレス
+     * @param arg 開始関数に渡す引数
+     * @return 作成したスレッド
+     */
+    Thread& create_thread(vaddr_t func_addr, vaddr_t arg);
+
     /**
      * 配列型の型情報を作成する。
      * @param element 配列のメンバの型のアドレス
@@ -189,15 +242,53 @@ namespace processwarp {
 
     /**
      * VM命令を実行する。
+     * 実行可能なスレッドを順番に切り替えながら実行する。
      * @param max_clock コンテキストスイッチまで最長クロック数
+     * @return 実行したクロック数
+     */
+    int execute(int max_clock);
+
+    /**
+     * 関数の命令列を実行する。
+     * 検証済みの関数では命令ごとの範囲の検査を省略する。
+     * @param VERIFIED 実行する関数が検証済みの場合true
+     * @param thread 実行中のスレッド
+     * @param stackinfo 実行中の呼び出し階層
+     * @param max_clock コンテキストスイッチまでの残りクロック数
+     * @return 関数の呼び出しや戻りにより、実行する関数を選択し直す場合true
      */
-    void execute(int max_clock);
+    template<bool VERIFIED> bool execute_code(Thread& thread, StackInfo& stackinfo,
+					      int& max_clock);
+
+    /**
+     * 1つのスレッドの命令を実行する。
+     * 残りクロック数を使い切るか、スレッドが待ち状態になるか終了するまで実行する。
+     * @param thread 実行するスレッド
+     * @param max_clock コンテキストスイッチまでの残りクロック数
+     */
+    void execute_thread(Thread& thread, int& max_clock);
 
     /**
      * Change status to exit.
      */
     void exit();
 
+    /**
+     * 関数から戻ったStackInfoを開放する。
+     * スタックセグメントのスタックポインタを呼び出し前の位置に戻し、
+     * 個別に確保したalloca領域は開放する。
+     * StackInfoは次の関数呼び出しで再利用するためスレッドに保持する。
+     * @param thread StackInfoが所属していたスレッド
+     * @param stackinfo 開放するStackInfo
+     */
+    void free_stackinfo(Thread& thread, std::unique_ptr<StackInfo> stackinfo);
+
+    /**
+     * 終了したスレッドを開放し、スレッド一覧から除去する。
+     * @param thread 開放するスレッド(main関数を実行するスレッドは指定できない)
+     */
+    void free_thread(Thread& thread);
+
     /**
      * アドレスに格納された値にアクセスする。
      * @param アクセス先仮想アドレス。
@@ -235,6 +326,14 @@ namespace processwarp {
      */
     TypeBased* get_type_based(vaddr_t type);
 
+    /**
+     * 非同期処理の完了を待つ以外に進められるスレッドがないかどうかを判定する。
+     * 全てのスレッドが待ちのやり直しで進めず、待っている非同期処理がどれも完了していない場合に該当する。
+     * 該当する間はexecuteを呼び出しても進まないため、async_handlerが呼ばれるまで実行を止めてよい。
+     * @return 進められるスレッドがない場合true
+     */
+    bool is_blocked() const;
+
     /**
      * 組み込み関数用に引数を取り出す(ポインタ)。
      * 読み出そうとした引数が格納された型と異なったり、オーバーフローした場合エラーとなる。
@@ -311,6 +410,27 @@ namespace processwarp {
      */
     vaddr_t reserve_func_addr();
 
+    /**
+     * スレッドが開始した非同期処理の状態を確認する。
+     * 組み込み関数の先頭で呼び出し、trueを戻した場合は処理を開始せずに戻る。
+     * 完了していない場合はスレッドを待ち状態にする。
+     * 完了している場合は結果をdstへ書き込み、スレッドから非同期処理を外す。
+     * @param thread 組み込み関数を呼び出したスレッド
+     * @param dst 結果の格納先(VADDR_NONの場合は格納しない)
+     * @return 非同期処理を開始済みの場合true
+     */
+    bool resume_async(Thread& thread, vaddr_t dst);
+
+    /**
+     * スレッドが開始した非同期処理の状態を確認する。
+     * 結果を仮想メモリの複数の場所へ書き戻す組み込み関数が使う。
+     * 完了している場合は結果をresultへ移し、スレッドから非同期処理を外す。
+     * @param thread 組み込み関数を呼び出したスレッド
+     * @param result 完了した場合に結果を受け取る
+     * @return 非同期処理を開始済みの場合true
+     */
+    bool resume_async(Thread& thread, std::vector<uint8_t>* result);
+
     /**
      * アプリケーションの初期設定をする。
      * エントリポイントに対するクロージャを作成し、実行可能な状態を作る。
@@ -339,10 +459,29 @@ namespace processwarp {
 
     /**
      * Setup of warp in
+     * Warp at any time is refused while the VM has more than one thread.
      * @param address target client id
+     * @return true if warp was set up
      */
     bool setup_warpin(const std::string& address);
 
+    /**
+     * 処理をホストのスレッドプールで開始し、スレッドを完了まで待ち状態にする。
+     * 組み込み関数は開始後に戻り、やり直した時にresume_asyncで結果を受け取る。
+     * @param thread 組み込み関数を呼び出したスレッド
+     * @param task 実行する処理、仮想メモリに触れずに結果だけを書き込む
+     */
+    void start_async_task(Thread& thread, const AsyncCall::Task& task);
+
+    /**
+     * 指定した時間が経過すると完了するタイマーを開始し、スレッドを完了まで待ち状態にする。
+     * @param thread 組み込み関数を呼び出したスレッド
+     * @param duration 完了までの時間
+     * @param result 完了時にdstへ書き込む結果
+     */
+    void start_async_timer(Thread& thread, AsyncCall::Clock::duration duration,
+			   const std::vector<uint8_t>& result);
+
     /**
      * 仮想アドレスに対応づくネイティブポインタを変更する。
      * @param addr 対象の仮想アドレス。
@@ -376,5 +515,12 @@ namespace processwarp {
      * @param len 埋めサイズ
      */
     void v_memset(vaddr_t dst, int c, size_t len);
+
+    /**
+     * 通常の関数の命令列を検証し、検証状態を設定する。
+     * 定数領域が展開済みである必要がある。
+     * @param func 検証対象の関数
+     */
+    void verify_function(FuncStore& func);
   };
 }
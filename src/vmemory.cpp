@@ -10,7 +10,7 @@
 
 using namespace processwarp;
 
-static const vaddr_t UPPER_MASKS[] = {
+const vaddr_t VMemory::UPPER_MASKS[] = {
   0xFFFFFFFFFFFFFFFF, // 型
   0xFFFFFFFFFFFFFF00,
   0xFFFFFFFFFFFF0000,
@@ -48,6 +48,11 @@ static const int LOWER_BITS[] = {
   0, // 関数
 };
 
+// ページテーブルで引く番号として、アドレスのupper部分から先頭4bitを除いた値を取り出す。
+static vaddr_t get_page_index(vaddr_t addr) {
+  return (addr & ~static_cast<vaddr_t>(AddrType::AD_MASK)) >> LOWER_BITS[addr >> 60];
+}
+
 /**
  * 空いているaddressを割り当てる。
  * アドレス指定がVADDR_NON以外かつ、reservedに同一アドレスが指定されていた場合、
@@ -102,15 +107,41 @@ vaddr_t assign_addr(std::map<vaddr_t, T>& store_map,
 }
  
 // コンストラクタ。
-VMemory::VMemory() {
+VMemory::VMemory() :
+  is_owned(false),
+  generation(1) {
   for (unsigned int i = 0; i < sizeof(last_free) / sizeof(last_free[0]); i ++) {
     last_free[i] = 1;
   }
+  // キャッシュを空にする
+  for (auto& entry : translation_cache) {
+    entry.upper = TRANSLATION_EMPTY;
+    entry.head  = nullptr;
+  }
+  for (auto& entry : func_cache) {
+    entry.addr  = VADDR_NON;
+    entry.store = nullptr;
+  }
+  for (auto& entry : type_cache) {
+    entry.addr  = VADDR_NON;
+    entry.store = nullptr;
+  }
+  for (auto& root : page_roots) {
+    root.table  = nullptr;
+    root.height = 0;
+  }
 
   // 基本型の最大を初期値にセット
   last_free[AddrType::AD_TYPE >> 60] = BasicType::TY_MAX + 1;
 }
 
+// デストラクタ。
+VMemory::~VMemory() {
+  for (auto& root : page_roots) {
+    if (root.table != nullptr) free_page_table(root.table, root.height);
+  }
+}
+
 // アドレスが関数領域のものかどうか調べる。
 bool VMemory::addr_is_func(vaddr_t addr) {
   return (addr & AddrType::AD_MASK) == AddrType::AD_FUNCTION;
@@ -130,13 +161,8 @@ bool VMemory::addr_is_used(vaddr_t addr) {
     return type_store_map.find(addr) != type_store_map.end();
 
   } else {
-    auto data = data_store_map.find(get_addr_upper(addr));
-    if (data == data_store_map.end()) {
-      return false;
-
-    } else {
-      return get_addr_lower(addr) < data->second.size;
-    }
+    DataStore* data = find_data(addr);
+    return data != nullptr && get_addr_lower(addr) < data->size;
   }
 }
 
@@ -160,7 +186,9 @@ DataStore& VMemory::alloc_data(uint64_t size, bool is_const, vaddr_t addr) {
   // 空きアドレスの検索
   addr = assign_addr(data_store_map, data_reserved, type, &last_free[type >> 60], addr);
   
-  return data_store_map.insert(std::make_pair(addr, DataStore(addr, size))).first->second;
+  DataStore& data = data_store_map.insert(std::make_pair(addr, DataStore(addr, size))).first->second;
+  map_data(addr, &data);
+  return data;
 }
 
 // メモリ空間に新しい通常の関数領域を確保する。
@@ -290,19 +318,78 @@ TypeStore& VMemory::alloc_type_vector(uint64_t size,
     first->second;
 }
 
+// アドレスに対応するデータ領域をページテーブルから探す。
+DataStore* VMemory::find_data(vaddr_t addr) const {
+  const PageRoot& root = page_roots[addr >> 60];
+  vaddr_t index = get_page_index(addr);
+  // 根の段数で引ける範囲を超える番号の領域は登録されていない
+  if (root.table == nullptr || (index >> (PAGE_TABLE_BITS * root.height)) != 0) {
+    return nullptr;
+  }
+
+  const PageTable* table = root.table;
+  for (unsigned int level = root.height - 1; level > 0; level --) {
+    table = table->entries[(index >> (PAGE_TABLE_BITS * level)) & PAGE_TABLE_MASK].table;
+    if (table == nullptr) return nullptr;
+  }
+  return table->entries[index & PAGE_TABLE_MASK].store;
+}
+
+// アドレスに対応する関数領域をmapから探す。
+FuncStore& VMemory::find_func(vaddr_t addr) {
+  auto func = func_store_map.find(addr);
+
+  // 検索失敗 = アクセス違反
+  if (func == func_store_map.end()) {
+    throw_error_message(Error::SEGMENT_FAULT, Util::vaddr2str(addr));
+  }
+  
+  return func->second;
+}
+
+// アドレスに対応する型領域をmapから探す。
+TypeStore& VMemory::find_type(vaddr_t addr) {
+  auto type = type_store_map.find(addr);
+
+  // 検索失敗 = アクセス違反
+  if (type == type_store_map.end()) {
+    throw_error_message(Error::SEGMENT_FAULT, Util::vaddr2str(addr));
+  }
+
+  return type->second;
+}
+
 // 指定されたデータ領域を開放する。
 void VMemory::free(vaddr_t addr) {
   if (addr != VADDR_NULL) {
     // アドレスが領域の先頭でなかったり、存在しないアドレスの場合、セグメンテーションフォルト
-    if (addr != get_addr_upper(addr) ||
-	data_store_map.find(addr) == data_store_map.end()) {
+    if (addr != get_addr_upper(addr) || find_data(addr) == nullptr) {
       throw_error_message(Error::SEGMENT_FAULT, Util::vaddr2str(addr));
     }
     // 開放
+    unmap_data(addr);
     data_store_map.erase(addr);
+    // 変換キャッシュは開放した領域の要素だけを無効にする
+    TranslationEntry& entry = translation_cache[get_cache_index(addr)];
+    if (entry.upper == addr) {
+      entry.upper = TRANSLATION_EMPTY;
+      entry.head  = nullptr;
+    }
+    // 開放した領域を指すStackInfoのキャッシュを無効にする
+    generation ++;
   }
 }
 
+// ページテーブルの段と、その下の段を全て開放する。
+void VMemory::free_page_table(PageTable* table, unsigned int height) {
+  if (height > 1) {
+    for (auto& entry : table->entries) {
+      if (entry.table != nullptr) free_page_table(entry.table, height - 1);
+    }
+  }
+  delete table;
+}
+
 // アドレスのupper部分を取り出す。
 vaddr_t VMemory::get_addr_upper(vaddr_t addr) {
   return addr & UPPER_MASKS[addr >> 60];
@@ -332,38 +419,49 @@ std::set<vaddr_t> VMemory::get_alladdr() {
 
 // アドレスに対応する領域を取得する。
 DataStore& VMemory::get_data(vaddr_t addr) {
-  auto data = data_store_map.find(get_addr_upper(addr));
+  DataStore* data = find_data(addr);
 
   // 検索失敗 = アクセス違反
-  if (data == data_store_map.end()) {
+  if (data == nullptr) {
     throw_error_message(Error::SEGMENT_FAULT, Util::vaddr2str(addr));
   }
   
-  return data->second;
+  return *data;
 }
 
-// アドレスに対応する関数領域を取得する。
-FuncStore& VMemory::get_func(vaddr_t addr) {
-  auto func = func_store_map.find(addr);
+// データ領域をページテーブルに登録する。
+void VMemory::map_data(vaddr_t addr, DataStore* store) {
+  PageRoot& root = page_roots[addr >> 60];
+  vaddr_t index = get_page_index(addr);
 
-  // 検索失敗 = アクセス違反
-  if (func == func_store_map.end()) {
-    throw_error_message(Error::SEGMENT_FAULT, Util::vaddr2str(addr));
+  if (root.table == nullptr) {
+    root.table  = new PageTable();
+    root.height = 1;
+  }
+  // 番号が収まるまで、今の最上位の段を先頭の要素とする段を上に重ねる
+  while ((index >> (PAGE_TABLE_BITS * root.height)) != 0) {
+    assert(root.height < PAGE_TABLE_MAX_HEIGHT);
+    PageTable* upper = new PageTable();
+    upper->entries[0].table = root.table;
+    upper->used = 1;
+    root.table = upper;
+    root.height ++;
   }
-  
-  return func->second;
-}
-
-// アドレスに対応する型領域を取得する。
-TypeStore& VMemory::get_type(vaddr_t addr) {
-  auto type = type_store_map.find(addr);
 
-  // 検索失敗 = アクセス違反
-  if (type == type_store_map.end()) {
-    throw_error_message(Error::SEGMENT_FAULT, Util::vaddr2str(addr));
+  PageTable* table = root.table;
+  for (unsigned int level = root.height - 1; level > 0; level --) {
+    PageTable::Entry& entry = table->entries[(index >> (PAGE_TABLE_BITS * level)) & PAGE_TABLE_MASK];
+    if (entry.table == nullptr) {
+      entry.table = new PageTable();
+      table->used ++;
+    }
+    table = entry.table;
   }
 
-  return type->second;
+  PageTable::Entry& entry = table->entries[index & PAGE_TABLE_MASK];
+  assert(entry.store == nullptr);
+  entry.store = store;
+  table->used ++;
 }
 
 // データアドレスを予約する。
@@ -384,3 +482,31 @@ vaddr_t VMemory::reserve_func_addr() {
 
   return addr;
 }
+
+// データ領域をページテーブルから除去し、空になった段を開放する。
+void VMemory::unmap_data(vaddr_t addr) {
+  PageRoot& root = page_roots[addr >> 60];
+  vaddr_t index = get_page_index(addr);
+
+  // 根から最後の段までの経路を記録する
+  PageTable* path[PAGE_TABLE_MAX_HEIGHT];
+  PageTable* table = root.table;
+  for (unsigned int level = root.height - 1; level > 0; level --) {
+    path[level] = table;
+    table = table->entries[(index >> (PAGE_TABLE_BITS * level)) & PAGE_TABLE_MASK].table;
+  }
+  path[0] = table;
+
+  // 最後の段から要素を外し、空になった段は開放して上の段からも外す
+  for (unsigned int level = 0; level < root.height; level ++) {
+    PageTable* it = path[level];
+    it->entries[(index >> (PAGE_TABLE_BITS * level)) & PAGE_TABLE_MASK].table = nullptr;
+    it->used --;
+    if (it->used != 0) return;
+    delete it;
+  }
+
+  // 全ての段が空になった
+  root.table  = nullptr;
+  root.height = 0;
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <cassert>
 #include <map>
 #include <memory>
@@ -14,15 +15,56 @@
 namespace processwarp {
   /**
    * 仮想メモリ空間を管理するクラス。
+   * データ領域はアドレスの先頭4bitごとのページテーブルで引き、mapは確保と列挙にだけ使う。
+   * ロックを持たないため、1つのVMemoryを同時に操作するのは1つのスレッドだけでなければならない。
+   * Controllerはプロセスのmutexをとっている間だけVMを実行、変更することでこれを守り、
+   * VMachine::executeはOwnerでこれを確認する。
    */
   class VMemory {
   public:
+    /**
+     * 1つのスレッドが仮想メモリを操作している区間を示すクラス。
+     * 区間が他のスレッドの区間と重なった場合はassertで停止する。
+     */
+    class Owner {
+    public:
+      /**
+       * コンストラクタ。
+       * 仮想メモリを操作中の状態にする。
+       * @param vmemory_ 操作する仮想メモリ。
+       */
+      explicit Owner(VMemory& vmemory_) :
+	vmemory(vmemory_) {
+	bool was_owned = vmemory.is_owned.exchange(true);
+	assert(!was_owned);
+	(void)was_owned;
+      }
+
+      /**
+       * デストラクタ。
+       * 仮想メモリを操作中の状態を解除する。
+       */
+      ~Owner() {
+	vmemory.is_owned.store(false);
+      }
+
+    private:
+      /** 操作する仮想メモリ */
+      VMemory& vmemory;
+    };
+
     /**
      * コンストラクタ。
      * 空きメモリの初期化などを行う。
      */
     VMemory();
 
+    /**
+     * デストラクタ。
+     * ページテーブルを開放する。
+     */
+    ~VMemory();
+
     /**
      * アドレスが関数領域のものかどうか調べる。
      * @param addr 調査対象アドレス。
@@ -177,6 +219,15 @@ namespace processwarp {
      */
     void free(vaddr_t addr);
 
+    /**
+     * 領域の開放によって更新される世代番号を取得する。
+     * 世代番号が変わっていなければ、以前に取得した領域へのポインタは有効である。
+     * @return 世代番号
+     */
+    uint64_t get_generation() const {
+      return generation;
+    }
+
     /**
      * アドレスのupper部分を取り出す。
      * @param addr アドレス
@@ -204,19 +255,52 @@ namespace processwarp {
      */
     DataStore& get_data(vaddr_t addr);
 
+    /**
+     * アドレスが指すデータ領域上の実アドレスを取得する。
+     * 最近参照した領域は変換キャッシュから引き、ページテーブルの探索を省略する。
+     * 変換キャッシュは開放された領域の要素だけを無効にするため、他の領域の開放の影響を受けない。
+     * @param addr 仮想アドレス。
+     * @return アドレスに対応する実アドレス。
+     */
+    uint8_t* get_data_ptr(vaddr_t addr) {
+      vaddr_t upper = addr & UPPER_MASKS[addr >> 60];
+      TranslationEntry& entry = translation_cache[get_cache_index(upper)];
+      if (entry.upper != upper) {
+	entry.head  = get_data(addr).head.get();
+	entry.upper = upper;
+      }
+      return entry.head + (addr - upper);
+    }
+
     /**
      * アドレスに対応する関数領域を取得する。
+     * 関数領域は開放されないため、一度引いた領域は検索キャッシュから引き続ける。
      * @param addr 仮想アドレス。
      * @return アドレスに対応する関数領域。
      */
-    FuncStore& get_func(vaddr_t addr);
+    FuncStore& get_func(vaddr_t addr) {
+      LookupEntry<FuncStore>& entry = func_cache[get_cache_index(addr)];
+      if (entry.addr != addr || entry.store == nullptr) {
+	entry.store = &find_func(addr);
+	entry.addr  = addr;
+      }
+      return *entry.store;
+    }
 
     /**
      * アドレスに対応する型領域を取得する。
+     * 型領域は開放されないため、一度引いた領域は検索キャッシュから引き続ける。
      * @param addr 仮想アドレス。
      * @return アドレスに対応する型領域。
      */
-    TypeStore& get_type(vaddr_t addr);
+    TypeStore& get_type(vaddr_t addr) {
+      LookupEntry<TypeStore>& entry = type_cache[get_cache_index(addr)];
+      if (entry.addr != addr || entry.store == nullptr) {
+	entry.store = &find_type(addr);
+	entry.addr  = addr;
+      }
+      return *entry.store;
+    }
 
     /**
      * データアドレスを予約する。
@@ -234,6 +318,66 @@ namespace processwarp {
     vaddr_t reserve_func_addr();
 
   private:
+    /** いずれかのスレッドが操作中の場合true */
+    std::atomic<bool> is_owned;
+    /** 変換キャッシュ、検索キャッシュの要素数のビット数 */
+    static const unsigned int TRANSLATION_CACHE_BITS = 6;
+    /**
+     * 変換キャッシュの空き要素を表すupper部分。
+     * 先頭4bitがdummyのアドレスのupper部分は0になるため、変換の結果として現れない。
+     */
+    static const vaddr_t TRANSLATION_EMPTY = 0x7000000000000000;
+
+    /** 仮想アドレスのupper部分から実アドレスへの変換キャッシュの要素 */
+    struct TranslationEntry {
+      /** 仮想アドレスのupper部分 */
+      vaddr_t upper;
+      /** データ領域の先頭の実アドレス */
+      uint8_t* head;
+    };
+
+    /** ページテーブルの1段で引くupper部分のビット数 */
+    static const unsigned int PAGE_TABLE_BITS = 8;
+    /** ページテーブルの段数の最大値(upper部分の最大52bitを引ける段数) */
+    static const unsigned int PAGE_TABLE_MAX_HEIGHT = 7;
+    /** ページテーブルの1段で引く番号を取り出すマスク */
+    static const vaddr_t PAGE_TABLE_MASK = (1 << PAGE_TABLE_BITS) - 1;
+
+    /**
+     * データ領域のページテーブルの1段。
+     * upper部分の番号を上位の段からPAGE_TABLE_BITSずつ引き、最後の段でデータ領域を得る。
+     */
+    struct PageTable {
+      /** 最後の段ではデータ領域、それ以外の段では下の段、nullptrの場合は空き要素 */
+      union Entry {
+	PageTable* table;
+	DataStore* store;
+      };
+      /** 要素 */
+      Entry entries[1 << PAGE_TABLE_BITS];
+      /** 空きでない要素の数、0になった段は開放する */
+      unsigned int used;
+    };
+
+    /** アドレスの先頭4bitごとのページテーブルの根 */
+    struct PageRoot {
+      /** 最上位の段、nullptrの場合はデータ領域がない */
+      PageTable* table;
+      /** 段数、番号が収まらない領域を登録する時に上へ段を重ねる */
+      unsigned int height;
+    };
+
+    /** 仮想アドレスから関数領域、型領域への検索キャッシュの要素 */
+    template<class T> struct LookupEntry {
+      /** 仮想アドレス */
+      vaddr_t addr;
+      /** 領域、nullptrの場合は空き要素 */
+      T* store;
+    };
+
+    /** アドレスの先頭4bitごとの、upper部分を取り出すマスク */
+    static const vaddr_t UPPER_MASKS[0x10];
+
     /** メモリ空間のもつデータ領域一覧(仮想アドレス→データ領域) */
     std::map<vaddr_t, DataStore> data_store_map;
     /** データ領域として予約されたアドレス一覧 */
@@ -249,5 +393,65 @@ namespace processwarp {
     
     /** 空きアドレス */
     vaddr_t last_free[0x10];
+    /** 領域の開放ごとに更新する世代番号(0は未解決を表すため利用しない) */
+    uint64_t generation;
+    /** アドレスの先頭4bitごとの、データ領域のページテーブル */
+    PageRoot page_roots[0x10];
+    /** 仮想アドレスから実アドレスへの変換キャッシュ */
+    TranslationEntry translation_cache[1 << TRANSLATION_CACHE_BITS];
+    /** 仮想アドレスから関数領域への検索キャッシュ */
+    LookupEntry<FuncStore> func_cache[1 << TRANSLATION_CACHE_BITS];
+    /** 仮想アドレスから型領域への検索キャッシュ */
+    LookupEntry<TypeStore> type_cache[1 << TRANSLATION_CACHE_BITS];
+
+    /**
+     * アドレスに対応するデータ領域をページテーブルから探す。
+     * @param addr 仮想アドレス。
+     * @return アドレスに対応するデータ領域、ない場合はnullptr。
+     */
+    DataStore* find_data(vaddr_t addr) const;
+
+    /**
+     * アドレスに対応する関数領域をmapから探す。
+     * @param addr 仮想アドレス。
+     * @return アドレスに対応する関数領域。
+     */
+    FuncStore& find_func(vaddr_t addr);
+
+    /**
+     * アドレスに対応する型領域をmapから探す。
+     * @param addr 仮想アドレス。
+     * @return アドレスに対応する型領域。
+     */
+    TypeStore& find_type(vaddr_t addr);
+
+    /**
+     * ページテーブルの段と、その下の段を全て開放する。
+     * @param table 開放する段
+     * @param height 段以下の段数
+     */
+    static void free_page_table(PageTable* table, unsigned int height);
+
+    /**
+     * データ領域をページテーブルに登録する。
+     * @param addr データ領域の先頭の仮想アドレス。
+     * @param store 登録するデータ領域。
+     */
+    void map_data(vaddr_t addr, DataStore* store);
+
+    /**
+     * データ領域をページテーブルから除去し、空になった段を開放する。
+     * @param addr 登録済みのデータ領域の先頭の仮想アドレス。
+     */
+    void unmap_data(vaddr_t addr);
+
+    /**
+     * キャッシュの要素の位置を、アドレスのハッシュ値から計算する。
+     * @param addr 仮想アドレス、またはupper部分。
+     * @return キャッシュの要素の位置。
+     */
+    static unsigned int get_cache_index(vaddr_t addr) {
+      return (addr * 0x9E3779B97F4A7C15ULL) >> (64 - TRANSLATION_CACHE_BITS);
+    }
   };
 }
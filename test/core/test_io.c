@@ -0,0 +1,18 @@
+// lib_filterにpipe、read、writeを登録して実行する。
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+int main() {
+  int fds[2];
+  char buf[8] = {0};
+  long w, r;
+
+  pipe(fds);
+  w = write(fds[1], "abc", 3);
+  // 格納先の大きさまでしか読み込まない
+  r = read(fds[0], buf, SIZE_MAX);
+
+  printf("%ld %ld %s %ld\n", w, r, buf, (long)read(-1, buf, 1));
+  return 0;
+}
@@ -0,0 +1,43 @@
+; ModuleID = 'test_io.bc'
+target datalayout = "e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+@.str = private unnamed_addr constant [4 x i8] c"abc\00", align 1
+@.str1 = private unnamed_addr constant [16 x i8] c"%ld %ld %s %ld\0A\00", align 1
+
+; Function Attrs: nounwind uwtable
+define i32 @main() #0 {
+  %fds = alloca [2 x i32], align 4
+  %buf = alloca [8 x i8], align 1
+  %1 = getelementptr inbounds [8 x i8]* %buf, i64 0, i64 0
+  %2 = bitcast [8 x i8]* %buf to i64*
+  store i64 0, i64* %2, align 1
+  %3 = getelementptr inbounds [2 x i32]* %fds, i64 0, i64 0
+  %4 = call i32 @pipe(i32* %3) #2
+  %5 = getelementptr inbounds [2 x i32]* %fds, i64 0, i64 1
+  %6 = load i32* %5, align 4
+  %7 = call i64 @write(i32 %6, i8* getelementptr inbounds ([4 x i8]* @.str, i64 0, i64 0), i64 3) #2
+  %8 = load i32* %3, align 4
+  %9 = call i64 @read(i32 %8, i8* %1, i64 -1) #2
+  %10 = call i64 @read(i32 -1, i8* %1, i64 1) #2
+  %11 = call i32 (i8*, ...)* @printf(i8* getelementptr inbounds ([16 x i8]* @.str1, i64 0, i64 0), i64 %7, i64 %9, i8* %1, i64 %10) #2
+  ret i32 0
+}
+
+; Function Attrs: nounwind
+declare i32 @pipe(i32*) #1
+
+declare i64 @write(i32, i8* nocapture readonly, i64) #1
+
+declare i64 @read(i32, i8* nocapture, i64) #1
+
+; Function Attrs: nounwind
+declare i32 @printf(i8* nocapture readonly, ...) #1
+
+attributes #0 = { nounwind uwtable "less-precise-fpmad"="false" "no-frame-pointer-elim"="false" "no-infs-fp-math"="false" "no-nans-fp-math"="false" "stack-protector-buffer-size"="8" "unsafe-fp-math"="false" "use-soft-float"="false" }
+attributes #1 = { "less-precise-fpmad"="false" "no-frame-pointer-elim"="false" "no-infs-fp-math"="false" "no-nans-fp-math"="false" "stack-protector-buffer-size"="8" "unsafe-fp-math"="false" "use-soft-float"="false" }
+attributes #2 = { nounwind }
+
+!llvm.ident = !{!0}
+
+!0 = metadata !{metadata !"Ubuntu clang version 3.4-1ubuntu3 (tags/RELEASE_34/final) (based on LLVM 3.4)"}
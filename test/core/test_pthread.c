@@ -0,0 +1,33 @@
+#include <pthread.h>
+#include <stdio.h>
+
+#define LOOP_COUNT 10000
+
+pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+// 最適化阻止
+long counter = 0;
+
+static void* count_up(void* arg) {
+  int i;
+  for (i = 0; i < LOOP_COUNT; i++) {
+    pthread_mutex_lock(&mutex);
+    counter++;
+    pthread_mutex_unlock(&mutex);
+  }
+  return arg;
+}
+
+int main() {
+  pthread_t th1, th2;
+  long id1 = 1;
+  long id2 = 2;
+  void* ret1;
+  void* ret2;
+
+  pthread_create(&th1, NULL, count_up, &id1);
+  pthread_create(&th2, NULL, count_up, &id2);
+  pthread_join(th1, &ret1);
+  pthread_join(th2, &ret2);
+  printf("%ld %ld %ld\n", counter, *(long*)ret1, *(long*)ret2);
+  return 0;
+}
@@ -0,0 +1,82 @@
+; ModuleID = 'test_pthread.bc'
+target datalayout = "e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+%union.pthread_mutex_t = type { %struct.__pthread_mutex_s }
+%struct.__pthread_mutex_s = type { i32, i32, i32, i32, i32, i16, i16, %struct.__pthread_internal_list }
+%struct.__pthread_internal_list = type { %struct.__pthread_internal_list*, %struct.__pthread_internal_list* }
+%union.pthread_attr_t = type { i64, [48 x i8] }
+
+@mutex = global %union.pthread_mutex_t zeroinitializer, align 8
+@counter = global i64 0, align 8
+@.str = private unnamed_addr constant [13 x i8] c"%ld %ld %ld\0A\00", align 1
+
+; Function Attrs: nounwind uwtable
+define i32 @main() #0 {
+  %th1 = alloca i64, align 8
+  %th2 = alloca i64, align 8
+  %id1 = alloca i64, align 8
+  %id2 = alloca i64, align 8
+  %ret1 = alloca i8*, align 8
+  %ret2 = alloca i8*, align 8
+  store i64 1, i64* %id1, align 8
+  store i64 2, i64* %id2, align 8
+  %1 = bitcast i64* %id1 to i8*
+  %2 = call i32 @pthread_create(i64* %th1, %union.pthread_attr_t* null, i8* (i8*)* @count_up, i8* %1) #2
+  %3 = bitcast i64* %id2 to i8*
+  %4 = call i32 @pthread_create(i64* %th2, %union.pthread_attr_t* null, i8* (i8*)* @count_up, i8* %3) #2
+  %5 = load i64* %th1, align 8
+  %6 = call i32 @pthread_join(i64 %5, i8** %ret1) #2
+  %7 = load i64* %th2, align 8
+  %8 = call i32 @pthread_join(i64 %7, i8** %ret2) #2
+  %9 = load i64* @counter, align 8
+  %10 = load i8** %ret1, align 8
+  %11 = bitcast i8* %10 to i64*
+  %12 = load i64* %11, align 8
+  %13 = load i8** %ret2, align 8
+  %14 = bitcast i8* %13 to i64*
+  %15 = load i64* %14, align 8
+  %16 = call i32 (i8*, ...)* @printf(i8* getelementptr inbounds ([13 x i8]* @.str, i64 0, i64 0), i64 %9, i64 %12, i64 %15) #2
+  ret i32 0
+}
+
+; Function Attrs: nounwind
+declare i32 @pthread_create(i64*, %union.pthread_attr_t*, i8* (i8*)*, i8*) #1
+
+; Function Attrs: nounwind uwtable
+define internal i8* @count_up(i8* readnone %arg) #0 {
+  br label %1
+
+; <label>:1                                       ; preds = %1, %0
+  %i.01 = phi i32 [ 0, %0 ], [ %6, %1 ]
+  %2 = call i32 @pthread_mutex_lock(%union.pthread_mutex_t* @mutex) #2
+  %3 = load i64* @counter, align 8
+  %4 = add nsw i64 %3, 1
+  store i64 %4, i64* @counter, align 8
+  %5 = call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* @mutex) #2
+  %6 = add nsw i32 %i.01, 1
+  %exitcond = icmp eq i32 %6, 10000
+  br i1 %exitcond, label %7, label %1
+
+; <label>:7                                       ; preds = %1
+  ret i8* %arg
+}
+
+declare i32 @pthread_join(i64, i8**) #1
+
+; Function Attrs: nounwind
+declare i32 @printf(i8* nocapture readonly, ...) #1
+
+; Function Attrs: nounwind
+declare i32 @pthread_mutex_lock(%union.pthread_mutex_t*) #1
+
+; Function Attrs: nounwind
+declare i32 @pthread_mutex_unlock(%union.pthread_mutex_t*) #1
+
+attributes #0 = { nounwind uwtable "less-precise-fpmad"="false" "no-frame-pointer-elim"="false" "no-infs-fp-math"="false" "no-nans-fp-math"="false" "stack-protector-buffer-size"="8" "unsafe-fp-math"="false" "use-soft-float"="false" }
+attributes #1 = { nounwind "less-precise-fpmad"="false" "no-frame-pointer-elim"="false" "no-infs-fp-math"="false" "no-nans-fp-math"="false" "stack-protector-buffer-size"="8" "unsafe-fp-math"="false" "use-soft-float"="false" }
+attributes #2 = { nounwind }
+
+!llvm.ident = !{!0}
+
+!0 = metadata !{metadata !"Ubuntu clang version 3.4-1ubuntu3 (tags/RELEASE_34/final) (based on LLVM 3.4)"}
@@ -0,0 +1,29 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+// 最適化阻止
+volatile int done = 0;
+
+static void* set_done(void* arg) {
+  done = 1;
+  return arg;
+}
+
+int main() {
+  pthread_t th;
+  struct timespec req = {0, 1000000};
+  struct timespec bad = {0, 1000000000};
+
+  // 待っている間も他のスレッドが進む
+  pthread_create(&th, NULL, set_done, NULL);
+  while (!done) {
+    usleep(1000);
+  }
+  pthread_join(th, NULL);
+
+  printf("%d %d %d %u\n", done,
+	 nanosleep(&req, NULL), nanosleep(&bad, NULL), sleep(0));
+  return 0;
+}
@@ -0,0 +1,72 @@
+; ModuleID = 'test_sleep.bc'
+target datalayout = "e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+%struct.timespec = type { i64, i64 }
+%union.pthread_attr_t = type { i64, [48 x i8] }
+
+@done = global i32 0, align 4
+@.str = private unnamed_addr constant [13 x i8] c"%d %d %d %u\0A\00", align 1
+
+; Function Attrs: nounwind uwtable
+define i32 @main() #0 {
+  %th = alloca i64, align 8
+  %req = alloca %struct.timespec, align 8
+  %bad = alloca %struct.timespec, align 8
+  %1 = getelementptr inbounds %struct.timespec* %req, i64 0, i32 0
+  store i64 0, i64* %1, align 8
+  %2 = getelementptr inbounds %struct.timespec* %req, i64 0, i32 1
+  store i64 1000000, i64* %2, align 8
+  %3 = getelementptr inbounds %struct.timespec* %bad, i64 0, i32 0
+  store i64 0, i64* %3, align 8
+  %4 = getelementptr inbounds %struct.timespec* %bad, i64 0, i32 1
+  store i64 1000000000, i64* %4, align 8
+  %5 = call i32 @pthread_create(i64* %th, %union.pthread_attr_t* null, i8* (i8*)* @set_done, i8* null) #2
+  %6 = load volatile i32* @done, align 4
+  %7 = icmp eq i32 %6, 0
+  br i1 %7, label %.lr.ph, label %._crit_edge
+
+.lr.ph:                                           ; preds = %0, %.lr.ph
+  %8 = call i32 @usleep(i32 1000) #2
+  %9 = load volatile i32* @done, align 4
+  %10 = icmp eq i32 %9, 0
+  br i1 %10, label %.lr.ph, label %._crit_edge
+
+._crit_edge:                                      ; preds = %.lr.ph, %0
+  %11 = load i64* %th, align 8
+  %12 = call i32 @pthread_join(i64 %11, i8** null) #2
+  %13 = load volatile i32* @done, align 4
+  %14 = call i32 @nanosleep(%struct.timespec* %req, %struct.timespec* null) #2
+  %15 = call i32 @nanosleep(%struct.timespec* %bad, %struct.timespec* null) #2
+  %16 = call i32 @sleep(i32 0) #2
+  %17 = call i32 (i8*, ...)* @printf(i8* getelementptr inbounds ([13 x i8]* @.str, i64 0, i64 0), i32 %13, i32 %14, i32 %15, i32 %16) #2
+  ret i32 0
+}
+
+; Function Attrs: nounwind
+declare i32 @pthread_create(i64*, %union.pthread_attr_t*, i8* (i8*)*, i8*) #1
+
+; Function Attrs: nounwind uwtable
+define internal noalias i8* @set_done(i8* nocapture readnone %arg) #0 {
+  store volatile i32 1, i32* @done, align 4
+  ret i8* null
+}
+
+declare i32 @usleep(i32) #1
+
+declare i32 @pthread_join(i64, i8**) #1
+
+declare i32 @nanosleep(%struct.timespec*, %struct.timespec*) #1
+
+declare i32 @sleep(i32) #1
+
+; Function Attrs: nounwind
+declare i32 @printf(i8* nocapture readonly, ...) #1
+
+attributes #0 = { nounwind uwtable "less-precise-fpmad"="false" "no-frame-pointer-elim"="false" "no-infs-fp-math"="false" "no-nans-fp-math"="false" "stack-protector-buffer-size"="8" "unsafe-fp-math"="false" "use-soft-float"="false" }
+attributes #1 = { "less-precise-fpmad"="false" "no-frame-pointer-elim"="false" "no-infs-fp-math"="false" "no-nans-fp-math"="false" "stack-protector-buffer-size"="8" "unsafe-fp-math"="false" "use-soft-float"="false" }
+attributes #2 = { nounwind }
+
+!llvm.ident = !{!0}
+
+!0 = metadata !{metadata !"Ubuntu clang version 3.4-1ubuntu3 (tags/RELEASE_34/final) (based on LLVM 3.4)"}
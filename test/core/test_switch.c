@@ -0,0 +1,51 @@
+#include <stdio.h>
+
+// 最適化阻止
+long values[] = {-1, 0, 1, 2, 3, 4, 5, 6, 7, 100, 1000, 100000, 1099511627776};
+__int128 wide_values[] = {0, 3, (__int128)1 << 100};
+
+// 分岐表(4は欠番)
+__attribute__((noinline)) long dense(long n, long x) {
+  switch (n) {
+  case 0: return x + 1;
+  case 1: return x - 1;
+  case 2: return x * 3;
+  case 3: return x / 2;
+  case 5: return x << 2;
+  case 6: return x ^ 7;
+  default: return 0;
+  }
+}
+
+// 二分探索
+__attribute__((noinline)) long sparse(long n, long x) {
+  switch (n) {
+  case -1: return x + 2;
+  case 1: return x - 2;
+  case 100: return x * 5;
+  case 1000: return x / 3;
+  case 100000: return x % 7;
+  case 1099511627776: return x << 3;
+  default: return -1;
+  }
+}
+
+// 64bitを超える整数
+__attribute__((noinline)) int wide(__int128 n, int x) {
+  switch (n) {
+  case 3: return x + 3;
+  case (__int128)1 << 100: return x * 100;
+  default: return x;
+  }
+}
+
+int main() {
+  int i;
+  for (i = 0; i < sizeof(values) / sizeof(values[0]); i ++) {
+    printf("%ld %ld\n", dense(values[i], 40), sparse(values[i], 40));
+  }
+  for (i = 0; i < sizeof(wide_values) / sizeof(wide_values[0]); i ++) {
+    printf("%d\n", wide(wide_values[i], 40));
+  }
+  return 0;
+}
@@ -0,0 +1,156 @@
+; ModuleID = 'test_switch.bc'
+target datalayout = "e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+@values = global [13 x i64] [i64 -1, i64 0, i64 1, i64 2, i64 3, i64 4, i64 5, i64 6, i64 7, i64 100, i64 1000, i64 100000, i64 1099511627776], align 16
+@wide_values = global [3 x i128] [i128 0, i128 3, i128 1267650600228229401496703205376], align 16
+@.str = private unnamed_addr constant [9 x i8] c"%ld %ld\0A\00", align 1
+@.str1 = private unnamed_addr constant [4 x i8] c"%d\0A\00", align 1
+
+; Function Attrs: noinline nounwind readnone uwtable
+define i64 @dense(i64 %n, i64 %x) #0 {
+  switch i64 %n, label %11 [
+    i64 0, label %1
+    i64 1, label %3
+    i64 2, label %5
+    i64 3, label %7
+    i64 5, label %9
+    i64 6, label %10
+  ]
+
+; <label>:1                                       ; preds = %0
+  %2 = add nsw i64 %x, 1
+  br label %12
+
+; <label>:3                                       ; preds = %0
+  %4 = add nsw i64 %x, -1
+  br label %12
+
+; <label>:5                                       ; preds = %0
+  %6 = mul nsw i64 %x, 3
+  br label %12
+
+; <label>:7                                       ; preds = %0
+  %8 = sdiv i64 %x, 2
+  br label %12
+
+; <label>:9                                       ; preds = %0
+  %shl = shl i64 %x, 2
+  br label %12
+
+; <label>:10                                      ; preds = %0
+  %xor = xor i64 %x, 7
+  br label %12
+
+; <label>:11                                      ; preds = %0
+  br label %12
+
+; <label>:12                                      ; preds = %11, %10, %9, %7, %5, %3, %1
+  %.0 = phi i64 [ 0, %11 ], [ %xor, %10 ], [ %shl, %9 ], [ %8, %7 ], [ %6, %5 ], [ %4, %3 ], [ %2, %1 ]
+  ret i64 %.0
+}
+
+; Function Attrs: noinline nounwind readnone uwtable
+define i64 @sparse(i64 %n, i64 %x) #0 {
+  switch i64 %n, label %12 [
+    i64 -1, label %1
+    i64 1, label %3
+    i64 100, label %5
+    i64 1000, label %7
+    i64 100000, label %9
+    i64 1099511627776, label %11
+  ]
+
+; <label>:1                                       ; preds = %0
+  %2 = add nsw i64 %x, 2
+  br label %13
+
+; <label>:3                                       ; preds = %0
+  %4 = add nsw i64 %x, -2
+  br label %13
+
+; <label>:5                                       ; preds = %0
+  %6 = mul nsw i64 %x, 5
+  br label %13
+
+; <label>:7                                       ; preds = %0
+  %8 = sdiv i64 %x, 3
+  br label %13
+
+; <label>:9                                       ; preds = %0
+  %10 = srem i64 %x, 7
+  br label %13
+
+; <label>:11                                      ; preds = %0
+  %shl = shl i64 %x, 3
+  br label %13
+
+; <label>:12                                      ; preds = %0
+  br label %13
+
+; <label>:13                                      ; preds = %12, %11, %9, %7, %5, %3, %1
+  %.0 = phi i64 [ -1, %12 ], [ %shl, %11 ], [ %10, %9 ], [ %8, %7 ], [ %6, %5 ], [ %4, %3 ], [ %2, %1 ]
+  ret i64 %.0
+}
+
+; Function Attrs: noinline nounwind readnone uwtable
+define i32 @wide(i128 %n, i32 %x) #0 {
+  switch i128 %n, label %4 [
+    i128 3, label %1
+    i128 1267650600228229401496703205376, label %3
+  ]
+
+; <label>:1                                       ; preds = %0
+  %2 = add nsw i32 %x, 3
+  br label %4
+
+; <label>:3                                       ; preds = %0
+  %mul = mul nsw i32 %x, 100
+  br label %4
+
+; <label>:4                                       ; preds = %0, %3, %1
+  %.0 = phi i32 [ %mul, %3 ], [ %2, %1 ], [ %x, %0 ]
+  ret i32 %.0
+}
+
+; Function Attrs: nounwind uwtable
+define i32 @main() #1 {
+  br label %1
+
+; <label>:1                                       ; preds = %1, %0
+  %indvars.iv2 = phi i64 [ 0, %0 ], [ %indvars.iv.next3, %1 ]
+  %2 = getelementptr inbounds [13 x i64]* @values, i64 0, i64 %indvars.iv2
+  %3 = load i64* %2, align 8
+  %4 = tail call i64 @dense(i64 %3, i64 40)
+  %5 = load i64* %2, align 8
+  %6 = tail call i64 @sparse(i64 %5, i64 40)
+  %7 = tail call i32 (i8*, ...)* @printf(i8* getelementptr inbounds ([9 x i8]* @.str, i64 0, i64 0), i64 %4, i64 %6) #3
+  %indvars.iv.next3 = add nuw nsw i64 %indvars.iv2, 1
+  %exitcond4 = icmp eq i64 %indvars.iv.next3, 13
+  br i1 %exitcond4, label %.preheader, label %1
+
+.preheader:                                       ; preds = %1, %.preheader
+  %indvars.iv = phi i64 [ %indvars.iv.next, %.preheader ], [ 0, %1 ]
+  %8 = getelementptr inbounds [3 x i128]* @wide_values, i64 0, i64 %indvars.iv
+  %9 = load i128* %8, align 16
+  %10 = tail call i32 @wide(i128 %9, i32 40)
+  %11 = tail call i32 (i8*, ...)* @printf(i8* getelementptr inbounds ([4 x i8]* @.str1, i64 0, i64 0), i32 %10) #3
+  %indvars.iv.next = add nuw nsw i64 %indvars.iv, 1
+  %exitcond = icmp eq i64 %indvars.iv.next, 3
+  br i1 %exitcond, label %12, label %.preheader
+
+; <label>:12                                      ; preds = %.preheader
+  ret i32 0
+}
+
+; Function Attrs: nounwind
+declare i32 @printf(i8* nocapture readonly, ...) #2
+
+attributes #0 = { noinline nounwind readnone uwtable "less-precise-fpmad"="false" "no-frame-pointer-elim"="false" "no-infs-fp-math"="false" "no-nans-fp-math"="false" "stack-protector-buffer-size"="8" "unsafe-fp-math"="false" "use-soft-float"="false" }
+attributes #1 = { nounwind uwtable "less-precise-fpmad"="false" "no-frame-pointer-elim"="false" "no-infs-fp-math"="false" "no-nans-fp-math"="false" "stack-protector-buffer-size"="8" "unsafe-fp-math"="false" "use-soft-float"="false" }
+attributes #2 = { nounwind "less-precise-fpmad"="false" "no-frame-pointer-elim"="false" "no-infs-fp-math"="false" "no-nans-fp-math"="false" "stack-protector-buffer-size"="8" "unsafe-fp-math"="false" "use-soft-float"="false" }
+attributes #3 = { nounwind }
+
+!llvm.ident = !{!0}
+
+!0 = metadata !{metadata !"Ubuntu clang version 3.4-1ubuntu3 (tags/RELEASE_34/final) (based on LLVM 3.4)"}
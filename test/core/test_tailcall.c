@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+struct point {
+  long x;
+  long y;
+  long z;
+  long w;
+};
+
+// 最適化阻止
+int m_num = -42;
+
+int is_odd(unsigned int n);
+
+// 相互再帰(末尾呼び出しでスタックを消費しない)
+__attribute__((noinline)) int is_even(unsigned int n) {
+  if (n == 0) return 1;
+  return is_odd(n - 1);
+}
+
+__attribute__((noinline)) int is_odd(unsigned int n) {
+  if (n == 0) return 0;
+  return is_even(n - 1);
+}
+
+// 組み込み関数の末尾呼び出し
+__attribute__((noinline)) int call_abs(int n) {
+  return abs(n);
+}
+
+__attribute__((noinline)) long add3(long a, long b, long c) {
+  return a + b + c;
+}
+
+// byvalの引数を持つ末尾呼び出し(置き換えない)
+// 置き換えた場合、add3の呼び出しが開放済みのpを上書きする
+__attribute__((noinline)) long sum_point(struct point p) {
+  return add3(p.x, p.y, p.z) + p.w;
+}
+
+__attribute__((noinline)) long make_point(long d) {
+  struct point p = {d, d * 2, d * 3, d * 4};
+  return sum_point(p);
+}
+
+// 関数ポインタ経由の末尾呼び出し
+__attribute__((noinline)) int apply(int (*func)(unsigned int), unsigned int n) {
+  return func(n);
+}
+
+int main() {
+  printf("%d %d %d %ld %d %d\n",
+	 is_even(1000001), is_odd(777777), call_abs(m_num), make_point(10),
+	 apply(is_even, 100000), apply(is_odd, 100001));
+  return 0;
+}
@@ -0,0 +1,119 @@
+; ModuleID = 'test_tailcall.bc'
+target datalayout = "e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+%struct.point = type { i64, i64, i64, i64 }
+
+@m_num = global i32 -42, align 4
+@.str = private unnamed_addr constant [20 x i8] c"%d %d %d %ld %d %d\0A\00", align 1
+
+; Function Attrs: noinline nounwind readnone uwtable
+define i32 @is_even(i32 %n) #0 {
+  %1 = icmp eq i32 %n, 0
+  br i1 %1, label %4, label %2
+
+; <label>:2                                       ; preds = %0
+  %3 = add i32 %n, -1
+  %call = tail call i32 @is_odd(i32 %3)
+  ret i32 %call
+
+; <label>:4                                       ; preds = %0
+  ret i32 1
+}
+
+; Function Attrs: noinline nounwind readnone uwtable
+define i32 @is_odd(i32 %n) #0 {
+  %1 = icmp eq i32 %n, 0
+  br i1 %1, label %4, label %2
+
+; <label>:2                                       ; preds = %0
+  %3 = add i32 %n, -1
+  %call = tail call i32 @is_even(i32 %3)
+  ret i32 %call
+
+; <label>:4                                       ; preds = %0
+  ret i32 0
+}
+
+; Function Attrs: noinline nounwind readnone uwtable
+define i32 @call_abs(i32 %n) #0 {
+  %1 = tail call i32 @abs(i32 %n) #4
+  ret i32 %1
+}
+
+; Function Attrs: nounwind readnone
+declare i32 @abs(i32) #1
+
+; Function Attrs: noinline nounwind readnone uwtable
+define i64 @add3(i64 %a, i64 %b, i64 %c) #0 {
+  %1 = add nsw i64 %b, %a
+  %2 = add nsw i64 %1, %c
+  ret i64 %2
+}
+
+; Function Attrs: noinline nounwind readonly uwtable
+define i64 @sum_point(%struct.point* nocapture readonly byval align 8 %p) #2 {
+  %1 = getelementptr inbounds %struct.point* %p, i64 0, i32 0
+  %2 = load i64* %1, align 8
+  %3 = getelementptr inbounds %struct.point* %p, i64 0, i32 1
+  %4 = load i64* %3, align 8
+  %5 = getelementptr inbounds %struct.point* %p, i64 0, i32 2
+  %6 = load i64* %5, align 8
+  %7 = tail call i64 @add3(i64 %2, i64 %4, i64 %6)
+  %8 = getelementptr inbounds %struct.point* %p, i64 0, i32 3
+  %9 = load i64* %8, align 8
+  %10 = add nsw i64 %9, %7
+  ret i64 %10
+}
+
+; Function Attrs: noinline nounwind uwtable
+define i64 @make_point(i64 %d) #3 {
+  %p = alloca %struct.point, align 8
+  %1 = getelementptr inbounds %struct.point* %p, i64 0, i32 0
+  store i64 %d, i64* %1, align 8
+  %2 = getelementptr inbounds %struct.point* %p, i64 0, i32 1
+  %3 = shl nsw i64 %d, 1
+  store i64 %3, i64* %2, align 8
+  %4 = getelementptr inbounds %struct.point* %p, i64 0, i32 2
+  %5 = mul nsw i64 %d, 3
+  store i64 %5, i64* %4, align 8
+  %6 = getelementptr inbounds %struct.point* %p, i64 0, i32 3
+  %7 = shl nsw i64 %d, 2
+  store i64 %7, i64* %6, align 8
+  %8 = tail call i64 @sum_point(%struct.point* byval align 8 %p)
+  ret i64 %8
+}
+
+; Function Attrs: noinline nounwind uwtable
+define i32 @apply(i32 (i32)* nocapture %func, i32 %n) #3 {
+  %1 = tail call i32 %func(i32 %n) #4
+  ret i32 %1
+}
+
+; Function Attrs: nounwind uwtable
+define i32 @main() #6 {
+  %1 = tail call i32 @is_even(i32 1000001)
+  %2 = tail call i32 @is_odd(i32 777777)
+  %3 = load i32* @m_num, align 4
+  %4 = tail call i32 @call_abs(i32 %3)
+  %5 = tail call i64 @make_point(i64 10)
+  %6 = tail call i32 @apply(i32 (i32)* @is_even, i32 100000)
+  %7 = tail call i32 @apply(i32 (i32)* @is_odd, i32 100001)
+  %8 = tail call i32 (i8*, ...)* @printf(i8* getelementptr inbounds ([20 x i8]* @.str, i64 0, i64 0), i32 %1, i32 %2, i32 %4, i64 %5, i32 %6, i32 %7) #4
+  ret i32 0
+}
+
+; Function Attrs: nounwind
+declare i32 @printf(i8* nocapture readonly, ...) #5
+
+attributes #0 = { noinline nounwind readnone uwtable "less-precise-fpmad"="false" "no-frame-pointer-elim"="false" "no-infs-fp-math"="false" "no-nans-fp-math"="false" "stack-protector-buffer-size"="8" "unsafe-fp-math"="false" "use-soft-float"="false" }
+attributes #1 = { nounwind readnone "less-precise-fpmad"="false" "no-frame-pointer-elim"="false" "no-infs-fp-math"="false" "no-nans-fp-math"="false" "stack-protector-buffer-size"="8" "unsafe-fp-math"="false" "use-soft-float"="false" }
+attributes #2 = { noinline nounwind readonly uwtable "less-precise-fpmad"="false" "no-frame-pointer-elim"="false" "no-infs-fp-math"="false" "no-nans-fp-math"="false" "stack-protector-buffer-size"="8" "unsafe-fp-math"="false" "use-soft-float"="false" }
+attributes #3 = { noinline nounwind uwtable "less-precise-fpmad"="false" "no-frame-pointer-elim"="false" "no-infs-fp-math"="false" "no-nans-fp-math"="false" "stack-protector-buffer-size"="8" "unsafe-fp-math"="false" "use-soft-float"="false" }
+attributes #4 = { nounwind }
+attributes #5 = { nounwind "less-precise-fpmad"="false" "no-frame-pointer-elim"="false" "no-infs-fp-math"="false" "no-nans-fp-math"="false" "stack-protector-buffer-size"="8" "unsafe-fp-math"="false" "use-soft-float"="false" }
+attributes #6 = { nounwind uwtable "less-precise-fpmad"="false" "no-frame-pointer-elim"="false" "no-infs-fp-math"="false" "no-nans-fp-math"="false" "stack-protector-buffer-size"="8" "unsafe-fp-math"="false" "use-soft-float"="false" }
+
+!llvm.ident = !{!0}
+
+!0 = metadata !{metadata !"Ubuntu clang version 3.4-1ubuntu3 (tags/RELEASE_34/final) (based on LLVM 3.4)"}